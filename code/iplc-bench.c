@@ -0,0 +1,453 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- throughput benchmark driver
+ ***********************************************************************/
+/***********************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+#include "iplc-sim.h"
+#include "iplc-trace.h"
+#include "iplc-cache.h"
+#include "iplc-kernels.h"
+#include "iplc-repl.h"
+#include "iplc-bpred.h"
+#include "iplc-event.h"
+#include "iplc-gen.h"
+
+#define BENCH_DEFAULT_LENGTH 500000
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_TOLERANCE 0.10
+#define BENCH_DEFAULT_OUT "bench.json"
+
+/*
+ * The matrix every workload runs across: L1 geometries as index,blocksize,assoc
+ * (all within MAX_CACHE_SIZE), and branch predictors with their default
+ * table sizes.
+ */
+static const int bench_geometries[][3] = {{7, 1, 1}, {5, 4, 2}, {3, 4, 4}, {0, 2, 32}};
+static const int bench_predictors[] = {BPRED_STATIC, BPRED_BIMODAL, BPRED_GSHARE, BPRED_TOURNAMENT};
+
+#define NUM_BENCH_GEOMETRIES ((int) (sizeof(bench_geometries) / sizeof(bench_geometries[0])))
+#define NUM_BENCH_PREDICTORS ((int) (sizeof(bench_predictors) / sizeof(bench_predictors[0])))
+
+/*
+ * One measurement: the best of repeat runs of one phase on one workload.
+ * ns is per unit, an instruction for parse and pipeline and an L1 access
+ * for cache.  A run is checked against the ns of the same name in the
+ * baseline, and threshold is what the next run may take at most: the
+ * baseline plus the tolerance, or this run plus the tolerance without one.
+ */
+typedef struct bench_result
+{
+    char name[96];              // phase/workload[/geometry[/predictor]]
+    const char *phase;
+    const char *workload;
+    char geometry[16];          // "" for parse
+    const char *predictor;      // NULL unless pipeline
+    long units;
+    double seconds;
+    double ns;
+    double baseline;            // 0 if not in the baseline
+    double threshold;
+    double cpi;                 // pipeline only
+    double miss_rate;           // cache and pipeline
+    int regressed;
+
+} bench_result_t;
+
+typedef struct bench
+{
+    long length;
+    int repeat;
+    uint64_t seed;
+    double tolerance;
+    const char *out;
+    const char *baseline;
+    bench_result_t *results;
+    int nresults;
+    int cap;
+
+} bench_t;
+
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bench_result_t *bench_add(bench_t *b, const char *phase, const char *workload,
+                                 const int *geometry, const char *predictor)
+{
+    bench_result_t *r;
+
+    if (b->nresults == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 64;
+        b->results = (bench_result_t *) realloc(b->results, sizeof(bench_result_t) * b->cap);
+    }
+    r = &b->results[b->nresults++];
+    memset(r, 0, sizeof(bench_result_t));
+
+    r->phase = phase;
+    r->workload = workload;
+    r->predictor = predictor;
+    if (geometry != NULL)
+        snprintf(r->geometry, sizeof(r->geometry), "%d,%d,%d", geometry[0], geometry[1], geometry[2]);
+    snprintf(r->name, sizeof(r->name), "%s/%s%s%s%s%s", phase, workload,
+             geometry ? "/" : "", r->geometry, predictor ? "/" : "", predictor ? predictor : "");
+    return r;
+}
+
+/************************************************************************************************/
+/* Phase Functions ******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Text trace to records, through the same reader/decoder threads as the
+ * simulator.
+ */
+static int bench_parse(bench_t *b, const char *workload, const char *path)
+{
+    bench_result_t *r = bench_add(b, "parse", workload, NULL, NULL);
+    iplc_trace_t trace;
+    double t;
+    int k;
+
+    for (k = 0; k < b->repeat; k++) {
+        t = bench_now();
+        if (iplc_trace_open(path, &trace) != 0)
+            return -1;
+        t = bench_now() - t;
+        r->units = trace.count;
+        iplc_trace_close(&trace);
+        if (k == 0 || t < r->seconds)
+            r->seconds = t;
+    }
+    return 0;
+}
+
+/*
+ * Every fetch and data address straight into one LRU L1, nothing else.
+ */
+static int bench_cache(bench_t *b, const char *workload, const iplc_trace_t *trace, const int *geometry)
+{
+    bench_result_t *r = bench_add(b, "cache", workload, geometry, NULL);
+    const trace_record_t *rec;
+    iplc_cache_t *cache;
+    double t;
+    long i;
+    int k;
+
+    for (k = 0; k < b->repeat; k++) {
+        cache = iplc_cache_create(geometry[0], geometry[1], geometry[2], REPL_LRU);
+        if (cache == NULL)
+            return -1;
+
+        t = bench_now();
+        for (i = 0; i < trace->count; i++) {
+            rec = &trace->records[i];
+            iplc_cache_access(cache, rec->instruction_address);
+            if (rec->itype == LW || rec->itype == SW)
+                iplc_cache_access(cache, rec->data_address);
+        }
+        t = bench_now() - t;
+
+        r->units = cache->access;
+        r->miss_rate = (double) cache->miss / (double) cache->access;
+        iplc_cache_destroy(cache);
+        if (k == 0 || t < r->seconds)
+            r->seconds = t;
+    }
+    return 0;
+}
+
+/*
+ * The whole simulator, classic pipeline, replaying decoded columns the way
+ * the sweep does.
+ */
+static int bench_pipeline(bench_t *b, const char *workload, const trace_columns_t *columns,
+                          const int *geometry, int predictor)
+{
+    bench_result_t *r = bench_add(b, "pipeline", workload, geometry, iplc_bpred_name(predictor));
+    iplc_sim_config_t config;
+    iplc_sim_stats_t stats;
+    iplc_sim_t *sim;
+    double t;
+    int k;
+
+    iplc_sim_config_init(&config);
+    config.index = geometry[0];
+    config.blocksize = geometry[1];
+    config.assoc = geometry[2];
+    config.branch_predictor = predictor;
+    config.quiet = 1;
+    config.verbosity = VERBOSITY_STATS;
+
+    for (k = 0; k < b->repeat; k++) {
+        sim = iplc_sim_create(&config);
+        if (sim == NULL)
+            return -1;
+
+        t = bench_now();
+        iplc_sim_feed_columns(sim, columns, 0, columns->count);
+        iplc_sim_finalize(sim, &stats);
+        t = bench_now() - t;
+        iplc_sim_destroy(sim);
+
+        r->units = stats.instruction_count;
+        r->cpi = (double) stats.pipeline_cycles / (double) stats.instruction_count;
+        r->miss_rate = (double) stats.cache_miss / (double) stats.cache_access;
+        if (k == 0 || t < r->seconds)
+            r->seconds = t;
+    }
+    return 0;
+}
+
+/*
+ * Generate one workload into a scratch file and run every phase on it.
+ */
+static int bench_workload(bench_t *b, int kind)
+{
+    const char *workload = iplc_gen_name(kind);
+    char path[] = "/tmp/iplc-bench-XXXXXX";
+    iplc_trace_t trace;
+    trace_columns_t columns;
+    int fd, g, p, rc = -1;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        printf("cannot create a scratch trace in /tmp \n");
+        return -1;
+    }
+    close(fd);
+
+    if (iplc_gen_file(kind, b->length, b->seed, path) != 0)
+        goto out;
+    if (bench_parse(b, workload, path) != 0 || iplc_trace_open(path, &trace) != 0)
+        goto out;
+    if (iplc_trace_columns_build(&columns, trace.records, trace.count) != 0) {
+        iplc_trace_close(&trace);
+        goto out;
+    }
+
+    rc = 0;
+    for (g = 0; rc == 0 && g < NUM_BENCH_GEOMETRIES; g++)
+        rc = bench_cache(b, workload, &trace, bench_geometries[g]);
+    for (g = 0; rc == 0 && g < NUM_BENCH_GEOMETRIES; g++) {
+        for (p = 0; rc == 0 && p < NUM_BENCH_PREDICTORS; p++)
+            rc = bench_pipeline(b, workload, &columns, bench_geometries[g], bench_predictors[p]);
+    }
+
+    iplc_trace_columns_free(&columns);
+    iplc_trace_close(&trace);
+out:
+    unlink(path);
+    return rc;
+}
+
+/************************************************************************************************/
+/* Report Functions *****************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Find name's ns in a results file this program wrote earlier.  Each
+ * result is on a line of its own, so there is no need for a JSON parser.
+ * Returns 0 if it is not there.
+ */
+static double bench_baseline_ns(FILE *f, const char *name)
+{
+    char line[1024], key[128];
+    char *p;
+
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    rewind(f);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strstr(line, key) == NULL || (p = strstr(line, "\"ns\": ")) == NULL)
+            continue;
+        return strtod(p + 6, NULL);
+    }
+    return 0;
+}
+
+static int bench_check(bench_t *b)
+{
+    FILE *f = NULL;
+    bench_result_t *r;
+    int i, regressions = 0;
+
+    if (b->baseline != NULL && (f = fopen(b->baseline, "r")) == NULL) {
+        printf("fopen failed for %s file\n", b->baseline);
+        return -1;
+    }
+
+    for (i = 0; i < b->nresults; i++) {
+        r = &b->results[i];
+        r->ns = r->units ? r->seconds * 1e9 / (double) r->units : 0;
+        if (f != NULL)
+            r->baseline = bench_baseline_ns(f, r->name);
+        r->threshold = (r->baseline > 0 ? r->baseline : r->ns) * (1 + b->tolerance);
+        r->regressed = r->baseline > 0 && r->ns > r->threshold;
+        regressions += r->regressed;
+    }
+
+    if (f != NULL)
+        fclose(f);
+    return regressions;
+}
+
+static const char *bench_status(const bench_t *b, const bench_result_t *r)
+{
+    if (b->baseline == NULL || r->baseline <= 0)
+        return "unchecked";
+    return r->regressed ? "regressed" : "ok";
+}
+
+static int bench_write_json(const bench_t *b, int regressions)
+{
+    const bench_result_t *r;
+    FILE *f = fopen(b->out, "w");
+    int i;
+
+    if (f == NULL) {
+        printf("fopen failed for %s file\n", b->out);
+        return -1;
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"version\": 1,\n");
+    fprintf(f, "  \"build\": \"%s\",\n", iplc_cache_kernel_count() > 0 ? "specialized" : "generic");
+    fprintf(f, "  \"instructions\": %ld,\n", b->length);
+    fprintf(f, "  \"repeat\": %d,\n", b->repeat);
+    fprintf(f, "  \"seed\": %llu,\n", (unsigned long long) b->seed);
+    fprintf(f, "  \"tolerance\": %g,\n", b->tolerance);
+    if (b->baseline != NULL)
+        fprintf(f, "  \"baseline\": \"%s\",\n", b->baseline);
+    else
+        fprintf(f, "  \"baseline\": null,\n");
+    fprintf(f, "  \"regressions\": %d,\n", regressions);
+    fprintf(f, "  \"results\": [\n");
+
+    for (i = 0; i < b->nresults; i++) {
+        r = &b->results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"phase\": \"%s\", \"workload\": \"%s\", ",
+                r->name, r->phase, r->workload);
+        if (r->geometry[0] != '\0')
+            fprintf(f, "\"geometry\": \"%s\", ", r->geometry);
+        if (r->predictor != NULL)
+            fprintf(f, "\"predictor\": \"%s\", ", r->predictor);
+        fprintf(f, "\"units\": %ld, \"seconds\": %.6f, \"ns\": %.3f, \"per_second\": %.0f, ",
+                r->units, r->seconds, r->ns, r->seconds > 0 ? r->units / r->seconds : 0);
+        if (r->predictor != NULL)
+            fprintf(f, "\"cpi\": %.6f, ", r->cpi);
+        if (r->geometry[0] != '\0')
+            fprintf(f, "\"miss_rate\": %.6f, ", r->miss_rate);
+        if (r->baseline > 0)
+            fprintf(f, "\"baseline_ns\": %.3f, ", r->baseline);
+        fprintf(f, "\"threshold_ns\": %.3f, \"status\": \"%s\"}%s\n", r->threshold,
+                bench_status(b, r), i + 1 < b->nresults ? "," : "");
+    }
+
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static void bench_print(const bench_t *b, int regressions)
+{
+    const bench_result_t *r;
+    int i;
+
+    printf("Simulator Benchmark: %ld instructions per workload, best of %d, %s build \n\n",
+           b->length, b->repeat, iplc_cache_kernel_count() > 0 ? "specialized" : "generic");
+    printf("%-44s  %12s  %10s  %10s  %s\n", "Name", "Per Second", "ns", "Baseline", "Status");
+    for (i = 0; i < b->nresults; i++) {
+        r = &b->results[i];
+        printf("%-44s  %12.0f  %10.3f  %10.3f  %s\n", r->name,
+               r->seconds > 0 ? r->units / r->seconds : 0, r->ns, r->baseline, bench_status(b, r));
+    }
+    printf("\n%d regression(s) past %.0f%%, results in %s \n", regressions, b->tolerance * 100, b->out);
+}
+
+/************************************************************************************************/
+/* Main *****************************************************************************************/
+/************************************************************************************************/
+
+static void bench_usage(void)
+{
+    printf("usage: iplc-bench [--length instructions] [--repeat n] [--seed n] [--workload name] \n"
+           "                  [--tolerance fraction] [--baseline results.json] [--out results.json] \n"
+           "       iplc-bench --generate sequential|stride|random|pointer-chase|matmul|branchy \n"
+           "                  <instructions> <tracefile> [seed] \n");
+    exit(-1);
+}
+
+int main(int argc, char **argv)
+{
+    bench_t b;
+    int i, kind, only = -1, regressions;
+
+    // iplc-bench --generate <kind> <instructions> <tracefile> [seed]
+    if (argc >= 5 && strcmp(argv[1], "--generate") == 0) {
+        kind = iplc_gen_parse(argv[2]);
+        if (kind < 0)
+            bench_usage();
+        return iplc_gen_file(kind, atol(argv[3]), argc >= 6 ? strtoull(argv[5], NULL, 0) : 1,
+                             argv[4]) == 0 ? 0 : -1;
+    }
+
+    memset(&b, 0, sizeof(b));
+    b.length = BENCH_DEFAULT_LENGTH;
+    b.repeat = BENCH_DEFAULT_REPEAT;
+    b.seed = 1;
+    b.tolerance = BENCH_DEFAULT_TOLERANCE;
+    b.out = BENCH_DEFAULT_OUT;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--length") == 0 && i + 1 < argc)
+            b.length = atol(argv[++i]);
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            b.repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            b.seed = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            b.tolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            b.baseline = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            b.out = argv[++i];
+        else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+            only = iplc_gen_parse(argv[++i]);
+            if (only < 0)
+                bench_usage();
+        }
+        else
+            bench_usage();
+    }
+    if (b.length < 1 || b.repeat < 1 || b.tolerance < 0)
+        bench_usage();
+
+    for (kind = 0; kind < NUM_GEN_KINDS; kind++) {
+        if (only >= 0 && kind != only)
+            continue;
+        if (bench_workload(&b, kind) != 0) {
+            printf("benchmark failed on %s \n", iplc_gen_name(kind));
+            return -1;
+        }
+    }
+
+    regressions = bench_check(&b);
+    if (regressions < 0)
+        return -1;
+    bench_print(&b, regressions);
+    if (bench_write_json(&b, regressions) != 0)
+        return -1;
+
+    free(b.results);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- branch predictors
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "iplc-bpred.h"
+
+#define COUNTER_INIT 1          // weakly not taken
+#define TAKEN(c) ((c) >= 2)
+
+typedef struct btb_entry
+{
+    uint32_t pc;
+    uint32_t target;
+    int valid;
+
+} btb_entry_t;
+
+struct iplc_bpred
+{
+    int kind;
+    int static_taken;
+    uint32_t table_mask;
+    uint32_t history_mask;
+    uint32_t btb_mask;
+
+    uint8_t *counters;          // bimodal, gshare; tournament: local counters
+    uint16_t *local_history;    // tournament
+    uint8_t *global;            // tournament
+    uint8_t *chooser;           // tournament, 2 and up picks global
+    uint32_t history;           // global history, newest outcome in bit 0
+    btb_entry_t *btb;           // NULL without a BTB
+
+    long branches;
+    long mispredictions;
+    long btb_misses;            // taken and predicted taken, but no target
+};
+
+static const char *bpred_names[NUM_BPRED_KINDS] = {"static", "bimodal", "gshare", "tournament"};
+
+const char *iplc_bpred_name(int kind)
+{
+    if (kind < 0 || kind >= NUM_BPRED_KINDS)
+        return "?";
+    return bpred_names[kind];
+}
+
+/*
+ * Look a predictor up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_bpred_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_BPRED_KINDS; i++) {
+        if (strcasecmp(name, bpred_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static uint8_t *counter_table(uint32_t entries)
+{
+    uint8_t *t = (uint8_t *) malloc(entries);
+
+    if (t != NULL)
+        memset(t, COUNTER_INIT, entries);
+    return t;
+}
+
+iplc_bpred_t *iplc_bpred_create(int kind, int table_bits, int history_bits, int btb_bits,
+                                int static_taken)
+{
+    iplc_bpred_t *bp;
+    int ok = 1;
+
+    if (kind < 0 || kind >= NUM_BPRED_KINDS ||
+        table_bits < 0 || table_bits > BPRED_MAX_TABLE_BITS ||
+        history_bits < 0 || history_bits > BPRED_MAX_HISTORY_BITS ||
+        btb_bits < 0 || btb_bits > BPRED_MAX_TABLE_BITS)
+        return NULL;
+
+    bp = (iplc_bpred_t *) calloc(1, sizeof(iplc_bpred_t));
+    if (bp == NULL)
+        return NULL;
+
+    bp->kind = kind;
+    bp->static_taken = static_taken;
+    bp->table_mask = (1u << table_bits) - 1;
+    bp->history_mask = (1u << history_bits) - 1;
+    bp->btb_mask = (1u << btb_bits) - 1;
+
+    switch (kind) {
+        case BPRED_BIMODAL:
+        case BPRED_GSHARE:
+            ok = (bp->counters = counter_table(1u << table_bits)) != NULL;
+            break;
+        case BPRED_TOURNAMENT:
+            bp->local_history = (uint16_t *) calloc(1u << table_bits, sizeof(uint16_t));
+            bp->counters = counter_table(1u << history_bits);
+            bp->global = counter_table(1u << history_bits);
+            bp->chooser = counter_table(1u << history_bits);
+            ok = bp->local_history && bp->counters && bp->global && bp->chooser;
+            break;
+    }
+    if (btb_bits > 0)
+        ok = ok && (bp->btb = (btb_entry_t *) calloc(1u << btb_bits, sizeof(btb_entry_t))) != NULL;
+
+    if (!ok) {
+        iplc_bpred_destroy(bp);
+        return NULL;
+    }
+    return bp;
+}
+
+void iplc_bpred_destroy(iplc_bpred_t *bp)
+{
+    if (bp == NULL)
+        return;
+
+    free(bp->counters);
+    free(bp->local_history);
+    free(bp->global);
+    free(bp->chooser);
+    free(bp->btb);
+    free(bp);
+}
+
+/************************************************************************************************/
+/* Prediction Functions *************************************************************************/
+/************************************************************************************************/
+
+static inline void counter_update(uint8_t *c, int taken)
+{
+    if (taken && *c < 3)
+        (*c)++;
+    else if (!taken && *c > 0)
+        (*c)--;
+}
+
+/*
+ * Predict the direction of the branch at pc, then train on the real
+ * outcome.
+ */
+static int bpred_direction(iplc_bpred_t *bp, uint32_t pc, int taken)
+{
+    uint32_t i = pc >> 2;
+    uint32_t g = bp->history & bp->history_mask;
+    uint8_t *c, *lc, *gc;
+    uint16_t *lh;
+    int prediction = bp->static_taken, local, global;
+
+    switch (bp->kind) {
+        case BPRED_BIMODAL:
+            c = &bp->counters[i & bp->table_mask];
+            prediction = TAKEN(*c);
+            counter_update(c, taken);
+            break;
+
+        case BPRED_GSHARE:
+            c = &bp->counters[(i ^ g) & bp->table_mask];
+            prediction = TAKEN(*c);
+            counter_update(c, taken);
+            break;
+
+        case BPRED_TOURNAMENT:
+            lh = &bp->local_history[i & bp->table_mask];
+            lc = &bp->counters[*lh & bp->history_mask];
+            gc = &bp->global[g];
+            local = TAKEN(*lc);
+            global = TAKEN(*gc);
+            prediction = TAKEN(bp->chooser[g]) ? global : local;
+
+            // the chooser only learns when the two disagree
+            if (local != global)
+                counter_update(&bp->chooser[g], global == taken);
+            counter_update(lc, taken);
+            counter_update(gc, taken);
+            *lh = (uint16_t) ((*lh << 1) | taken);
+            break;
+    }
+
+    bp->history = (bp->history << 1) | (taken ? 1 : 0);
+    return prediction;
+}
+
+/*
+ * Predict the branch at pc, learn its real outcome and target, and count
+ * it.  Returns 1 if the prediction was right.
+ */
+int iplc_bpred_resolve(iplc_bpred_t *bp, uint32_t pc, int taken, uint32_t target)
+{
+    btb_entry_t *e = NULL;
+    int correct;
+
+    bp->branches++;
+
+    correct = bpred_direction(bp, pc, taken) == taken;
+
+    if (bp->btb != NULL) {
+        e = &bp->btb[(pc >> 2) & bp->btb_mask];
+        if (correct && taken && !(e->valid && e->pc == pc && e->target == target)) {
+            // right direction, but fetch had nowhere to go
+            bp->btb_misses++;
+            correct = 0;
+        }
+        if (taken) {
+            e->valid = 1;
+            e->pc = pc;
+            e->target = target;
+        }
+    }
+
+    if (!correct)
+        bp->mispredictions++;
+    return correct;
+}
+
+/************************************************************************************************/
+/* Checkpoint Functions *************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Write or read every table bp has, in a fixed order.  Returns -1 on a
+ * short read or write.
+ */
+static int bpred_tables(const iplc_bpred_t *bp, FILE *f, int save)
+{
+    struct { void *p; size_t size, n; } t[5];
+    size_t table = (size_t) bp->table_mask + 1, history = (size_t) bp->history_mask + 1;
+    int i, n = 0;
+
+    if (bp->kind == BPRED_BIMODAL || bp->kind == BPRED_GSHARE) {
+        t[n].p = bp->counters; t[n].size = 1; t[n++].n = table;
+    }
+    else if (bp->kind == BPRED_TOURNAMENT) {
+        t[n].p = bp->local_history; t[n].size = sizeof(uint16_t); t[n++].n = table;
+        t[n].p = bp->counters; t[n].size = 1; t[n++].n = history;
+        t[n].p = bp->global; t[n].size = 1; t[n++].n = history;
+        t[n].p = bp->chooser; t[n].size = 1; t[n++].n = history;
+    }
+    if (bp->btb != NULL) {
+        t[n].p = bp->btb; t[n].size = sizeof(btb_entry_t); t[n++].n = (size_t) bp->btb_mask + 1;
+    }
+
+    for (i = 0; i < n; i++) {
+        if ((save ? fwrite(t[i].p, t[i].size, t[i].n, f) : fread(t[i].p, t[i].size, t[i].n, f)) != t[i].n)
+            return -1;
+    }
+    return 0;
+}
+
+int iplc_bpred_save(const iplc_bpred_t *bp, FILE *f)
+{
+    if (fwrite(bp, sizeof(iplc_bpred_t), 1, f) != 1)
+        return -1;
+    return bpred_tables(bp, f, 1);
+}
+
+/*
+ * Returns -1 if the saved predictor was configured differently.
+ */
+int iplc_bpred_load(iplc_bpred_t *bp, FILE *f)
+{
+    iplc_bpred_t saved;
+
+    if (fread(&saved, sizeof(iplc_bpred_t), 1, f) != 1)
+        return -1;
+    if (saved.kind != bp->kind || saved.table_mask != bp->table_mask ||
+        saved.history_mask != bp->history_mask || saved.btb_mask != bp->btb_mask ||
+        (saved.btb == NULL) != (bp->btb == NULL))
+        return -1;
+
+    saved.counters = bp->counters;
+    saved.local_history = bp->local_history;
+    saved.global = bp->global;
+    saved.chooser = bp->chooser;
+    saved.btb = bp->btb;
+    *bp = saved;
+    return bpred_tables(bp, f, 0);
+}
+
+/************************************************************************************************/
+/* Result Functions *****************************************************************************/
+/************************************************************************************************/
+
+int iplc_bpred_kind(const iplc_bpred_t *bp)
+{
+    return bp->kind;
+}
+
+long iplc_bpred_branches(const iplc_bpred_t *bp)
+{
+    return bp->branches;
+}
+
+long iplc_bpred_mispredictions(const iplc_bpred_t *bp)
+{
+    return bp->mispredictions;
+}
+
+long iplc_bpred_btb_misses(const iplc_bpred_t *bp)
+{
+    return bp->btb_misses;
+}
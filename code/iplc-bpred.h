@@ -0,0 +1,54 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- branch predictors
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_BPRED_H
+#define IPLC_BPRED_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum bpred_kind {BPRED_STATIC, BPRED_BIMODAL, BPRED_GSHARE, BPRED_TOURNAMENT, NUM_BPRED_KINDS};
+
+#define BPRED_MAX_TABLE_BITS 20
+#define BPRED_MAX_HISTORY_BITS 16
+
+/*
+ * A branch predictor, indexed by the address of the branch:
+ *
+ *   static      always the configured direction (the original behaviour)
+ *   bimodal     2^table_bits 2-bit saturating counters
+ *   gshare      2^table_bits 2-bit counters indexed by the address xor
+ *               history_bits of global history
+ *   tournament  a local predictor (2^table_bits per-branch histories of
+ *               history_bits each, into 2-bit counters) and a global one
+ *               (2-bit counters on the global history), with a 2-bit
+ *               chooser per global history
+ *
+ * With btb_bits > 0 there is also a direct mapped branch target buffer of
+ * 2^btb_bits entries: a branch predicted taken is only predicted right if
+ * the BTB also had its target.  With btb_bits 0 targets are always known.
+ */
+typedef struct iplc_bpred iplc_bpred_t;
+
+const char *iplc_bpred_name(int kind);
+int iplc_bpred_parse(const char *name);
+
+iplc_bpred_t *iplc_bpred_create(int kind, int table_bits, int history_bits, int btb_bits,
+                                int static_taken);
+void iplc_bpred_destroy(iplc_bpred_t *bp);
+
+int iplc_bpred_resolve(iplc_bpred_t *bp, uint32_t pc, int taken, uint32_t target);
+
+// Checkpoints: tables and counters, into a predictor of the same configuration
+int iplc_bpred_save(const iplc_bpred_t *bp, FILE *f);
+int iplc_bpred_load(iplc_bpred_t *bp, FILE *f);
+
+// Results
+int iplc_bpred_kind(const iplc_bpred_t *bp);
+long iplc_bpred_branches(const iplc_bpred_t *bp);
+long iplc_bpred_mispredictions(const iplc_bpred_t *bp);
+long iplc_bpred_btb_misses(const iplc_bpred_t *bp);
+
+#endif
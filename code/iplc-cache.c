@@ -0,0 +1,444 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- cache storage
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "iplc-cache.h"
+#include "iplc-kernels.h"
+
+#define ALIGN64(n) (((n) + 63) & ~(size_t) 63)
+
+/*
+ * Build the cache.  Every way starts invalid.  Tree-PLRU needs a power of
+ * two associativity.
+ */
+iplc_cache_t *iplc_cache_create(int index, int blocksize, int assoc, int policy)
+{
+    iplc_cache_t *cache;
+    size_t tag_bytes, valid_bytes, repl_bytes;
+    uint32_t i;
+
+    if (index < 0 || index > 24 || blocksize < 1 || assoc < 1 || assoc > CACHE_MAX_ASSOC)
+        return NULL;
+    if (iplc_repl_policy(policy) == NULL ||
+        (policy == REPL_PLRU && (assoc & (assoc - 1)) != 0))
+        return NULL;
+
+    cache = (iplc_cache_t *) calloc(1, sizeof(iplc_cache_t));
+    if (cache == NULL)
+        return NULL;
+
+    cache->index_bits = index;
+    cache->blocksize = blocksize;
+    for (cache->blockoffsetbits = 0; (1 << cache->blockoffsetbits) < blocksize * 4;
+         cache->blockoffsetbits++)
+        ;
+    cache->assoc = assoc;
+    cache->sets = 1u << index;
+    cache->index_mask = cache->sets - 1;
+    cache->policy = iplc_repl_policy(policy);
+    cache->replacement = policy;
+    cache->repl_stride = cache->policy->set_bytes(assoc);
+    cache->rng = 0x2545F4914F6CDD1Dull;
+
+    tag_bytes = ALIGN64((size_t) cache->sets * assoc * sizeof(uint32_t));
+    valid_bytes = ALIGN64((size_t) cache->sets * sizeof(uint64_t));
+    repl_bytes = ALIGN64((size_t) cache->sets * cache->repl_stride);
+
+    // the dirty bitmaps are the same size as the valid ones and follow them
+    cache->arena_bytes = tag_bytes + 2 * valid_bytes + repl_bytes;
+    if (posix_memalign(&cache->arena, 64, cache->arena_bytes) != 0) {
+        free(cache);
+        return NULL;
+    }
+    memset(cache->arena, 0, cache->arena_bytes);
+
+    cache->tags = (uint32_t *) cache->arena;
+    cache->valid = (uint64_t *) ((char *) cache->arena + tag_bytes);
+    cache->dirty = (uint64_t *) ((char *) cache->arena + tag_bytes + valid_bytes);
+    cache->repl = (uint8_t *) ((char *) cache->arena + tag_bytes + 2 * valid_bytes);
+
+    for (i = 0; i < cache->sets; i++)
+        cache->policy->init_set(cache, cache->repl + i * cache->repl_stride);
+
+    cache->kernel = iplc_cache_kernel(cache->blockoffsetbits, index, assoc);
+    return cache;
+}
+
+void iplc_cache_destroy(iplc_cache_t *cache)
+{
+    if (cache == NULL)
+        return;
+    free(cache->prefetched);
+    free(cache->ready);
+    free(cache->arena);
+    free(cache);
+}
+
+/************************************************************************************************/
+/* Lookup Functions *****************************************************************************/
+/************************************************************************************************/
+
+#if defined(__AVX2__)
+static inline uint64_t match8(const uint32_t *tags, __m256i key)
+{
+    __m256i t = _mm256_load_si256((const __m256i *) tags);
+    return (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(t, key)));
+}
+#endif
+
+#if defined(__SSE2__)
+static inline uint64_t match4(const uint32_t *tags, __m128i key)
+{
+    __m128i t = _mm_load_si128((const __m128i *) tags);
+    return (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, key)));
+}
+#endif
+
+/*
+ * Find tag in set.  Returns the way or -1.  Every way is compared and the
+ * matches are masked with the valid bitmap, so there is no per-way branch.
+ */
+int iplc_cache_lookup(const iplc_cache_t *cache, uint32_t set, uint32_t tag)
+{
+    const uint32_t *tags = cache->tags + (size_t) set * cache->assoc;
+    uint64_t match = 0;
+    int i;
+
+#if defined(IPLC_SPECIALIZE)
+    if (cache->kernel != NULL)
+        return cache->kernel->lookup(cache, set, tag);
+#endif
+
+#if defined(__AVX2__)
+    if (cache->assoc == 8) {
+        match = match8(tags, _mm256_set1_epi32((int) tag));
+    }
+    else if (cache->assoc == 16) {
+        __m256i key = _mm256_set1_epi32((int) tag);
+        match = match8(tags, key) | (match8(tags + 8, key) << 8);
+    }
+    else
+#endif
+#if defined(__SSE2__)
+    if ((cache->assoc & 3) == 0) {
+        __m128i key = _mm_set1_epi32((int) tag);
+        for (i = 0; i < cache->assoc; i += 4)
+            match |= match4(tags + i, key) << i;
+    }
+    else
+#endif
+    {
+        for (i = 0; i < cache->assoc; i++)
+            match |= (uint64_t) (tags[i] == tag) << i;
+    }
+
+    match &= cache->valid[set];
+    return match ? __builtin_ctzll(match) : -1;
+}
+
+/************************************************************************************************/
+/* Access Functions *****************************************************************************/
+/************************************************************************************************/
+
+static inline uint32_t cache_set(const iplc_cache_t *cache, uint32_t address)
+{
+    return (address >> cache->blockoffsetbits) & cache->index_mask;
+}
+
+static inline uint32_t cache_tag(const iplc_cache_t *cache, uint32_t address)
+{
+    return address >> (cache->index_bits + cache->blockoffsetbits);
+}
+
+/*
+ * A prefetched way goes away or gets its first demand use.
+ */
+static inline void cache_prefetch_clear(iplc_cache_t *cache, uint32_t set, int way, int used)
+{
+    if (!((cache->prefetched[set] >> way) & 1))
+        return;
+
+    cache->prefetched[set] &= ~(1ull << way);
+    if (!used)
+        return;
+
+    cache->prefetch_useful++;
+    if (cache->ready[(size_t) set * cache->assoc + way] > cache->now) {
+        cache->prefetch_late++;
+        cache->wait = cache->ready[(size_t) set * cache->assoc + way] - cache->now;
+    }
+}
+
+/*
+ * Put tag in set, which must not already hold it.  Invalid ways are filled
+ * first; otherwise the policy picks the victim.  Returns the way, and sets
+ * *eviction and the base address of the block that was thrown out in
+ * *evicted if a valid block had to go.
+ */
+static inline int cache_insert(iplc_cache_t *cache, uint32_t set, uint32_t tag, uint32_t *evicted,
+                               int *eviction)
+{
+    uint8_t *meta = cache->repl + (size_t) set * cache->repl_stride;
+    uint64_t free_ways;
+    uint32_t *slot;
+    int way;
+
+    *eviction = 0;
+
+    free_ways = ~cache->valid[set] & (cache->assoc == 64 ? ~0ull : (1ull << cache->assoc) - 1);
+    if (free_ways) {
+        way = __builtin_ctzll(free_ways);
+    }
+    else {
+        way = cache->policy->victim(cache, meta);
+        *eviction = 1;
+        if (cache->prefetched != NULL)
+            cache_prefetch_clear(cache, set, way, 0);
+    }
+    cache->policy->insert(cache, meta, way);
+
+    slot = cache->tags + (size_t) set * cache->assoc + way;
+    if (*eviction) {
+        cache->evictions++;
+        cache->victim = (*slot << (cache->index_bits + cache->blockoffsetbits)) |
+                        (set << cache->blockoffsetbits);
+        cache->victim_dirty = (int) ((cache->dirty[set] >> way) & 1);
+        cache->writebacks += cache->victim_dirty;
+        if (evicted != NULL)
+            *evicted = cache->victim;
+    }
+    else {
+        cache->victim_dirty = 0;
+    }
+    *slot = tag;
+    cache->valid[set] |= 1ull << way;
+    cache->dirty[set] &= ~(1ull << way);
+    return way;
+}
+
+/*
+ * Check if the address is in the cache, update the counters and the
+ * replacement state and, on a miss, put the block in.  Returns 1 for hit,
+ * 0 for miss.
+ */
+int iplc_cache_access(iplc_cache_t *cache, uint32_t address)
+{
+    uint32_t set = cache_set(cache, address);
+    uint32_t tag = cache_tag(cache, address);
+    int eviction;
+
+#if defined(IPLC_SPECIALIZE)
+    if (cache->kernel != NULL)
+        return cache->kernel->access(cache, address);
+#endif
+
+    if (iplc_cache_probe(cache, address))
+        return 1;
+
+    cache_insert(cache, set, tag, NULL, &eviction);
+    return 0;
+}
+
+/*
+ * Like iplc_cache_access() but a miss leaves the cache alone, so the caller
+ * decides where the block goes.  Returns 1 for hit, 0 for miss.
+ */
+int iplc_cache_probe(iplc_cache_t *cache, uint32_t address)
+{
+    uint32_t set = cache_set(cache, address);
+    int way;
+
+#if defined(IPLC_SPECIALIZE)
+    if (cache->kernel != NULL)
+        return cache->kernel->probe(cache, address);
+#endif
+
+    cache->access++;
+
+    way = iplc_cache_lookup(cache, set, cache_tag(cache, address));
+    if (way >= 0) {
+        cache->hit++;
+        cache->policy->touch(cache, cache->repl + (size_t) set * cache->repl_stride, way);
+        if (cache->prefetched != NULL) {
+            cache->wait = 0;
+            cache_prefetch_clear(cache, set, way, 1);
+        }
+        return 1;
+    }
+
+    cache->miss++;
+    return 0;
+}
+
+/*
+ * Bring the block holding address in without counting an access.  A block
+ * that is already there is just touched.  Returns 1 and the victim's base
+ * address in *evicted if a valid block had to go.
+ */
+int iplc_cache_fill(iplc_cache_t *cache, uint32_t address, uint32_t *evicted)
+{
+    uint32_t set = cache_set(cache, address);
+    uint32_t tag = cache_tag(cache, address);
+    int way, eviction;
+
+    way = iplc_cache_lookup(cache, set, tag);
+    if (way >= 0) {
+        cache->policy->touch(cache, cache->repl + (size_t) set * cache->repl_stride, way);
+        return 0;
+    }
+    cache_insert(cache, set, tag, evicted, &eviction);
+    return eviction;
+}
+
+/*
+ * Drop the block holding address.  Returns 1 if it was there.  The way is
+ * just marked invalid, so it is the next one filled in its set.
+ */
+int iplc_cache_invalidate(iplc_cache_t *cache, uint32_t address)
+{
+    uint32_t set = cache_set(cache, address);
+    int way;
+
+    way = iplc_cache_lookup(cache, set, cache_tag(cache, address));
+    if (way < 0)
+        return 0;
+    if (cache->prefetched != NULL)
+        cache_prefetch_clear(cache, set, way, 0);
+    cache->victim = address & ~((1u << cache->blockoffsetbits) - 1);
+    cache->victim_dirty = (int) ((cache->dirty[set] >> way) & 1);
+    cache->writebacks += cache->victim_dirty;
+    cache->valid[set] &= ~(1ull << way);
+    cache->dirty[set] &= ~(1ull << way);
+    return 1;
+}
+
+/*
+ * Mark the block holding address as written.  Returns 1 if it was there.
+ * Nothing else about the block changes, not even its replacement state.
+ */
+int iplc_cache_set_dirty(iplc_cache_t *cache, uint32_t address)
+{
+    uint32_t set = cache_set(cache, address);
+    int way;
+
+    way = iplc_cache_lookup(cache, set, cache_tag(cache, address));
+    if (way < 0)
+        return 0;
+    cache->dirty[set] |= 1ull << way;
+    return 1;
+}
+
+/************************************************************************************************/
+/* Prefetch Functions ***************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Start tracking prefetched blocks.  Returns -1 if out of memory.  The
+ * kernels know nothing about prefetching, so the cache goes generic.
+ */
+int iplc_cache_enable_prefetch(iplc_cache_t *cache)
+{
+    if (cache->prefetched != NULL)
+        return 0;
+
+    cache->kernel = NULL;
+    cache->prefetched = (uint64_t *) calloc(cache->sets, sizeof(uint64_t));
+    cache->ready = (uint64_t *) calloc((size_t) cache->sets * cache->assoc, sizeof(uint64_t));
+    if (cache->prefetched == NULL || cache->ready == NULL) {
+        free(cache->prefetched);
+        free(cache->ready);
+        cache->prefetched = NULL;
+        cache->ready = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int iplc_cache_contains(const iplc_cache_t *cache, uint32_t address)
+{
+    return iplc_cache_lookup(cache, cache_set(cache, address), cache_tag(cache, address)) >= 0;
+}
+
+/*
+ * Bring in a block that is not there yet and will arrive at cycle ready.
+ * Counts as neither an access nor a miss.  Returns 1 and the victim's base
+ * address in *evicted if a valid block had to go.
+ */
+int iplc_cache_prefetch(iplc_cache_t *cache, uint32_t address, uint64_t ready, uint32_t *evicted)
+{
+    uint32_t set = cache_set(cache, address);
+    int way, eviction;
+
+    way = cache_insert(cache, set, cache_tag(cache, address), evicted, &eviction);
+    cache->prefetched[set] |= 1ull << way;
+    cache->ready[(size_t) set * cache->assoc + way] = ready;
+    cache->prefetch_issued++;
+    return eviction;
+}
+
+/************************************************************************************************/
+/* Checkpoint Functions *************************************************************************/
+/************************************************************************************************/
+
+/*
+ * The struct goes out as it is, pointers and all; iplc_cache_load() keeps
+ * its own.
+ */
+int iplc_cache_save(const iplc_cache_t *cache, FILE *f)
+{
+    if (fwrite(cache, sizeof(iplc_cache_t), 1, f) != 1 ||
+        fwrite(cache->arena, cache->arena_bytes, 1, f) != 1)
+        return -1;
+
+    if (cache->prefetched != NULL &&
+        (fwrite(cache->prefetched, sizeof(uint64_t), cache->sets, f) != cache->sets ||
+         fwrite(cache->ready, sizeof(uint64_t) * cache->assoc, cache->sets, f) != cache->sets))
+        return -1;
+    return 0;
+}
+
+/*
+ * Returns -1 if the saved cache had a different geometry or prefetching,
+ * and the cache is then left as it was or half loaded.
+ */
+int iplc_cache_load(iplc_cache_t *cache, FILE *f)
+{
+    iplc_cache_t saved;
+
+    if (fread(&saved, sizeof(iplc_cache_t), 1, f) != 1)
+        return -1;
+    if (saved.sets != cache->sets || saved.assoc != cache->assoc ||
+        saved.blocksize != cache->blocksize || saved.arena_bytes != cache->arena_bytes ||
+        saved.repl_stride != cache->repl_stride ||
+        (saved.prefetched == NULL) != (cache->prefetched == NULL))
+        return -1;
+
+    saved.tags = cache->tags;
+    saved.valid = cache->valid;
+    saved.dirty = cache->dirty;
+    saved.repl = cache->repl;
+    saved.arena = cache->arena;
+    saved.policy = cache->policy;
+    saved.prefetched = cache->prefetched;
+    saved.ready = cache->ready;
+    saved.replacement = cache->replacement;
+    saved.kernel = cache->kernel;
+    *cache = saved;
+
+    if (fread(cache->arena, cache->arena_bytes, 1, f) != 1)
+        return -1;
+    if (cache->prefetched != NULL &&
+        (fread(cache->prefetched, sizeof(uint64_t), cache->sets, f) != cache->sets ||
+         fread(cache->ready, sizeof(uint64_t) * cache->assoc, cache->sets, f) != cache->sets))
+        return -1;
+    return 0;
+}
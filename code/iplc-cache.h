@@ -0,0 +1,101 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- cache storage
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_CACHE_H
+#define IPLC_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "iplc-repl.h"
+
+#define CACHE_MAX_ASSOC 64      // one valid bit per way in a 64-bit word
+
+struct iplc_cache_kernel;
+
+/*
+ * A set-associative cache kept in one aligned arena:
+ *
+ *   tags   sets * assoc packed 32-bit tags, each set starting on a 16-byte
+ *          boundary when assoc >= 4 so a set can be compared with SIMD
+ *   valid  one 64-bit valid bitmap per set
+ *   dirty  one 64-bit bitmap per set of the ways written since they came in
+ *   repl   replacement policy state, repl_stride bytes per set
+ *
+ * A lookup compares every way of the set at once and turns the result into
+ * a bitmask, so 4-, 8- and 16-way sets cost about the same as direct mapped.
+ *
+ * A cache that takes prefetches (iplc_cache_enable_prefetch()) also keeps a
+ * bitmap per set of the ways a prefetch brought in that no demand access
+ * has used yet, and the cycle each prefetched block arrives.  The owner
+ * sets now before an access; a hit on a block still in flight leaves the
+ * cycles it has to wait in wait.
+ *
+ * Whenever an insertion or invalidation throws a valid block out, its base
+ * address and whether it was dirty are left in victim and victim_dirty.
+ *
+ * In a build with specialized kernels (iplc-kernels.h), kernel is the one
+ * for this geometry and lookups, probes and accesses go through it.
+ */
+typedef struct iplc_cache
+{
+    int index_bits;
+    int blocksize;              // words per block
+    int blockoffsetbits;
+    int assoc;
+    uint32_t sets;
+    uint32_t index_mask;
+
+    uint32_t *tags;
+    uint64_t *valid;
+    uint64_t *dirty;
+    uint8_t *repl;
+    void *arena;
+    size_t arena_bytes;
+
+    const iplc_repl_policy_t *policy;
+    int replacement;            // enum repl_policy
+    size_t repl_stride;
+    uint64_t rng;               // for the policies that need randomness
+
+    long access;
+    long hit;
+    long miss;
+    long evictions;             // valid blocks replaced
+    long writebacks;            // ... or invalidated, that were dirty
+    uint32_t victim;
+    int victim_dirty;
+
+    uint64_t *prefetched;       // NULL unless prefetching is enabled
+    uint64_t *ready;            // per way, in pipeline cycles like now
+    uint64_t now;
+    uint64_t wait;
+    long prefetch_issued;
+    long prefetch_useful;       // used by a demand access before eviction
+    long prefetch_late;         // ... but not there yet when it was used
+
+    const struct iplc_cache_kernel *kernel;     // NULL for the generic functions
+
+} iplc_cache_t;
+
+iplc_cache_t *iplc_cache_create(int index, int blocksize, int assoc, int policy);
+void iplc_cache_destroy(iplc_cache_t *cache);
+
+int iplc_cache_access(iplc_cache_t *cache, uint32_t address);
+int iplc_cache_probe(iplc_cache_t *cache, uint32_t address);
+int iplc_cache_fill(iplc_cache_t *cache, uint32_t address, uint32_t *evicted);
+int iplc_cache_invalidate(iplc_cache_t *cache, uint32_t address);
+int iplc_cache_set_dirty(iplc_cache_t *cache, uint32_t address);
+
+int iplc_cache_enable_prefetch(iplc_cache_t *cache);
+int iplc_cache_contains(const iplc_cache_t *cache, uint32_t address);
+int iplc_cache_prefetch(iplc_cache_t *cache, uint32_t address, uint64_t ready, uint32_t *evicted);
+int iplc_cache_lookup(const iplc_cache_t *cache, uint32_t set, uint32_t tag);
+
+// Checkpoints: contents and counters, into a cache of the same geometry
+int iplc_cache_save(const iplc_cache_t *cache, FILE *f);
+int iplc_cache_load(iplc_cache_t *cache, FILE *f);
+
+#endif
@@ -0,0 +1,587 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- multi-core cache coherence
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "iplc-coherence.h"
+
+#define CACHE_LINE 64
+#define DIRECTORY_STRIPES 64        // a power of two
+#define DIRECTORY_INITIAL_SLOTS 1024
+
+enum coherence_state {STATE_I, STATE_S, STATE_E, STATE_O, STATE_M};
+
+/*
+ * What the directory knows about one block: which cores hold a copy,
+ * which of them owns it (E, M or O; the rest are S) and which cores lost
+ * their copy to another core's store and have not missed on it since.
+ * key is the block number plus one, 0 for a free slot; entries are never
+ * removed, so a core's next miss on a block it lost is still recognised.
+ */
+typedef struct directory_entry
+{
+    uint32_t key;
+    uint32_t present;
+    uint32_t lost;
+    int8_t owner;               // -1 for none
+    uint8_t state;              // the owner's
+
+} directory_entry_t;
+
+/*
+ * One stripe of the directory: an open addressing table grown at half
+ * full, and the traffic of the requests made to its blocks, all under
+ * lock.  Stripes sit on their own cache lines.
+ */
+typedef struct directory_stripe
+{
+    pthread_mutex_t lock;
+    directory_entry_t *slots;
+    uint32_t mask;
+    uint32_t count;
+    long messages[NUM_COHERENCE_MESSAGES];
+    long bytes[NUM_COHERENCE_MESSAGES];
+
+} __attribute__((aligned(CACHE_LINE))) directory_stripe_t;
+
+/*
+ * Blocks other cores have invalidated in this core's L1D, which its own
+ * thread drops before its next access.  pending lets that thread skip the
+ * lock while the inbox is empty.
+ */
+typedef struct coherence_core
+{
+    pthread_mutex_t lock;
+    uint32_t *blocks;
+    long count;
+    long cap;
+    _Atomic long pending;
+    iplc_coherence_core_stats_t stats;
+
+} __attribute__((aligned(CACHE_LINE))) coherence_core_t;
+
+struct iplc_coherence
+{
+    int protocol;
+    int ncores;
+    int blockoffsetbits;        // of the L1s; the directory tracks their blocks
+    int block_bytes;
+    int l1_latency;
+    int l2_latency;
+    int memory_latency;
+
+    iplc_cache_t *l2;
+    pthread_mutex_t l2_lock;
+    long memory_reads;          // under l2_lock, as is the next one
+    long memory_writes;
+
+    directory_stripe_t stripe[DIRECTORY_STRIPES];
+    coherence_core_t core[COHERENCE_MAX_CORES];
+};
+
+static const char *protocol_names[NUM_COHERENCE_PROTOCOLS] = {"mesi", "moesi"};
+
+static const char *message_names[NUM_COHERENCE_MESSAGES] = {
+    "GetS", "GetM", "Upgrade", "Evict", "Invalidate", "Ack", "Forward", "Data", "Writeback"};
+
+const char *iplc_coherence_protocol_name(int protocol)
+{
+    if (protocol < 0 || protocol >= NUM_COHERENCE_PROTOCOLS)
+        return "?";
+    return protocol_names[protocol];
+}
+
+/*
+ * Look a protocol up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_coherence_protocol_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_COHERENCE_PROTOCOLS; i++) {
+        if (strcasecmp(name, protocol_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char *iplc_coherence_message_name(int message)
+{
+    if (message < 0 || message >= NUM_COHERENCE_MESSAGES)
+        return "?";
+    return message_names[message];
+}
+
+/************************************************************************************************/
+/* Directory Functions **************************************************************************/
+/************************************************************************************************/
+
+static inline uint32_t directory_hash(uint32_t block)
+{
+    block ^= block >> 16;
+    block *= 0x7feb352du;
+    block ^= block >> 15;
+    block *= 0x846ca68bu;
+    block ^= block >> 16;
+    return block;
+}
+
+static inline directory_stripe_t *directory_stripe(iplc_coherence_t *coh, uint32_t block)
+{
+    return &coh->stripe[directory_hash(block) & (DIRECTORY_STRIPES - 1)];
+}
+
+/*
+ * The entry of block, added with no copies if it was not there.  Returns
+ * NULL if the stripe could not grow.  The caller holds the stripe's lock.
+ */
+static directory_entry_t *directory_entry(directory_stripe_t *stripe, uint32_t block)
+{
+    directory_entry_t *bigger, *e;
+    uint32_t key = block + 1, slots, i, j;
+
+    if ((stripe->count + 1) * 2 > stripe->mask + 1) {
+        slots = (stripe->mask + 1) * 2;
+        bigger = (directory_entry_t *) calloc(slots, sizeof(directory_entry_t));
+        if (bigger == NULL)
+            return NULL;
+        for (i = 0; i <= stripe->mask; i++) {
+            if (stripe->slots[i].key == 0)
+                continue;
+            j = (directory_hash(stripe->slots[i].key - 1) / DIRECTORY_STRIPES) & (slots - 1);
+            while (bigger[j].key != 0)
+                j = (j + 1) & (slots - 1);
+            bigger[j] = stripe->slots[i];
+        }
+        free(stripe->slots);
+        stripe->slots = bigger;
+        stripe->mask = slots - 1;
+    }
+
+    i = (directory_hash(block) / DIRECTORY_STRIPES) & stripe->mask;
+    while (stripe->slots[i].key != 0) {
+        if (stripe->slots[i].key == key)
+            return &stripe->slots[i];
+        i = (i + 1) & stripe->mask;
+    }
+    e = &stripe->slots[i];
+    e->key = key;
+    e->owner = -1;
+    stripe->count++;
+    return e;
+}
+
+static inline int directory_state(const directory_entry_t *e, int core)
+{
+    if (!(e->present & (1u << core)))
+        return STATE_I;
+    return e->owner == core ? e->state : STATE_S;
+}
+
+static inline void directory_send(directory_stripe_t *stripe, int message, int data_bytes)
+{
+    stripe->messages[message]++;
+    stripe->bytes[message] += COHERENCE_CONTROL_BYTES + data_bytes;
+}
+
+/*
+ * Take every copy in others away: an invalidation and its ack for each
+ * sharer, into its inbox.  An owner that supplied the block has already
+ * been told by the forward, so it only loses its copy.
+ */
+static void directory_invalidate(iplc_coherence_t *coh, directory_stripe_t *stripe,
+                                 directory_entry_t *e, int core, uint32_t others, int forwarded)
+{
+    uint32_t block = e->key - 1;
+    coherence_core_t *c;
+    int k;
+
+    for (k = 0; others != 0; k++, others >>= 1) {
+        if (!(others & 1))
+            continue;
+        if (!(forwarded && k == e->owner)) {
+            directory_send(stripe, MSG_INVALIDATE, 0);
+            directory_send(stripe, MSG_ACK, 0);
+        }
+        c = &coh->core[k];
+        pthread_mutex_lock(&c->lock);
+        if (c->count == c->cap) {
+            long cap = c->cap ? c->cap * 2 : 64;
+            uint32_t *grown = (uint32_t *) realloc(c->blocks, cap * sizeof(uint32_t));
+            if (grown != NULL) {
+                c->blocks = grown;
+                c->cap = cap;
+            }
+        }
+        // without room the copy stays, and is dropped the next time it is evicted
+        if (c->count < c->cap) {
+            c->blocks[c->count++] = block;
+            atomic_store_explicit(&c->pending, c->count, memory_order_release);
+        }
+        pthread_mutex_unlock(&c->lock);
+
+        e->lost |= 1u << k;
+        coh->core[core].stats.invalidations_sent++;
+    }
+}
+
+/*
+ * Drop what other cores have invalidated from this core's L1D.
+ */
+static void coherence_drain(iplc_coherence_t *coh, int core, iplc_cache_t *l1d)
+{
+    coherence_core_t *c = &coh->core[core];
+    long i;
+
+    if (atomic_load_explicit(&c->pending, memory_order_acquire) == 0)
+        return;
+    pthread_mutex_lock(&c->lock);
+    for (i = 0; i < c->count; i++) {
+        if (iplc_cache_invalidate(l1d, c->blocks[i] << coh->blockoffsetbits))
+            c->stats.invalidations_received++;
+    }
+    c->count = 0;
+    atomic_store_explicit(&c->pending, 0, memory_order_relaxed);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/************************************************************************************************/
+/* L2 Functions *********************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Read a block from the shared L2, from memory if it misses there.
+ * Returns the latency.
+ */
+static int coherence_l2_read(iplc_coherence_t *coh, uint32_t address)
+{
+    uint32_t evicted;
+    int latency = coh->l2_latency;
+
+    pthread_mutex_lock(&coh->l2_lock);
+    if (!iplc_cache_probe(coh->l2, address)) {
+        latency = coh->memory_latency;
+        coh->memory_reads++;
+        if (iplc_cache_fill(coh->l2, address, &evicted) && coh->l2->victim_dirty)
+            coh->memory_writes++;
+    }
+    pthread_mutex_unlock(&coh->l2_lock);
+    return latency;
+}
+
+static void coherence_l2_write(iplc_coherence_t *coh, uint32_t address)
+{
+    uint32_t evicted;
+
+    pthread_mutex_lock(&coh->l2_lock);
+    if (iplc_cache_fill(coh->l2, address, &evicted) && coh->l2->victim_dirty)
+        coh->memory_writes++;
+    iplc_cache_set_dirty(coh->l2, address);
+    pthread_mutex_unlock(&coh->l2_lock);
+}
+
+/************************************************************************************************/
+/* Lifetime Functions ***************************************************************************/
+/************************************************************************************************/
+
+/*
+ * l2 is the shared L2's geometry and latency; its inclusion is ignored,
+ * as it never forces anything out of the L1s.  The L1s of the cores
+ * attached later must have l2->blocksize words per block.
+ */
+iplc_coherence_t *iplc_coherence_create(int protocol, int ncores, const iplc_level_config_t *l2,
+                                        int replacement, int l1_latency, int memory_latency)
+{
+    iplc_coherence_t *coh;
+    int i;
+
+    if (protocol < 0 || protocol >= NUM_COHERENCE_PROTOCOLS || ncores < 1 ||
+        ncores > COHERENCE_MAX_CORES)
+        return NULL;
+
+    if (posix_memalign((void **) &coh, CACHE_LINE, sizeof(iplc_coherence_t)) != 0)
+        return NULL;
+    memset(coh, 0, sizeof(iplc_coherence_t));
+
+    coh->l2 = iplc_cache_create(l2->index, l2->blocksize, l2->assoc, replacement);
+    if (coh->l2 == NULL) {
+        free(coh);
+        return NULL;
+    }
+    coh->protocol = protocol;
+    coh->ncores = ncores;
+    coh->blockoffsetbits = coh->l2->blockoffsetbits;
+    coh->block_bytes = 1 << coh->blockoffsetbits;
+    coh->l1_latency = l1_latency;
+    coh->l2_latency = l2->latency;
+    coh->memory_latency = memory_latency;
+    pthread_mutex_init(&coh->l2_lock, NULL);
+
+    for (i = 0; i < DIRECTORY_STRIPES; i++) {
+        pthread_mutex_init(&coh->stripe[i].lock, NULL);
+        coh->stripe[i].slots = (directory_entry_t *) calloc(DIRECTORY_INITIAL_SLOTS,
+                                                            sizeof(directory_entry_t));
+        coh->stripe[i].mask = DIRECTORY_INITIAL_SLOTS - 1;
+        if (coh->stripe[i].slots == NULL) {
+            iplc_coherence_destroy(coh);
+            return NULL;
+        }
+    }
+    for (i = 0; i < COHERENCE_MAX_CORES; i++)
+        pthread_mutex_init(&coh->core[i].lock, NULL);
+    return coh;
+}
+
+void iplc_coherence_destroy(iplc_coherence_t *coh)
+{
+    int i;
+
+    if (coh == NULL)
+        return;
+    for (i = 0; i < DIRECTORY_STRIPES; i++) {
+        free(coh->stripe[i].slots);
+        pthread_mutex_destroy(&coh->stripe[i].lock);
+    }
+    for (i = 0; i < COHERENCE_MAX_CORES; i++) {
+        free(coh->core[i].blocks);
+        pthread_mutex_destroy(&coh->core[i].lock);
+    }
+    pthread_mutex_destroy(&coh->l2_lock);
+    iplc_cache_destroy(coh->l2);
+    free(coh);
+}
+
+/************************************************************************************************/
+/* Access Functions *****************************************************************************/
+/************************************************************************************************/
+
+/*
+ * The core's L1D lost victim to its own replacement.  A dirty copy goes
+ * back to L2; a clean one is only reported so the directory can forget it.
+ */
+static void coherence_evicted(iplc_coherence_t *coh, int core, uint32_t victim)
+{
+    uint32_t block = victim >> coh->blockoffsetbits;
+    directory_stripe_t *stripe = directory_stripe(coh, block);
+    directory_entry_t *e;
+    int state;
+
+    pthread_mutex_lock(&stripe->lock);
+    e = directory_entry(stripe, block);
+    state = e != NULL ? directory_state(e, core) : STATE_I;
+    if (state == STATE_M || state == STATE_O) {
+        directory_send(stripe, MSG_WRITEBACK, coh->block_bytes);
+        coh->core[core].stats.writebacks++;
+        coherence_l2_write(coh, victim);
+    }
+    else if (state != STATE_I) {
+        directory_send(stripe, MSG_EVICT, 0);
+    }
+    if (e != NULL) {
+        e->present &= ~(1u << core);
+        if (e->owner == core)
+            e->owner = -1;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+/*
+ * A load or store by core to its L1D, l1d.  The lookup, and the fill on a
+ * miss, happen under the lock of the block's stripe, after any
+ * invalidations waiting for this core have been applied.  Returns 1 for
+ * an L1D hit; *latency gets the cycles the access takes.
+ */
+int iplc_coherence_data(iplc_coherence_t *coh, int core, iplc_cache_t *l1d, uint32_t address,
+                        int store, int *latency)
+{
+    iplc_coherence_core_stats_t *st = &coh->core[core].stats;
+    uint32_t block = address >> coh->blockoffsetbits, mine = 1u << core, evicted = 0;
+    directory_stripe_t *stripe = directory_stripe(coh, block);
+    directory_entry_t *e;
+    int hit, state, supplied = 0, eviction = 0;
+
+    if (store)
+        st->stores++;
+    else
+        st->loads++;
+
+    pthread_mutex_lock(&stripe->lock);
+    coherence_drain(coh, core, l1d);
+    hit = iplc_cache_probe(l1d, address);
+    *latency = coh->l1_latency;
+
+    e = directory_entry(stripe, block);
+    if (e == NULL) {
+        // no room to track it: served from L2 as if no other core had it
+        pthread_mutex_unlock(&stripe->lock);
+        if (!hit) {
+            st->misses++;
+            *latency = coherence_l2_read(coh, address);
+            if (iplc_cache_fill(l1d, address, &evicted))
+                coherence_evicted(coh, core, evicted);
+        }
+        return hit;
+    }
+    state = hit ? directory_state(e, core) : STATE_I;
+
+    if (hit && (state == STATE_M || (state == STATE_E && store) || !store)) {
+        // M, E and O hits need nothing, nor a store to an E copy, which becomes M
+        if (store)
+            e->state = STATE_M;
+        pthread_mutex_unlock(&stripe->lock);
+        return 1;
+    }
+
+    if (hit) {
+        // a store to an S or O copy
+        st->upgrades++;
+        directory_send(stripe, MSG_UPGRADE, 0);
+        directory_invalidate(coh, stripe, e, core, e->present & ~mine, 0);
+        *latency = coh->l2_latency;
+    }
+    else {
+        st->misses++;
+        if (e->lost & mine) {
+            st->coherence_misses++;
+            e->lost &= ~mine;
+        }
+        directory_send(stripe, store ? MSG_GETM : MSG_GETS, 0);
+
+        if (e->owner >= 0 && e->owner != core) {
+            // the owner's L1 supplies the block, dirty or not
+            directory_send(stripe, MSG_FORWARD, 0);
+            directory_send(stripe, MSG_DATA, coh->block_bytes);
+            st->cache_to_cache++;
+            supplied = 1;
+            *latency = coh->l2_latency + coh->l1_latency;
+            if (!store && e->state == STATE_M && coh->protocol == COHERENCE_MESI) {
+                directory_send(stripe, MSG_WRITEBACK, coh->block_bytes);
+                coherence_l2_write(coh, address);
+            }
+        }
+        else {
+            directory_send(stripe, MSG_DATA, coh->block_bytes);
+            *latency = coherence_l2_read(coh, address);
+        }
+
+        if (store) {
+            directory_invalidate(coh, stripe, e, core, e->present & ~mine, supplied);
+        }
+        else if (supplied && e->state != STATE_E && coh->protocol == COHERENCE_MOESI) {
+            e->state = STATE_O;
+        }
+        else if (supplied) {
+            e->owner = -1;
+        }
+        eviction = iplc_cache_fill(l1d, address, &evicted);
+    }
+
+    if (store) {
+        e->present = mine;
+        e->owner = (int8_t) core;
+        e->state = STATE_M;
+    }
+    else if (e->present == 0 && e->owner < 0) {
+        e->present = mine;
+        e->owner = (int8_t) core;
+        e->state = STATE_E;
+    }
+    else {
+        e->present |= mine;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    // the victim's stripe is locked on its own, so no thread ever holds two
+    if (eviction)
+        coherence_evicted(coh, core, evicted);
+    return hit;
+}
+
+/*
+ * An instruction fetch by core to its L1I.  Misses read the shared L2;
+ * nothing about the block is tracked.
+ */
+int iplc_coherence_fetch(iplc_coherence_t *coh, int core, iplc_cache_t *l1i, uint32_t address,
+                         int *latency)
+{
+    iplc_coherence_core_stats_t *st = &coh->core[core].stats;
+    uint32_t evicted;
+
+    st->fetches++;
+    if (iplc_cache_probe(l1i, address)) {
+        *latency = coh->l1_latency;
+        return 1;
+    }
+    st->fetch_misses++;
+    *latency = coherence_l2_read(coh, address);
+    iplc_cache_fill(l1i, address, &evicted);
+    return 0;
+}
+
+/************************************************************************************************/
+/* Report Functions *****************************************************************************/
+/************************************************************************************************/
+
+void iplc_coherence_get_stats(const iplc_coherence_t *coh, int core,
+                              iplc_coherence_core_stats_t *stats)
+{
+    *stats = coh->core[core].stats;
+}
+
+/*
+ * The shared L2, the directory and the interconnect traffic of every
+ * core together; instructions is how many they ran between them.
+ */
+void iplc_coherence_report(const iplc_coherence_t *coh, long instructions)
+{
+    long messages[NUM_COHERENCE_MESSAGES], bytes[NUM_COHERENCE_MESSAGES];
+    long blocks = 0, total_messages = 0, total_bytes = 0;
+    long invalidations = 0, coherence_misses = 0, misses = 0, upgrades = 0, c2c = 0;
+    int i, m;
+
+    memset(messages, 0, sizeof(messages));
+    memset(bytes, 0, sizeof(bytes));
+    for (i = 0; i < DIRECTORY_STRIPES; i++) {
+        blocks += coh->stripe[i].count;
+        for (m = 0; m < NUM_COHERENCE_MESSAGES; m++) {
+            messages[m] += coh->stripe[i].messages[m];
+            bytes[m] += coh->stripe[i].bytes[m];
+        }
+    }
+    for (i = 0; i < coh->ncores; i++) {
+        misses += coh->core[i].stats.misses;
+        coherence_misses += coh->core[i].stats.coherence_misses;
+        invalidations += coh->core[i].stats.invalidations_sent;
+        upgrades += coh->core[i].stats.upgrades;
+        c2c += coh->core[i].stats.cache_to_cache;
+    }
+
+    printf(" Coherence (%s) \n", iplc_coherence_protocol_name(coh->protocol));
+    printf("\t Directory tracks %ld blocks of %d bytes \n", blocks, coh->block_bytes);
+    printf("\t L1D Misses is %ld, of which Coherence Misses is %ld (%f) \n", misses,
+           coherence_misses, misses ? (double) coherence_misses / (double) misses : 0.0);
+    printf("\t Upgrades is %ld \n", upgrades);
+    printf("\t Invalidations is %ld \n", invalidations);
+    printf("\t Cache-to-Cache Transfers is %ld \n", c2c);
+    printf("\t Shared L2 Accesses %ld Misses %ld \n", coh->l2->access, coh->l2->miss);
+    printf("\t Memory Reads is %ld, Memory Writes is %ld \n", coh->memory_reads,
+           coh->memory_writes);
+    printf("\n");
+
+    printf(" Interconnect Traffic \n");
+    for (m = 0; m < NUM_COHERENCE_MESSAGES; m++) {
+        total_messages += messages[m];
+        total_bytes += bytes[m];
+        printf("\t %-10s %12ld messages %14ld bytes \n", message_names[m], messages[m], bytes[m]);
+    }
+    printf("\t %-10s %12ld messages %14ld bytes, %f bytes per instruction \n\n", "Total",
+           total_messages, total_bytes,
+           instructions ? (double) total_bytes / (double) instructions : 0.0);
+}
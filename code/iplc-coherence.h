@@ -0,0 +1,102 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- multi-core cache coherence
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_COHERENCE_H
+#define IPLC_COHERENCE_H
+
+#include <stdint.h>
+
+#include "iplc-sim.h"
+#include "iplc-cache.h"
+
+#define COHERENCE_MAX_CORES 32     // one presence bit per core in a directory entry
+
+enum coherence_protocol {COHERENCE_MESI, COHERENCE_MOESI, NUM_COHERENCE_PROTOCOLS};
+
+/*
+ * The requests, forwards and replies that cross the interconnect between
+ * the L1Ds and the directory at L2.  Control messages are
+ * COHERENCE_CONTROL_BYTES long; data messages carry a block as well.
+ *
+ *   GETS        a load missed: read a copy
+ *   GETM        a store missed: read the block and invalidate every other copy
+ *   UPGRADE     a store hit a shared (or owned) copy: invalidate the others
+ *   EVICT       an L1 dropped a clean copy
+ *   INVALIDATE  directory to a sharer, which drops its copy
+ *   ACK         ... and the sharer's reply
+ *   FORWARD     directory to the L1 that owns the block, to supply it
+ *   DATA        a block to an L1, from L2 or from the owner's L1
+ *   WRITEBACK   a dirty block on its way to L2
+ */
+enum coherence_message {MSG_GETS, MSG_GETM, MSG_UPGRADE, MSG_EVICT, MSG_INVALIDATE, MSG_ACK,
+                        MSG_FORWARD, MSG_DATA, MSG_WRITEBACK, NUM_COHERENCE_MESSAGES};
+
+#define COHERENCE_CONTROL_BYTES 8
+
+typedef struct iplc_coherence_core_stats
+{
+    long loads;
+    long stores;
+    long misses;                // L1D misses, coherence misses included
+    long coherence_misses;      // ... to blocks this core last lost to another core's store
+    long upgrades;              // stores to a shared or owned copy
+    long cache_to_cache;        // misses another L1 supplied
+    long invalidations_sent;    // copies other cores lost to this one's stores
+    long invalidations_received;
+    long writebacks;            // dirty blocks this core wrote to L2
+    long fetches;               // L1I, which is not kept coherent
+    long fetch_misses;
+
+} iplc_coherence_core_stats_t;
+
+/*
+ * A directory protocol keeping the L1Ds of up to COHERENCE_MAX_CORES
+ * simulators coherent over one shared L2.  Each core is an iplc_sim_t
+ * with a split L1 and nothing below it of its own; once attached
+ * (iplc_sim_attach_coherence()) its L1D accesses come here, where every
+ * block has a directory entry naming the cores that hold it and the one
+ * that owns it, if any, in E, M or (MOESI) O.  A store to a copy that is
+ * not exclusive invalidates the others; a load of a block another core
+ * has modified gets it from that core's L1, which keeps an O copy under
+ * MOESI or writes it back and drops to S under MESI.  L1I misses read
+ * the shared L2 and are not tracked: the trace never stores to code.
+ *
+ * Cores run on their own threads.  The directory is split into stripes,
+ * each under its own lock, and a core looks up its L1D under the lock
+ * of the block's stripe, so two cores never see one block differently.
+ * Invalidations are posted to the losing core's inbox and applied by its
+ * own thread before its next access to that stripe's blocks; no core
+ * ever touches another's cache.  Cores only agree on time at the quantum
+ * barriers, so the order of accesses within a quantum, and with it the
+ * counts, can differ a little from run to run.
+ *
+ * Latencies are those of the configuration: an L1D hit that needs no
+ * request costs l1_latency, a miss the L2 latency (or memory_latency if
+ * it misses L2 as well), an upgrade the L2 latency, and a block supplied
+ * by another L1 the L2 latency plus that L1's.  Queueing on the
+ * interconnect is not modelled.
+ */
+typedef struct iplc_coherence iplc_coherence_t;
+
+const char *iplc_coherence_protocol_name(int protocol);
+int iplc_coherence_protocol_parse(const char *name);
+const char *iplc_coherence_message_name(int message);
+
+iplc_coherence_t *iplc_coherence_create(int protocol, int ncores, const iplc_level_config_t *l2,
+                                        int replacement, int l1_latency, int memory_latency);
+void iplc_coherence_destroy(iplc_coherence_t *coh);
+
+// Called from a core's own thread only
+int iplc_coherence_data(iplc_coherence_t *coh, int core, iplc_cache_t *l1d, uint32_t address,
+                        int store, int *latency);
+int iplc_coherence_fetch(iplc_coherence_t *coh, int core, iplc_cache_t *l1i, uint32_t address,
+                         int *latency);
+
+// Once every core has stopped
+void iplc_coherence_get_stats(const iplc_coherence_t *coh, int core,
+                              iplc_coherence_core_stats_t *stats);
+void iplc_coherence_report(const iplc_coherence_t *coh, long instructions);
+
+#endif
@@ -0,0 +1,389 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- event output
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "iplc-event.h"
+
+#define EVENT_CHUNK 65536       // events in one chunk of the ring, 1 MB
+#define EVENT_CHUNKS 8
+
+struct iplc_event_sink
+{
+    void (*emit)(iplc_event_sink_t *sink, const iplc_event_t *event);
+    int kind;
+    FILE *f;
+    long events;
+
+    // binary: the simulator fills chunk[fill % EVENT_CHUNKS], the writer drains the rest
+    iplc_event_t *chunk[EVENT_CHUNKS];
+    int count[EVENT_CHUNKS];    // events in each handed-over chunk
+    iplc_event_t *next;         // where the next event goes ...
+    iplc_event_t *end;          // ... and the end of the chunk being filled
+    unsigned long fill;         // chunks handed to the writer
+    unsigned long written;      // ... and written out
+    int done;
+    int error;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static const char *verbosity_names[NUM_VERBOSITIES] = {"stats", "accesses", "pipeline", "debug"};
+
+const char *iplc_verbosity_name(int verbosity)
+{
+    if (verbosity < 0 || verbosity >= NUM_VERBOSITIES)
+        return "?";
+    return verbosity_names[verbosity];
+}
+
+/*
+ * Look a verbosity up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_verbosity_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_VERBOSITIES; i++) {
+        if (strcasecmp(name, verbosity_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/************************************************************************************************/
+/* Text Functions *******************************************************************************/
+/************************************************************************************************/
+
+static const char *stage_names[] = {"FETCH:\t ", "DECODE:\t ", "ALU:\t ", "MEM:\t ", "WB:\t "};
+
+/*
+ * printf() was most of the time a run took when it printed every event,
+ * so lines are put together by hand.  These produce exactly what %s, %lu
+ * and %x do.
+ */
+static inline char *put_str(char *p, const char *s)
+{
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+static inline char *put_dec(char *p, unsigned long v)
+{
+    char digits[24];
+    int n = 0;
+
+    do {
+        digits[n++] = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0)
+        *p++ = digits[--n];
+    return p;
+}
+
+static inline char *put_hex(char *p, uint32_t v)
+{
+    static const char hex[] = "0123456789abcdef";
+    char digits[8];
+    int n = 0;
+
+    do {
+        digits[n++] = hex[v & 0xf];
+        v >>= 4;
+    } while (v != 0);
+    while (n > 0)
+        *p++ = digits[--n];
+    return p;
+}
+
+/*
+ * Print one event the way the simulator always has.
+ */
+void iplc_event_render(const iplc_event_t *e, FILE *out)
+{
+    char line[128], *p = line;
+
+    switch (e->kind) {
+        case EVENT_INST_HIT:
+        case EVENT_INST_MISS:
+        case EVENT_DATA_HIT:
+        case EVENT_DATA_MISS:
+            p = put_str(p, e->kind == EVENT_INST_HIT ? "INST HIT:\t Address 0x" :
+                           e->kind == EVENT_INST_MISS ? "INST MISS:\t Address 0x" :
+                           e->kind == EVENT_DATA_HIT ? "DATA HIT:\t Address 0x" : "DATA MISS:\t Address 0x");
+            p = put_hex(p, e->address);
+            p = put_str(p, " \n");
+            break;
+        case EVENT_STAGE:
+            if (e->stage >= sizeof(stage_names) / sizeof(stage_names[0]))
+                return;
+            if (e->stage == 0) {
+                p = put_str(p, "(cyc: ");
+                p = put_dec(p, (unsigned long) e->cycle);
+                p = put_str(p, ") ");
+            }
+            p = put_str(p, stage_names[e->stage]);
+            p = put_dec(p, e->itype);
+            p = put_str(p, ": 0x");
+            p = put_hex(p, e->address);
+            p = put_str(p, e->flags & EVENT_LAST ? " \n" : " \t");
+            break;
+        case EVENT_PIPE_FETCH:
+            p = put_str(p, "(cyc: ");
+            p = put_dec(p, (unsigned long) e->cycle);
+            p = put_str(p, ") 0x");
+            p = put_hex(p, e->address);
+            p = put_str(p, " \t");
+            break;
+        case EVENT_PIPE_STAGE:
+            *p++ = ' ';
+            *p++ = (char) e->stage;
+            *p++ = ':';
+            p = put_dec(p, (unsigned long) e->cycle);
+            if (e->flags & EVENT_LAST)
+                *p++ = '\n';
+            break;
+        case EVENT_RETIRE:
+            p = put_str(p, "DEBUG: Retired Instruction at 0x");
+            p = put_hex(p, e->address);
+            p = put_str(p, ", Type ");
+            p = put_dec(p, e->itype);
+            p = put_str(p, ", at Time ");
+            p = put_dec(p, (unsigned long) e->cycle);
+            p = put_str(p, " \n");
+            break;
+        default:
+            return;
+    }
+    fwrite(line, 1, (size_t) (p - line), out);
+}
+
+static void text_emit(iplc_event_sink_t *sink, const iplc_event_t *event)
+{
+    iplc_event_render(event, sink->f);
+}
+
+/*
+ * Print a binary event log as text.  Returns -1 if it is not one.
+ */
+int iplc_event_render_log(const char *path, FILE *out)
+{
+    iplc_event_header_t header;
+    iplc_event_t *events;
+    size_t n, i;
+    FILE *f;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("fopen failed for %s file\n", path);
+        return -1;
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1 || strcmp(header.magic, EVENT_MAGIC) != 0 ||
+        header.version != EVENT_VERSION || header.event_size != sizeof(iplc_event_t)) {
+        printf("%s is not an event log \n", path);
+        fclose(f);
+        return -1;
+    }
+
+    events = (iplc_event_t *) malloc(sizeof(iplc_event_t) * EVENT_CHUNK);
+    if (events == NULL) {
+        fclose(f);
+        return -1;
+    }
+    while ((n = fread(events, sizeof(iplc_event_t), EVENT_CHUNK, f)) > 0) {
+        for (i = 0; i < n; i++)
+            iplc_event_render(&events[i], out);
+    }
+    free(events);
+    fclose(f);
+    return 0;
+}
+
+/************************************************************************************************/
+/* Binary Functions *****************************************************************************/
+/************************************************************************************************/
+
+static void *event_writer(void *arg)
+{
+    iplc_event_sink_t *sink = (iplc_event_sink_t *) arg;
+    int k, n;
+
+    pthread_mutex_lock(&sink->lock);
+    for (;;) {
+        while (sink->written == sink->fill && !sink->done)
+            pthread_cond_wait(&sink->cond, &sink->lock);
+        if (sink->written == sink->fill)
+            break;
+
+        k = (int) (sink->written % EVENT_CHUNKS);
+        n = sink->count[k];
+        pthread_mutex_unlock(&sink->lock);
+        if (fwrite(sink->chunk[k], sizeof(iplc_event_t), (size_t) n, sink->f) != (size_t) n)
+            sink->error = 1;
+        pthread_mutex_lock(&sink->lock);
+
+        sink->written++;
+        pthread_cond_broadcast(&sink->cond);
+    }
+    pthread_mutex_unlock(&sink->lock);
+    return NULL;
+}
+
+/*
+ * Hand the chunk being filled to the writer and move on to the next one,
+ * once the writer has finished with it.
+ */
+static void event_handoff(iplc_event_sink_t *sink)
+{
+    int k = (int) (sink->fill % EVENT_CHUNKS);
+
+    pthread_mutex_lock(&sink->lock);
+    sink->count[k] = (int) (sink->next - sink->chunk[k]);
+    sink->fill++;
+    pthread_cond_broadcast(&sink->cond);
+    while (sink->fill - sink->written >= EVENT_CHUNKS)
+        pthread_cond_wait(&sink->cond, &sink->lock);
+    pthread_mutex_unlock(&sink->lock);
+
+    k = (int) (sink->fill % EVENT_CHUNKS);
+    sink->next = sink->chunk[k];
+    sink->end = sink->chunk[k] + EVENT_CHUNK;
+}
+
+static void binary_emit(iplc_event_sink_t *sink, const iplc_event_t *event)
+{
+    *sink->next++ = *event;
+    if (sink->next == sink->end)
+        event_handoff(sink);
+}
+
+/************************************************************************************************/
+/* Sink Functions *******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * A text sink writes to path, or stdout if path is NULL; a binary sink
+ * needs a path.  Returns NULL if the file cannot be written.
+ */
+iplc_event_sink_t *iplc_event_sink_create(int kind, const char *path)
+{
+    iplc_event_header_t header;
+    iplc_event_sink_t *sink;
+    int k;
+
+    if ((kind != EVENT_SINK_TEXT && kind != EVENT_SINK_BINARY) ||
+        (kind == EVENT_SINK_BINARY && path == NULL))
+        return NULL;
+
+    sink = (iplc_event_sink_t *) calloc(1, sizeof(iplc_event_sink_t));
+    if (sink == NULL)
+        return NULL;
+    sink->kind = kind;
+
+    if (kind == EVENT_SINK_TEXT) {
+        sink->emit = text_emit;
+        sink->f = path != NULL ? fopen(path, "w") : stdout;
+        if (sink->f == NULL) {
+            free(sink);
+            return NULL;
+        }
+        return sink;
+    }
+
+    sink->emit = binary_emit;
+    sink->f = fopen(path, "wb");
+    if (sink->f == NULL) {
+        free(sink);
+        return NULL;
+    }
+    for (k = 0; k < EVENT_CHUNKS; k++) {
+        sink->chunk[k] = (iplc_event_t *) malloc(sizeof(iplc_event_t) * EVENT_CHUNK);
+        if (sink->chunk[k] == NULL)
+            break;
+    }
+
+    bzero(&header, sizeof(header));
+    strcpy(header.magic, EVENT_MAGIC);
+    header.version = EVENT_VERSION;
+    header.event_size = sizeof(iplc_event_t);
+    if (k < EVENT_CHUNKS || fwrite(&header, sizeof(header), 1, sink->f) != 1) {
+        for (k = 0; k < EVENT_CHUNKS; k++)
+            free(sink->chunk[k]);
+        fclose(sink->f);
+        free(sink);
+        return NULL;
+    }
+
+    sink->next = sink->chunk[0];
+    sink->end = sink->chunk[0] + EVENT_CHUNK;
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->cond, NULL);
+    if (pthread_create(&sink->writer, NULL, event_writer, sink) != 0) {
+        pthread_mutex_destroy(&sink->lock);
+        pthread_cond_destroy(&sink->cond);
+        for (k = 0; k < EVENT_CHUNKS; k++)
+            free(sink->chunk[k]);
+        fclose(sink->f);
+        free(sink);
+        return NULL;
+    }
+    return sink;
+}
+
+/*
+ * Write out whatever is still buffered and close the sink.
+ */
+void iplc_event_sink_destroy(iplc_event_sink_t *sink)
+{
+    int k;
+
+    if (sink == NULL)
+        return;
+
+    if (sink->kind == EVENT_SINK_TEXT) {
+        if (sink->f != stdout)
+            fclose(sink->f);
+        else
+            fflush(stdout);
+        free(sink);
+        return;
+    }
+
+    k = (int) (sink->fill % EVENT_CHUNKS);
+    pthread_mutex_lock(&sink->lock);
+    sink->count[k] = (int) (sink->next - sink->chunk[k]);
+    if (sink->count[k] > 0)
+        sink->fill++;
+    sink->done = 1;
+    pthread_cond_broadcast(&sink->cond);
+    pthread_mutex_unlock(&sink->lock);
+    pthread_join(sink->writer, NULL);
+
+    if (sink->error)
+        printf("Event log is incomplete: a write failed \n");
+    pthread_mutex_destroy(&sink->lock);
+    pthread_cond_destroy(&sink->cond);
+    for (k = 0; k < EVENT_CHUNKS; k++)
+        free(sink->chunk[k]);
+    fclose(sink->f);
+    free(sink);
+}
+
+void iplc_event_emit(iplc_event_sink_t *sink, const iplc_event_t *event)
+{
+    sink->events++;
+    sink->emit(sink, event);
+}
+
+long iplc_event_count(const iplc_event_sink_t *sink)
+{
+    return sink->events;
+}
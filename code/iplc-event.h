@@ -0,0 +1,82 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- event output
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_EVENT_H
+#define IPLC_EVENT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * How much the simulator says as it goes, each level adding to the one
+ * before.  Configuration and the final report are printed at every level
+ * (unless the simulator is quiet).
+ *
+ *   stats      nothing per instruction
+ *   accesses   every instruction and data access, hit or miss
+ *   pipeline   the pipeline after every instruction (the original output)
+ *   debug      every retired instruction
+ */
+enum iplc_verbosity {VERBOSITY_STATS, VERBOSITY_ACCESSES, VERBOSITY_PIPELINE, VERBOSITY_DEBUG,
+                     NUM_VERBOSITIES};
+
+enum event_kind {EVENT_INST_HIT, EVENT_INST_MISS, EVENT_DATA_HIT, EVENT_DATA_MISS,
+                 EVENT_STAGE,           // classic pipeline: what one stage holds
+                 EVENT_PIPE_FETCH,      // configurable pipeline: an instruction went in
+                 EVENT_PIPE_STAGE,      // ... and the cycle it entered one stage
+                 EVENT_RETIRE, NUM_EVENT_KINDS};
+
+#define EVENT_LAST 0x1                  // flags: the last stage of a pipeline line
+
+#define EVENT_MAGIC "IPLCEVT"
+#define EVENT_VERSION 1
+
+/*
+ * One event, as written to a binary event log.
+ */
+typedef struct iplc_event
+{
+    uint64_t cycle;
+    uint32_t address;
+    uint8_t kind;               // enum event_kind
+    uint8_t itype;              // EVENT_STAGE, EVENT_RETIRE: enum instruction_type
+    uint8_t stage;              // EVENT_STAGE: stage number; EVENT_PIPE_STAGE: its letter
+    uint8_t flags;
+
+} iplc_event_t;
+
+typedef struct iplc_event_header
+{
+    char magic[8];              // EVENT_MAGIC
+    uint32_t version;
+    uint32_t event_size;        // sizeof(iplc_event_t)
+
+} iplc_event_header_t;
+
+/*
+ * Where events go.  A text sink renders each one straight away in the
+ * simulator's original formats.  A binary sink appends them to a log file:
+ * the simulator fills large chunks of a ring and the sink's own writer
+ * thread writes out each full chunk, so an event costs the simulator a
+ * 16-byte copy unless the disk falls a whole ring behind.
+ */
+typedef struct iplc_event_sink iplc_event_sink_t;
+
+enum event_sink_kind {EVENT_SINK_TEXT, EVENT_SINK_BINARY};
+
+const char *iplc_verbosity_name(int verbosity);
+int iplc_verbosity_parse(const char *name);
+
+iplc_event_sink_t *iplc_event_sink_create(int kind, const char *path);
+void iplc_event_sink_destroy(iplc_event_sink_t *sink);
+
+void iplc_event_emit(iplc_event_sink_t *sink, const iplc_event_t *event);
+long iplc_event_count(const iplc_event_sink_t *sink);
+
+// Text rendering, of one event or of a whole binary log
+void iplc_event_render(const iplc_event_t *event, FILE *out);
+int iplc_event_render_log(const char *path, FILE *out);
+
+#endif
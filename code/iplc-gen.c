@@ -0,0 +1,383 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- synthetic trace generators
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <strings.h>
+
+#include "iplc-gen.h"
+
+#define TEXT_BASE 0x00400000
+#define DATA_BASE 0x10010000    // lui $4, 4097
+#define STACK_TOP 0x7fffef48
+
+#define ARRAY_BYTES (4u << 20)
+#define STRIDE_BYTES 64
+#define CHASE_NODES 65536
+#define CHASE_NODE_BYTES 16
+#define MATRIX_N 64
+
+static const char *gen_names[NUM_GEN_KINDS] = {"sequential", "stride", "random", "pointer-chase",
+                                               "matmul", "branchy"};
+
+const char *iplc_gen_name(int kind)
+{
+    if (kind < 0 || kind >= NUM_GEN_KINDS)
+        return "?";
+    return gen_names[kind];
+}
+
+/*
+ * Look a generator up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_gen_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_GEN_KINDS; i++) {
+        if (strcasecmp(name, gen_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/************************************************************************************************/
+/* Emit Functions *******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Where the generated program is: the address of the next instruction and
+ * how many more lines may be written.  Every emit function is a no-op once
+ * left reaches 0, so a generator can finish its loop body regardless and
+ * the trace still comes out exactly as long as asked.
+ */
+typedef struct gen
+{
+    FILE *out;
+    long left;
+    uint32_t pc;
+    uint64_t rng;
+
+} gen_t;
+
+static uint32_t gen_random(gen_t *g)
+{
+    g->rng ^= g->rng << 13;
+    g->rng ^= g->rng >> 7;
+    g->rng ^= g->rng << 17;
+    return (uint32_t) (g->rng >> 32);
+}
+
+/*
+ * One instruction at pc; the next one is at next.
+ */
+static void gen_line(gen_t *g, uint32_t next, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (g->left <= 0)
+        return;
+
+    fprintf(g->out, "0x%08x  ", g->pc);
+    va_start(ap, fmt);
+    vfprintf(g->out, fmt, ap);
+    va_end(ap);
+    fputc('\n', g->out);
+
+    g->pc = next;
+    g->left--;
+}
+
+static void gen_rrr(gen_t *g, const char *op, int rd, int rs, int rt)
+{
+    gen_line(g, g->pc + 4, "%s $%d, $%d, $%d", op, rd, rs, rt);
+}
+
+static void gen_rri(gen_t *g, const char *op, int rd, int rs, int imm)
+{
+    gen_line(g, g->pc + 4, "%s $%d, $%d, %d", op, rd, rs, imm);
+}
+
+static void gen_mem(gen_t *g, const char *op, int rt, int offset, int base, uint32_t address)
+{
+    gen_line(g, g->pc + 4, "%s $%d, %d($%d): %08x", op, rt, offset, base, address);
+}
+
+static void gen_beq(gen_t *g, int rs, int rt, uint32_t target, int taken)
+{
+    gen_line(g, taken ? target : g->pc + 4, "beq $%d, $%d, %d", rs, rt,
+             (int) (target - g->pc - 4));
+}
+
+static void gen_jump(gen_t *g, const char *op, uint32_t target)
+{
+    gen_line(g, target, "%s 0x%08x", op, target);
+}
+
+/************************************************************************************************/
+/* Generator Functions **************************************************************************/
+/************************************************************************************************/
+
+/*
+ * loop:  lw, addu, addiu, addi, beq (to again when the array is done), j loop
+ * again: lui, ori, j loop
+ */
+static void gen_stream(gen_t *g, uint32_t step)
+{
+    uint32_t loop, again, a = DATA_BASE;
+    long n = ARRAY_BYTES / step, i = 0;
+
+    gen_line(g, g->pc + 4, "lui $4, %d", DATA_BASE >> 16);
+    gen_rri(g, "ori", 5, 0, (int) n);
+    loop = g->pc;
+    again = loop + 24;
+
+    while (g->left > 0) {
+        gen_mem(g, "lw", 8, 0, 4, a);
+        gen_rrr(g, "addu", 9, 9, 8);
+        gen_rri(g, "addiu", 4, 4, (int) step);
+        gen_rri(g, "addi", 5, 5, -1);
+        a += step;
+        if (++i < n) {
+            gen_beq(g, 5, 0, again, 0);
+            gen_jump(g, "j", loop);
+            continue;
+        }
+        gen_beq(g, 5, 0, again, 1);
+        gen_line(g, g->pc + 4, "lui $4, %d", DATA_BASE >> 16);
+        gen_rri(g, "ori", 5, 0, (int) n);
+        gen_jump(g, "j", loop);
+        a = DATA_BASE;
+        i = 0;
+    }
+}
+
+/*
+ * Read-modify-write of a random word each iteration; the index arithmetic
+ * is there so the address has a producer, not to reproduce the numbers.
+ */
+static void gen_random_access(gen_t *g)
+{
+    uint32_t loop, a;
+
+    gen_line(g, g->pc + 4, "lui $4, %d", DATA_BASE >> 16);
+    loop = g->pc;
+
+    while (g->left > 0) {
+        a = DATA_BASE + (gen_random(g) % (ARRAY_BYTES / 4)) * 4;
+        gen_rrr(g, "addu", 10, 10, 11);
+        gen_rri(g, "sll", 12, 10, 2);
+        gen_rrr(g, "addu", 12, 12, 4);
+        gen_mem(g, "lw", 8, 0, 12, a);
+        gen_rrr(g, "addu", 8, 8, 9);
+        gen_mem(g, "sw", 8, 0, 12, a);
+        gen_jump(g, "j", loop);
+    }
+}
+
+/*
+ * The list visits every node once in a random order and then starts over;
+ * each node holds the next one's address and a value.
+ */
+static int gen_pointer_chase(gen_t *g)
+{
+    uint32_t *next, *order, loop, exit, cur;
+    uint32_t i, j, t;
+
+    next = (uint32_t *) malloc(sizeof(uint32_t) * CHASE_NODES);
+    order = (uint32_t *) malloc(sizeof(uint32_t) * CHASE_NODES);
+    if (next == NULL || order == NULL) {
+        free(next);
+        free(order);
+        return -1;
+    }
+
+    for (i = 0; i < CHASE_NODES; i++)
+        order[i] = i;
+    for (i = CHASE_NODES - 1; i > 0; i--) {
+        j = gen_random(g) % (i + 1);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (i = 0; i < CHASE_NODES; i++)
+        next[order[i]] = order[(i + 1) % CHASE_NODES];
+
+    cur = order[0];
+    gen_line(g, g->pc + 4, "lui $4, %d", DATA_BASE >> 16);
+    loop = g->pc;
+    exit = loop + 20;
+
+    while (g->left > 0) {
+        gen_mem(g, "lw", 4, 0, 4, DATA_BASE + cur * CHASE_NODE_BYTES);
+        cur = next[cur];
+        gen_mem(g, "lw", 8, 4, 4, DATA_BASE + cur * CHASE_NODE_BYTES + 4);
+        gen_rrr(g, "addu", 9, 9, 8);
+        gen_beq(g, 4, 0, exit, 0);
+        gen_jump(g, "j", loop);
+    }
+
+    free(next);
+    free(order);
+    return 0;
+}
+
+/*
+ * c[i][j] = sum over k of a[i][k] op b[k][j], row major, add standing in
+ * for the multiply the trace format does not have:
+ *
+ * start:  lui, ori x4
+ * jloop:  add, ori
+ * kloop:  lw a, lw b, add, addu, addiu, addiu, addi, beq kdone, j kloop
+ * kdone:  sw c, addiu, addi, beq jdone, j jloop
+ * jdone:  addi, beq done, j jloop
+ * done:   j start
+ */
+static void gen_matmul(gen_t *g)
+{
+    const uint32_t a = DATA_BASE, b = a + MATRIX_N * MATRIX_N * 4, c = b + MATRIX_N * MATRIX_N * 4;
+    uint32_t start = g->pc, jloop = start + 20, kloop = jloop + 8;
+    uint32_t kdone = kloop + 36, jdone = kdone + 20, done = jdone + 12;
+    int i, j, k;
+
+    while (g->left > 0) {
+        gen_line(g, g->pc + 4, "lui $10, %d", DATA_BASE >> 16);
+        gen_rri(g, "ori", 11, 10, (int) (b - a));
+        gen_rri(g, "ori", 15, 10, (int) (c - a));
+        gen_rri(g, "ori", 16, 0, MATRIX_N);
+        gen_rri(g, "ori", 17, 0, MATRIX_N);
+
+        for (i = 0; i < MATRIX_N; i++) {
+            for (j = 0; j < MATRIX_N; j++) {
+                gen_rrr(g, "add", 13, 0, 0);
+                gen_rri(g, "ori", 14, 0, MATRIX_N);
+                for (k = 0; k < MATRIX_N; k++) {
+                    gen_mem(g, "lw", 8, 0, 10, a + (uint32_t) (i * MATRIX_N + k) * 4);
+                    gen_mem(g, "lw", 9, 0, 11, b + (uint32_t) (k * MATRIX_N + j) * 4);
+                    gen_rrr(g, "add", 12, 8, 9);
+                    gen_rrr(g, "addu", 13, 13, 12);
+                    gen_rri(g, "addiu", 10, 10, 4);
+                    gen_rri(g, "addiu", 11, 11, MATRIX_N * 4);
+                    gen_rri(g, "addi", 14, 14, -1);
+                    gen_beq(g, 14, 0, kdone, k == MATRIX_N - 1);
+                    if (k < MATRIX_N - 1)
+                        gen_jump(g, "j", kloop);
+                }
+                gen_mem(g, "sw", 13, 0, 15, c + (uint32_t) (i * MATRIX_N + j) * 4);
+                gen_rri(g, "addiu", 15, 15, 4);
+                gen_rri(g, "addi", 16, 16, -1);
+                gen_beq(g, 16, 0, jdone, j == MATRIX_N - 1);
+                if (j < MATRIX_N - 1)
+                    gen_jump(g, "j", jloop);
+            }
+            gen_rri(g, "addi", 17, 17, -1);
+            gen_beq(g, 17, 0, done, i == MATRIX_N - 1);
+            if (i < MATRIX_N - 1)
+                gen_jump(g, "j", jloop);
+        }
+        gen_jump(g, "j", start);
+    }
+}
+
+/*
+ * loop:  addi, beq +8 (always, over one never run), ori, beq +8 (every other), addu,
+ *        beq +8 (random), addu, beq +8 (same as the random one), addu,
+ *        beq nocall (unless every eighth), jal func
+ * nocall: j loop
+ * func:  addiu, sw, lw, addiu, jr $31
+ */
+static void gen_branchy(gen_t *g)
+{
+    uint32_t loop = g->pc, nocall = loop + 48, func = nocall + 4, sp = STACK_TOP;
+    long iter;
+    int r;
+
+    for (iter = 0; g->left > 0; iter++) {
+        r = gen_random(g) & 1;
+
+        gen_rri(g, "addi", 5, 5, 1);
+        gen_beq(g, 0, 0, g->pc + 8, 1);
+        gen_rri(g, "ori", 7, 5, 0);
+        gen_beq(g, 8, 0, g->pc + 8, (int) (iter & 1));
+        if (!(iter & 1))
+            gen_rrr(g, "addu", 6, 6, 5);
+        gen_beq(g, 9, 0, g->pc + 8, r);
+        if (!r)
+            gen_rrr(g, "addu", 6, 6, 7);
+        gen_beq(g, 10, 0, g->pc + 8, r);
+        if (!r)
+            gen_rrr(g, "addu", 6, 6, 5);
+        gen_beq(g, 12, 0, nocall, (iter & 7) != 0);
+        if ((iter & 7) == 0) {
+            gen_jump(g, "jal", func);
+            gen_rri(g, "addiu", 29, 29, -4);
+            gen_mem(g, "sw", 31, 0, 29, sp - 4);
+            gen_mem(g, "lw", 31, 0, 29, sp - 4);
+            gen_rri(g, "addiu", 29, 29, 4);
+            gen_line(g, nocall, "jr $31");
+        }
+        gen_jump(g, "j", loop);
+    }
+}
+
+/************************************************************************************************/
+/* Output Functions *****************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Write instructions lines of workload kind to out.  Returns -1 for an
+ * unknown kind, out of memory or a write error.
+ */
+int iplc_gen_write(int kind, long instructions, uint64_t seed, FILE *out)
+{
+    gen_t g;
+
+    if (kind < 0 || kind >= NUM_GEN_KINDS || instructions < 0)
+        return -1;
+
+    g.out = out;
+    g.left = instructions;
+    g.pc = TEXT_BASE;
+    g.rng = seed ? seed : 0x9E3779B97F4A7C15ull;
+
+    switch (kind) {
+        case GEN_SEQUENTIAL:
+            gen_stream(&g, 4);
+            break;
+        case GEN_STRIDE:
+            gen_stream(&g, STRIDE_BYTES);
+            break;
+        case GEN_RANDOM:
+            gen_random_access(&g);
+            break;
+        case GEN_POINTER_CHASE:
+            if (gen_pointer_chase(&g) != 0)
+                return -1;
+            break;
+        case GEN_MATMUL:
+            gen_matmul(&g);
+            break;
+        case GEN_BRANCHY:
+            gen_branchy(&g);
+            break;
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+int iplc_gen_file(int kind, long instructions, uint64_t seed, const char *path)
+{
+    FILE *out = fopen(path, "w");
+    int rc;
+
+    if (out == NULL) {
+        printf("fopen failed for %s file\n", path);
+        return -1;
+    }
+    rc = iplc_gen_write(kind, instructions, seed, out);
+    if (fclose(out) != 0)
+        rc = -1;
+    return rc;
+}
@@ -0,0 +1,38 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- synthetic trace generators
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_GEN_H
+#define IPLC_GEN_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum gen_kind {GEN_SEQUENTIAL, GEN_STRIDE, GEN_RANDOM, GEN_POINTER_CHASE, GEN_MATMUL,
+               GEN_BRANCHY, NUM_GEN_KINDS};
+
+/*
+ * Synthetic workloads written in the text trace format, as small MIPS
+ * loops whose control flow and data addresses are consistent with each
+ * other:
+ *
+ *   sequential     sum a 4 MB array a word at a time
+ *   stride         the same, one word every 64 bytes
+ *   random         load (and now and then store) random words of 4 MB
+ *   pointer-chase  follow a randomly ordered linked list of 64K nodes,
+ *                  each load's address coming from the one before
+ *   matmul         64x64 word matrix multiply, i-j-k loop nest
+ *   branchy        short blocks ending in branches that are always
+ *                  taken, alternate, are random, or copy the random one,
+ *                  with a call and return every eighth iteration
+ *
+ * The same kind, length and seed always give the same trace.
+ */
+const char *iplc_gen_name(int kind);
+int iplc_gen_parse(const char *name);
+
+int iplc_gen_write(int kind, long instructions, uint64_t seed, FILE *out);
+int iplc_gen_file(int kind, long instructions, uint64_t seed, const char *path);
+
+#endif
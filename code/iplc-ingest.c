@@ -0,0 +1,363 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- pipelined text trace ingest
+ ***********************************************************************/
+/***********************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "iplc-ingest.h"
+#include "iplc-perf.h"
+
+#define CACHE_LINE 64
+
+/*
+ * A bounded single-producer single-consumer ring of fixed-size slots.  The
+ * producer fills the slot at head and publishes it; the consumer uses the
+ * slot at tail and releases it.  Only the producer moves head and only the
+ * consumer moves tail, so each side needs nothing but an acquire load of
+ * the other's counter.  The two counters sit on their own cache lines.
+ */
+typedef struct ingest_ring
+{
+    _Atomic unsigned long head;         // slots published
+    char pad0[CACHE_LINE - sizeof(unsigned long)];
+    _Atomic unsigned long tail;         // slots released
+    char pad1[CACHE_LINE - sizeof(unsigned long)];
+    _Atomic int closed;                 // the producer has published its last slot
+    _Atomic int aborted;                // the consumer has stopped early
+    int slots;
+    size_t slot_size;
+    char *storage;
+    size_t *used;                       // bytes or records in each published slot
+
+} ingest_ring_t;
+
+struct iplc_ingest
+{
+    FILE *f;
+    const char *path;
+    ingest_ring_t raw;                  // reader -> decoder: whole lines of text
+    ingest_ring_t decoded;              // decoder -> caller: trace records
+    pthread_t reader;
+    pthread_t decoder;
+    _Atomic int error;
+};
+
+/************************************************************************************************/
+/* Ring Functions *******************************************************************************/
+/************************************************************************************************/
+
+static int ring_init(ingest_ring_t *r, int slots, size_t slot_size)
+{
+    bzero(r, sizeof(ingest_ring_t));
+    r->slots = slots;
+    r->slot_size = slot_size;
+    r->storage = (char *) malloc(slot_size * (size_t) slots);
+    r->used = (size_t *) calloc((size_t) slots, sizeof(size_t));
+    if (r->storage == NULL || r->used == NULL) {
+        free(r->storage);
+        free(r->used);
+        return -1;
+    }
+    return 0;
+}
+
+static void ring_free(ingest_ring_t *r)
+{
+    free(r->storage);
+    free(r->used);
+}
+
+/*
+ * Back off while the other side catches up: spin briefly, then yield, then
+ * sleep, so a stage waiting on a much slower one does not burn its core.
+ */
+static void ring_wait(int *spins)
+{
+    struct timespec nap = {0, 20000};
+
+    if (++*spins < 64)
+        return;
+    if (*spins < 1024)
+        sched_yield();
+    else
+        nanosleep(&nap, NULL);
+}
+
+/*
+ * The next slot to fill, once there is room.  NULL if the consumer has
+ * gone away.
+ */
+static void *ring_acquire(ingest_ring_t *r)
+{
+    unsigned long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    int spins = 0;
+
+    while (head - atomic_load_explicit(&r->tail, memory_order_acquire) == (unsigned long) r->slots) {
+        if (atomic_load_explicit(&r->aborted, memory_order_relaxed))
+            return NULL;
+        ring_wait(&spins);
+    }
+    return r->storage + (head % r->slots) * r->slot_size;
+}
+
+static void ring_publish(ingest_ring_t *r, size_t used)
+{
+    unsigned long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    r->used[head % r->slots] = used;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+static void ring_close(ingest_ring_t *r)
+{
+    atomic_store_explicit(&r->closed, 1, memory_order_release);
+}
+
+/*
+ * The oldest published slot, and in *used how full it is, once there is
+ * one.  NULL once the producer has closed the ring and it is empty.
+ */
+static void *ring_peek(ingest_ring_t *r, size_t *used)
+{
+    unsigned long tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    int spins = 0;
+
+    while (atomic_load_explicit(&r->head, memory_order_acquire) == tail) {
+        // published before closed, so a second look at head is the last word
+        if (atomic_load_explicit(&r->closed, memory_order_acquire) &&
+            atomic_load_explicit(&r->head, memory_order_acquire) == tail)
+            return NULL;
+        ring_wait(&spins);
+    }
+    *used = r->used[tail % r->slots];
+    return r->storage + (tail % r->slots) * r->slot_size;
+}
+
+static void ring_release(ingest_ring_t *r)
+{
+    unsigned long tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+static void ring_abort(ingest_ring_t *r)
+{
+    atomic_store_explicit(&r->aborted, 1, memory_order_relaxed);
+}
+
+/************************************************************************************************/
+/* Stage Functions ******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Fill each chunk with as much of the file as fits, cut after its last
+ * newline; the partial line left over starts the next chunk.  A pipe can
+ * come up short in the middle of the stream, so a chunk is only sent
+ * uncut once the file has ended.  Every chunk has room for a terminating
+ * NUL past its INGEST_CHUNK bytes.
+ */
+static void *ingest_reader(void *arg)
+{
+    iplc_ingest_t *in = (iplc_ingest_t *) arg;
+    char *carry, *chunk, *end;
+    size_t kept = 0, n, cut;
+
+    carry = (char *) malloc(INGEST_CHUNK);
+    if (carry == NULL) {
+        atomic_store(&in->error, 1);
+        ring_close(&in->raw);
+        return NULL;
+    }
+
+    for (;;) {
+        chunk = (char *) ring_acquire(&in->raw);
+        if (chunk == NULL)
+            break;
+
+        memcpy(chunk, carry, kept);
+        n = kept;
+        do {
+            n += fread(chunk + n, 1, INGEST_CHUNK - n, in->f);
+        } while (n < INGEST_CHUNK && !feof(in->f) && !ferror(in->f));
+        if (n == kept) {
+            // end of file: a last line without a newline is still a line
+            if (kept > 0)
+                ring_publish(&in->raw, kept);
+            break;
+        }
+
+        end = n < INGEST_CHUNK ? NULL : (char *) memrchr(chunk, '\n', n);
+        if (n < INGEST_CHUNK) {
+            cut = n;            // the file ended: the rest of it, sent whole
+        }
+        else if (end == NULL) {
+            printf("Trace line longer than %d bytes in %s \n", INGEST_CHUNK, in->path);
+            atomic_store(&in->error, 1);
+            break;
+        }
+        else {
+            cut = (size_t) (end - chunk) + 1;
+        }
+        kept = n - cut;
+        memcpy(carry, chunk + cut, kept);
+        ring_publish(&in->raw, cut);
+    }
+
+    if (ferror(in->f)) {
+        printf("read failed for %s file\n", in->path);
+        atomic_store(&in->error, 1);
+    }
+    free(carry);
+    ring_close(&in->raw);
+    return NULL;
+}
+
+/*
+ * Decode chunk after chunk, line by line, into batches of records.  A
+ * malformed line stops everything: the reader is told to give up, and the
+ * records before it are still passed on.  In a build with IPLC_PERF the
+ * CPU time spent decoding is charged to the parse phase.
+ */
+static void *ingest_decoder(void *arg)
+{
+    iplc_ingest_t *in = (iplc_ingest_t *) arg;
+    trace_record_t *batch;
+    char *chunk, *line, *end, *nl;
+    size_t used, n = 0;
+    uint64_t start;
+
+    batch = (trace_record_t *) ring_acquire(&in->decoded);
+    while (batch != NULL && (chunk = (char *) ring_peek(&in->raw, &used)) != NULL) {
+        start = IPLC_PERF_THREAD_NS();
+        end = chunk + used;
+        *end = '\0';
+        for (line = chunk; line < end; line = nl + 1) {
+            nl = (char *) memchr(line, '\n', (size_t) (end - line));
+            if (nl == NULL)
+                nl = end;
+            *nl = '\0';
+
+            if (iplc_sim_decode(line, &batch[n]) != 0) {
+                atomic_store(&in->error, 1);
+                break;
+            }
+            if (++n == INGEST_BATCH) {
+                IPLC_PERF_CHARGE(PERF_PARSE, IPLC_PERF_THREAD_NS() - start);
+                ring_publish(&in->decoded, n);
+                n = 0;
+                batch = (trace_record_t *) ring_acquire(&in->decoded);
+                start = IPLC_PERF_THREAD_NS();
+                if (batch == NULL)
+                    break;
+            }
+        }
+        IPLC_PERF_CHARGE(PERF_PARSE, IPLC_PERF_THREAD_NS() - start);
+        ring_release(&in->raw);
+        if (atomic_load(&in->error) || batch == NULL)
+            break;
+    }
+
+    ring_abort(&in->raw);
+    if (batch != NULL && n > 0)
+        ring_publish(&in->decoded, n);
+    ring_close(&in->decoded);
+    return NULL;
+}
+
+/************************************************************************************************/
+/* Ingest Functions *****************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Open a text trace and start reading and decoding it.  Returns NULL if
+ * it cannot be opened.
+ */
+iplc_ingest_t *iplc_ingest_open(const char *path)
+{
+    iplc_ingest_t *in;
+
+    in = (iplc_ingest_t *) calloc(1, sizeof(iplc_ingest_t));
+    if (in == NULL)
+        return NULL;
+
+    in->path = path;
+    in->f = fopen(path, "r");
+    if (in->f == NULL) {
+        printf("fopen failed for %s file\n", path);
+        free(in);
+        return NULL;
+    }
+
+    if (ring_init(&in->raw, INGEST_CHUNKS, INGEST_CHUNK + 1) != 0 ||
+        ring_init(&in->decoded, INGEST_BATCHES, sizeof(trace_record_t) * INGEST_BATCH) != 0) {
+        ring_free(&in->raw);
+        fclose(in->f);
+        free(in);
+        return NULL;
+    }
+
+    if (pthread_create(&in->reader, NULL, ingest_reader, in) != 0) {
+        ring_free(&in->raw);
+        ring_free(&in->decoded);
+        fclose(in->f);
+        free(in);
+        return NULL;
+    }
+    if (pthread_create(&in->decoder, NULL, ingest_decoder, in) != 0) {
+        ring_abort(&in->raw);
+        pthread_join(in->reader, NULL);
+        ring_free(&in->raw);
+        ring_free(&in->decoded);
+        fclose(in->f);
+        free(in);
+        return NULL;
+    }
+    return in;
+}
+
+/*
+ * The next batch of records and in *count how many; NULL at the end of the
+ * trace, or at a line that could not be read.
+ */
+const trace_record_t *iplc_ingest_next(iplc_ingest_t *in, long *count)
+{
+    size_t used = 0;
+    const trace_record_t *batch = (const trace_record_t *) ring_peek(&in->decoded, &used);
+
+    *count = batch != NULL ? (long) used : 0;
+    return batch;
+}
+
+void iplc_ingest_release(iplc_ingest_t *in)
+{
+    ring_release(&in->decoded);
+}
+
+/*
+ * Stop both threads, even part way through, and free everything.  Returns
+ * -1 if the trace could not all be read and decoded.
+ */
+int iplc_ingest_close(iplc_ingest_t *in)
+{
+    int error;
+
+    ring_abort(&in->decoded);
+    ring_abort(&in->raw);
+    pthread_join(in->decoder, NULL);
+    pthread_join(in->reader, NULL);
+
+    error = atomic_load(&in->error);
+    ring_free(&in->raw);
+    ring_free(&in->decoded);
+    fclose(in->f);
+    free(in);
+    return error ? -1 : 0;
+}
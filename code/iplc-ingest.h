@@ -0,0 +1,35 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- pipelined text trace ingest
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_INGEST_H
+#define IPLC_INGEST_H
+
+#include "iplc-sim.h"
+
+#define INGEST_CHUNK (1 << 20)      // bytes per read, and the longest line there can be
+#define INGEST_CHUNKS 4
+#define INGEST_BATCH 4096           // records per decoded batch
+#define INGEST_BATCHES 8
+
+/*
+ * Reads a text trace as three stages running at once: a reader thread
+ * doing large sequential reads, a decoder thread turning whole lines into
+ * trace records, and whoever calls iplc_ingest_next(), usually the
+ * simulator.  Each stage hands the next one its output through a bounded
+ * single-producer single-consumer ring that needs no locks, and waits when
+ * the ring in front of it is full, so a run goes as fast as the slowest
+ * stage rather than the three one after another.
+ *
+ * Records come in batches, in trace order.  A batch stays valid until it
+ * is released, and must be released before the next one is asked for.
+ */
+typedef struct iplc_ingest iplc_ingest_t;
+
+iplc_ingest_t *iplc_ingest_open(const char *path);
+const trace_record_t *iplc_ingest_next(iplc_ingest_t *ingest, long *count);
+void iplc_ingest_release(iplc_ingest_t *ingest);
+int iplc_ingest_close(iplc_ingest_t *ingest);
+
+#endif
@@ -0,0 +1,160 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- interval statistics
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "iplc-interval.h"
+
+struct iplc_interval
+{
+    FILE *f;
+    int format;
+    unsigned long period;
+    unsigned long next;         // instruction count that ends the current row
+    iplc_interval_counters_t last;  // totals when it began
+    long rows;
+};
+
+static const char *format_names[] = {"csv", "binary"};
+
+const char *iplc_interval_format_name(int format)
+{
+    if (format != INTERVAL_CSV && format != INTERVAL_BINARY)
+        return "?";
+    return format_names[format];
+}
+
+/*
+ * Look a format up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_interval_format_parse(const char *name)
+{
+    if (strcasecmp(name, format_names[INTERVAL_CSV]) == 0)
+        return INTERVAL_CSV;
+    if (strcasecmp(name, format_names[INTERVAL_BINARY]) == 0)
+        return INTERVAL_BINARY;
+    return -1;
+}
+
+/*
+ * Open path for a row every period instructions and write the header.
+ * Returns NULL if it cannot be written or period is 0.
+ */
+iplc_interval_t *iplc_interval_create(const char *path, int format, unsigned long period)
+{
+    iplc_interval_header_t header;
+    iplc_interval_t *iv;
+    int ok;
+
+    if (period == 0 || (format != INTERVAL_CSV && format != INTERVAL_BINARY))
+        return NULL;
+
+    iv = (iplc_interval_t *) calloc(1, sizeof(iplc_interval_t));
+    if (iv == NULL)
+        return NULL;
+
+    iv->f = fopen(path, format == INTERVAL_BINARY ? "wb" : "w");
+    if (iv->f == NULL) {
+        free(iv);
+        return NULL;
+    }
+    iv->format = format;
+    iv->period = period;
+    iv->next = period;
+
+    if (format == INTERVAL_BINARY) {
+        bzero(&header, sizeof(header));
+        strcpy(header.magic, INTERVAL_MAGIC);
+        header.version = INTERVAL_VERSION;
+        header.row_size = sizeof(iplc_interval_row_t);
+        header.period = period;
+        ok = fwrite(&header, sizeof(header), 1, iv->f) == 1;
+    }
+    else {
+        ok = fprintf(iv->f, "interval,instructions,window,cycles,cpi,l1i_miss_rate,l1d_miss_rate,"
+                     "branch_accuracy,memory_stalls,branch_stalls,hazard_stalls\n") > 0;
+    }
+    if (!ok) {
+        iplc_interval_destroy(iv);
+        return NULL;
+    }
+    return iv;
+}
+
+void iplc_interval_destroy(iplc_interval_t *iv)
+{
+    if (iv == NULL)
+        return;
+
+    fclose(iv->f);
+    free(iv);
+}
+
+/*
+ * Start the next row from now, as when the counters were just restored
+ * from somewhere else.  Returns the instruction count that ends it.
+ */
+unsigned long iplc_interval_start(iplc_interval_t *iv, const iplc_interval_counters_t *now)
+{
+    iv->last = *now;
+    iv->next = now->instructions + iv->period;
+    return iv->next;
+}
+
+static inline double interval_rate(long n, long d)
+{
+    return d > 0 ? (double) n / (double) d : 0.0;
+}
+
+/*
+ * End the current row at now and write it out, unless no instruction has
+ * retired since it began.  Returns the instruction count that ends the
+ * next one.
+ */
+unsigned long iplc_interval_record(iplc_interval_t *iv, const iplc_interval_counters_t *now)
+{
+    const iplc_interval_counters_t *l = &iv->last;
+    iplc_interval_row_t row;
+
+    if (now->instructions <= l->instructions)
+        return iv->next;
+
+    row.interval = (uint64_t) iv->rows;
+    row.instructions = now->instructions;
+    row.window = now->instructions - l->instructions;
+    row.cycles = now->cycles - l->cycles;
+    row.cpi = (double) row.cycles / (double) row.window;
+    row.l1i_miss_rate = interval_rate(now->fetch_misses - l->fetch_misses, now->fetches - l->fetches);
+    row.l1d_miss_rate = interval_rate(now->data_misses - l->data_misses,
+                                      now->data_accesses - l->data_accesses);
+    row.branch_accuracy = now->branches > l->branches ?
+                          1.0 - interval_rate(now->mispredictions - l->mispredictions,
+                                              now->branches - l->branches) : 1.0;
+    row.memory_stalls = (uint64_t) (now->memory_stalls - l->memory_stalls);
+    row.branch_stalls = (uint64_t) (now->branch_stalls - l->branch_stalls);
+    row.hazard_stalls = (uint64_t) (now->hazard_stalls - l->hazard_stalls);
+
+    if (iv->format == INTERVAL_BINARY)
+        fwrite(&row, sizeof(row), 1, iv->f);
+    else
+        fprintf(iv->f, "%lu,%lu,%lu,%lu,%f,%f,%f,%f,%lu,%lu,%lu\n", (unsigned long) row.interval,
+                (unsigned long) row.instructions, (unsigned long) row.window,
+                (unsigned long) row.cycles, row.cpi, row.l1i_miss_rate, row.l1d_miss_rate,
+                row.branch_accuracy, (unsigned long) row.memory_stalls,
+                (unsigned long) row.branch_stalls, (unsigned long) row.hazard_stalls);
+
+    iv->rows++;
+    iv->last = *now;
+    while (iv->next <= now->instructions)
+        iv->next += iv->period;
+    return iv->next;
+}
+
+long iplc_interval_rows(const iplc_interval_t *iv)
+{
+    return iv->rows;
+}
@@ -0,0 +1,84 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- interval statistics
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_INTERVAL_H
+#define IPLC_INTERVAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define INTERVAL_MAGIC "IPLCIVL"
+#define INTERVAL_VERSION 1
+
+enum interval_format {INTERVAL_CSV, INTERVAL_BINARY};
+
+/*
+ * A time series of the simulator's counters: one row every period retired
+ * instructions, each covering only the instructions since the row before.
+ * The last row covers whatever is left at the end, and so may be shorter.
+ *
+ * CSV files start with a header line naming the columns.  Binary files
+ * start with an iplc_interval_header_t and then hold the rows as they are,
+ * little or big endian as the machine that wrote them.
+ */
+typedef struct iplc_interval iplc_interval_t;
+
+/*
+ * Running totals, as the simulator has them.  Only differences between two
+ * of these end up in a row.
+ */
+typedef struct iplc_interval_counters
+{
+    unsigned long instructions;
+    unsigned long cycles;
+    long fetches;
+    long fetch_misses;
+    long data_accesses;
+    long data_misses;
+    long branches;
+    long mispredictions;
+    long memory_stalls;         // cycles accesses took past an L1 hit
+    long branch_stalls;         // cycles lost to mispredicted branches
+    long hazard_stalls;         // cycles waiting for operands or memory ports
+
+} iplc_interval_counters_t;
+
+typedef struct iplc_interval_header
+{
+    char magic[8];              // INTERVAL_MAGIC
+    uint32_t version;
+    uint32_t row_size;          // sizeof(iplc_interval_row_t)
+    uint64_t period;
+
+} iplc_interval_header_t;
+
+typedef struct iplc_interval_row
+{
+    uint64_t interval;          // from 0
+    uint64_t instructions;      // retired by its end
+    uint64_t window;            // retired during it
+    uint64_t cycles;            // ... and the cycles they took
+    double cpi;
+    double l1i_miss_rate;
+    double l1d_miss_rate;
+    double branch_accuracy;     // 1 with no branches
+    uint64_t memory_stalls;
+    uint64_t branch_stalls;
+    uint64_t hazard_stalls;
+
+} iplc_interval_row_t;
+
+const char *iplc_interval_format_name(int format);
+int iplc_interval_format_parse(const char *name);
+
+iplc_interval_t *iplc_interval_create(const char *path, int format, unsigned long period);
+void iplc_interval_destroy(iplc_interval_t *iv);
+
+unsigned long iplc_interval_start(iplc_interval_t *iv, const iplc_interval_counters_t *now);
+unsigned long iplc_interval_record(iplc_interval_t *iv, const iplc_interval_counters_t *now);
+
+long iplc_interval_rows(const iplc_interval_t *iv);
+
+#endif
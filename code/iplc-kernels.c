@@ -0,0 +1,245 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- cache kernels specialized per geometry
+ ***********************************************************************/
+/***********************************************************************/
+#include <stddef.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "iplc-kernels.h"
+
+#if defined(IPLC_SPECIALIZE)
+
+#define NO_WAY 0xff
+
+/************************************************************************************************/
+/* Kernel Templates *****************************************************************************/
+/************************************************************************************************/
+/*
+ * Each template is called with literal O (block offset bits), I (index
+ * bits) and A (ways), and forced inline so every kernel below gets its own
+ * copy with those folded in.  They do what the generic functions in
+ * iplc-cache.c do for a cache without prefetching, and the replacement
+ * state updates on a hit are the ones in iplc-repl.c with A in place of
+ * cache->assoc.
+ */
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+KERNEL_INLINE int kernel_lookup(const iplc_cache_t *cache, uint32_t set, uint32_t tag, const int A)
+{
+    const uint32_t *tags = cache->tags + (size_t) set * A;
+    uint64_t match = 0;
+    int i;
+
+#if defined(__SSE2__)
+    if ((A & 3) == 0) {
+        __m128i key = _mm_set1_epi32((int) tag);
+#pragma GCC unroll 16
+        for (i = 0; i < A; i += 4) {
+            __m128i t = _mm_load_si128((const __m128i *) (tags + i));
+            match |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, key))) << i;
+        }
+    }
+    else
+#endif
+    {
+#pragma GCC unroll 64
+        for (i = 0; i < A; i++)
+            match |= (uint64_t) (tags[i] == tag) << i;
+    }
+
+    match &= cache->valid[set];
+    return match ? __builtin_ctzll(match) : -1;
+}
+
+KERNEL_INLINE void kernel_touch(iplc_cache_t *cache, uint8_t *meta, int way, const int A)
+{
+    uint8_t *prev = meta + 2, *next = meta + 2 + A;
+    uint64_t bits;
+    int node, i;
+
+    switch (cache->replacement) {
+        case REPL_LRU:
+            if (meta[0] == way)
+                return;
+            next[prev[way]] = next[way];
+            if (next[way] != NO_WAY)
+                prev[next[way]] = prev[way];
+            else
+                meta[1] = prev[way];
+            prev[way] = NO_WAY;
+            next[way] = meta[0];
+            prev[meta[0]] = way;
+            meta[0] = way;
+            return;
+
+        case REPL_PLRU:
+            __builtin_memcpy(&bits, meta, sizeof(bits));
+            node = way + A;
+#pragma GCC unroll 8
+            for (i = A; i > 1; i >>= 1) {
+                int right = node & 1;
+                node >>= 1;
+                if (right)
+                    bits &= ~(1ull << node);
+                else
+                    bits |= 1ull << node;
+            }
+            __builtin_memcpy(meta, &bits, sizeof(bits));
+            return;
+
+        case REPL_FIFO:
+        case REPL_RANDOM:
+            return;
+
+        case REPL_SRRIP:
+        case REPL_BRRIP:
+            meta[way] = 0;
+            return;
+    }
+    cache->policy->touch(cache, meta, way);
+}
+
+KERNEL_INLINE int kernel_probe(iplc_cache_t *cache, uint32_t address, const int O, const int I,
+                               const int A)
+{
+    uint32_t set = (address >> O) & ((1u << I) - 1);
+    int way;
+
+    cache->access++;
+
+    way = kernel_lookup(cache, set, address >> (I + O), A);
+    if (way >= 0) {
+        cache->hit++;
+        kernel_touch(cache, cache->repl + (size_t) set * cache->repl_stride, way, A);
+        return 1;
+    }
+
+    cache->miss++;
+    return 0;
+}
+
+KERNEL_INLINE int kernel_access(iplc_cache_t *cache, uint32_t address, const int O, const int I,
+                                const int A)
+{
+    const uint64_t all_ways = A == 64 ? ~0ull : (1ull << A) - 1;
+    uint32_t set = (address >> O) & ((1u << I) - 1);
+    uint8_t *meta;
+    uint64_t free_ways;
+    uint32_t *slot;
+    int way;
+
+    if (kernel_probe(cache, address, O, I, A))
+        return 1;
+
+    meta = cache->repl + (size_t) set * cache->repl_stride;
+    slot = cache->tags + (size_t) set * A;
+    free_ways = ~cache->valid[set] & all_ways;
+    if (free_ways) {
+        way = __builtin_ctzll(free_ways);
+        cache->victim_dirty = 0;
+        cache->policy->insert(cache, meta, way);
+    }
+    else {
+        way = cache->policy->victim(cache, meta);
+        cache->policy->insert(cache, meta, way);
+        cache->evictions++;
+        cache->victim = (slot[way] << (I + O)) | (set << O);
+        cache->victim_dirty = (int) ((cache->dirty[set] >> way) & 1);
+        cache->writebacks += cache->victim_dirty;
+    }
+    slot[way] = address >> (I + O);
+    cache->valid[set] |= 1ull << way;
+    cache->dirty[set] &= ~(1ull << way);
+    return 0;
+}
+
+/************************************************************************************************/
+/* Kernels **************************************************************************************/
+/************************************************************************************************/
+/*
+ * The design space, as rows of (offset bits, ways, largest index bits that
+ * still fits MAX_CACHE_SIZE).  UPTO_n expands a row into index bits 0..n.
+ */
+#define UPTO_0(K, o, a) K(o, 0, a)
+#define UPTO_1(K, o, a) UPTO_0(K, o, a) K(o, 1, a)
+#define UPTO_2(K, o, a) UPTO_1(K, o, a) K(o, 2, a)
+#define UPTO_3(K, o, a) UPTO_2(K, o, a) K(o, 3, a)
+#define UPTO_4(K, o, a) UPTO_3(K, o, a) K(o, 4, a)
+#define UPTO_5(K, o, a) UPTO_4(K, o, a) K(o, 5, a)
+#define UPTO_6(K, o, a) UPTO_5(K, o, a) K(o, 6, a)
+#define UPTO_7(K, o, a) UPTO_6(K, o, a) K(o, 7, a)
+
+#define KERNEL_GEOMETRIES(K) \
+    UPTO_7(K, 2, 1)  UPTO_6(K, 2, 2)  UPTO_5(K, 2, 4)  UPTO_4(K, 2, 8) \
+    UPTO_3(K, 2, 16) UPTO_2(K, 2, 32) UPTO_1(K, 2, 64) \
+    UPTO_6(K, 3, 1)  UPTO_5(K, 3, 2)  UPTO_4(K, 3, 4)  UPTO_3(K, 3, 8) \
+    UPTO_2(K, 3, 16) UPTO_1(K, 3, 32) UPTO_0(K, 3, 64) \
+    UPTO_6(K, 4, 1)  UPTO_5(K, 4, 2)  UPTO_4(K, 4, 4)  UPTO_3(K, 4, 8) \
+    UPTO_2(K, 4, 16) UPTO_1(K, 4, 32) UPTO_0(K, 4, 64) \
+    UPTO_5(K, 5, 1)  UPTO_4(K, 5, 2)  UPTO_3(K, 5, 4)  UPTO_2(K, 5, 8) \
+    UPTO_1(K, 5, 16) UPTO_0(K, 5, 32) \
+    UPTO_4(K, 6, 1)  UPTO_3(K, 6, 2)  UPTO_2(K, 6, 4)  UPTO_1(K, 6, 8) \
+    UPTO_0(K, 6, 16) \
+    UPTO_3(K, 7, 1)  UPTO_2(K, 7, 2)  UPTO_1(K, 7, 4)  UPTO_0(K, 7, 8) \
+    UPTO_2(K, 8, 1)  UPTO_1(K, 8, 2)  UPTO_0(K, 8, 4) \
+    UPTO_1(K, 9, 1)  UPTO_0(K, 9, 2) \
+    UPTO_0(K, 10, 1)
+
+#define KERNEL_FUNCTIONS(o, i, a) \
+    static int lookup_##o##_##i##_##a(const iplc_cache_t *cache, uint32_t set, uint32_t tag) \
+    { return kernel_lookup(cache, set, tag, a); } \
+    static int probe_##o##_##i##_##a(iplc_cache_t *cache, uint32_t address) \
+    { return kernel_probe(cache, address, o, i, a); } \
+    static int access_##o##_##i##_##a(iplc_cache_t *cache, uint32_t address) \
+    { return kernel_access(cache, address, o, i, a); }
+
+#define KERNEL_ENTRY(o, i, a) \
+    {o, i, a, lookup_##o##_##i##_##a, probe_##o##_##i##_##a, access_##o##_##i##_##a},
+
+KERNEL_GEOMETRIES(KERNEL_FUNCTIONS)
+
+static const iplc_cache_kernel_t kernels[] = {
+    KERNEL_GEOMETRIES(KERNEL_ENTRY)
+};
+
+#define NUM_KERNELS ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+#else
+
+#define NUM_KERNELS 0
+
+#endif
+
+/************************************************************************************************/
+/* Dispatch Functions ***************************************************************************/
+/************************************************************************************************/
+
+/*
+ * The kernel for a geometry, or NULL if there is none and the cache has to
+ * use the generic functions.  Only runs when a cache is built.
+ */
+const iplc_cache_kernel_t *iplc_cache_kernel(int blockoffsetbits, int index_bits, int assoc)
+{
+#if defined(IPLC_SPECIALIZE)
+    int k;
+
+    for (k = 0; k < NUM_KERNELS; k++) {
+        if (kernels[k].blockoffsetbits == blockoffsetbits && kernels[k].index_bits == index_bits &&
+            kernels[k].assoc == assoc)
+            return &kernels[k];
+    }
+#endif
+    return NULL;
+}
+
+/*
+ * How many geometries have a kernel: 0 in a generic build.
+ */
+int iplc_cache_kernel_count(void)
+{
+    return NUM_KERNELS;
+}
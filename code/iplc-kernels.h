@@ -0,0 +1,38 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- cache kernels specialized per geometry
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_KERNELS_H
+#define IPLC_KERNELS_H
+
+#include <stdint.h>
+
+#include "iplc-cache.h"
+
+/*
+ * Copies of the cache's lookup, probe and access paths with the block
+ * offset bits, index bits and associativity compiled in: the set and tag
+ * masks are constants and the way loops are fully unrolled.  There is one
+ * per power-of-two geometry that fits in MAX_CACHE_SIZE, which is every
+ * L1 the simulator can build with power-of-two block sizes.
+ *
+ * They are only compiled with -DIPLC_SPECIALIZE (make iplc-sim-specialized);
+ * otherwise iplc_cache_kernel() always returns NULL and every cache takes
+ * the generic path.  A cache with prefetching enabled also stays generic.
+ */
+typedef struct iplc_cache_kernel
+{
+    int blockoffsetbits;
+    int index_bits;
+    int assoc;
+    int (*lookup)(const iplc_cache_t *cache, uint32_t set, uint32_t tag);
+    int (*probe)(iplc_cache_t *cache, uint32_t address);
+    int (*access)(iplc_cache_t *cache, uint32_t address);
+
+} iplc_cache_kernel_t;
+
+const iplc_cache_kernel_t *iplc_cache_kernel(int blockoffsetbits, int index_bits, int assoc);
+int iplc_cache_kernel_count(void);
+
+#endif
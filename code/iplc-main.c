@@ -0,0 +1,1177 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- command line driver
+ ***********************************************************************/
+/***********************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "iplc-sim.h"
+#include "iplc-trace.h"
+#include "iplc-stackdist.h"
+#include "iplc-repl.h"
+#include "iplc-prefetch.h"
+#include "iplc-bpred.h"
+#include "iplc-pipe.h"
+#include "iplc-interval.h"
+#include "iplc-event.h"
+#include "iplc-ingest.h"
+#include "iplc-coherence.h"
+#include "iplc-perf.h"
+
+int iplc_sim_sweep(const char *trace_file_name, int nthreads, const iplc_sim_config_t *base);
+int iplc_sim_stackdist(const char *trace_file_name);
+int iplc_sim_checkpoints(const char *trace_file_name, int nshards, const char *prefix,
+                         const iplc_sim_config_t *base);
+int iplc_sim_shard(const char *trace_file_name, int nshards, long warm, const char *prefix,
+                   const iplc_sim_config_t *base);
+int iplc_sim_multicore(char **trace_file_names, int ncores, int protocol, unsigned long quantum,
+                       const iplc_sim_config_t *base);
+
+/************************************************************************************************/
+/* Option Functions *****************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Parse "index,blocksize,assoc,latency[,nine|inclusive|exclusive]" into a
+ * lower cache level.  Returns 0 on success and -1 on a malformed spec.
+ */
+static int iplc_sim_parse_level(const char *spec, iplc_level_config_t *level)
+{
+    char inclusion[16] = "nine";
+    int n;
+
+    n = sscanf(spec, "%d,%d,%d,%d,%15s", &level->index, &level->blocksize, &level->assoc,
+               &level->latency, inclusion);
+    if (n < 4 || level->assoc < 1 || level->latency < 1)
+        return -1;
+
+    level->inclusion = iplc_sim_inclusion_parse(inclusion);
+    return level->inclusion < 0 ? -1 : 0;
+}
+
+/************************************************************************************************/
+/* Sweep Functions ******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Run worker(job) on up to nthreads threads and wait for them.  The
+ * workers take their work from a queue in job, so if a thread cannot be
+ * started the calling thread runs the worker itself and picks up what the
+ * missing threads would have done.  Returns the number of threads that
+ * ran it.
+ */
+static int iplc_sim_run_workers(void *(*worker)(void *), void *job, int nthreads)
+{
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * nthreads);
+    int i, started = 0;
+
+    while (threads != NULL && started < nthreads &&
+           pthread_create(&threads[started], NULL, worker, job) == 0)
+        started++;
+    if (started < nthreads)
+        worker(job);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    return started < nthreads ? started + 1 : started;
+}
+
+typedef struct sweep_result
+{
+    iplc_sim_config_t config;
+    unsigned long cache_size;
+    iplc_sim_stats_t stats;
+    int failed;             // iplc_sim_create() turned the configuration down
+
+} sweep_result_t;
+
+typedef struct sweep_job
+{
+    const trace_columns_t *trace;
+    sweep_result_t *results;
+    int nresults;
+    int next;               // next configuration to hand out
+    pthread_mutex_t lock;
+    struct iplc_perf *perf; // with IPLC_PERF, every configuration's phase times added up
+
+} sweep_job_t;
+
+/*
+ * Worker thread: keep grabbing configurations until none are left.  Every
+ * configuration gets its own simulator context.
+ */
+static void *iplc_sim_sweep_worker(void *arg)
+{
+    sweep_job_t *job = (sweep_job_t *) arg;
+    sweep_result_t *r;
+    iplc_sim_t *sim;
+    int n;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        n = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (n >= job->nresults)
+            break;
+
+        r = &job->results[n];
+        sim = iplc_sim_create(&r->config);
+        if (sim == NULL) {
+            r->failed = 1;
+            continue;
+        }
+
+        iplc_sim_feed_columns(sim, job->trace, 0, job->trace->count);
+        iplc_sim_finalize(sim, &r->stats);
+#if defined(IPLC_PERF)
+        if (job->perf != NULL && iplc_sim_perf(sim) != NULL) {
+            pthread_mutex_lock(&job->lock);
+            iplc_perf_merge(job->perf, iplc_sim_perf(sim));
+            pthread_mutex_unlock(&job->lock);
+        }
+#endif
+        iplc_sim_destroy(sim);
+    }
+
+    return NULL;
+}
+
+static int iplc_sim_sweep_compare(const void *a, const void *b)
+{
+    const sweep_result_t *ra = (const sweep_result_t *) a;
+    const sweep_result_t *rb = (const sweep_result_t *) b;
+
+    // configurations that could not be built go last, whatever their zeroed stats say
+    if (ra->failed != rb->failed)
+        return ra->failed - rb->failed;
+    if (ra->stats.pipeline_cycles != rb->stats.pipeline_cycles)
+        return ra->stats.pipeline_cycles < rb->stats.pipeline_cycles ? -1 : 1;
+    if (ra->cache_size != rb->cache_size)
+        return ra->cache_size < rb->cache_size ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Decode the trace once into columns, then simulate every configuration that fits in
+ * MAX_CACHE_SIZE (block sizes 1/2/4, associativity 1/2/4, both static branch
+ * predictions) across a pool of threads and print them ranked by cycles.
+ * Everything else (replacement policy, ...) comes from base.  Those that
+ * base makes impossible (e.g. an exclusive L2 with another block size) are
+ * left out of the ranking and only counted.
+ */
+int iplc_sim_sweep(const char *trace_file_name, int nthreads, const iplc_sim_config_t *base)
+{
+    static const int blocksizes[] = {1, 2, 4};
+    static const int assocs[] = {1, 2, 4};
+    iplc_trace_t trace;
+    trace_columns_t columns;
+    sweep_result_t *results = NULL, *grown;
+    int nresults = 0, cap = 0, nfailed = 0;
+    sweep_job_t job;
+    int b, a, index, p, i;
+
+    job.perf = NULL;
+#if defined(IPLC_PERF)
+    // before the trace is read, so the counters take in the decoder and the workers
+    job.perf = iplc_perf_create(1);
+#endif
+
+    if (iplc_trace_open(trace_file_name, &trace) != 0 ||
+        iplc_trace_columns_build(&columns, trace.records, trace.count) != 0) {
+        iplc_trace_close(&trace);
+#if defined(IPLC_PERF)
+        iplc_perf_destroy(job.perf);
+#endif
+        return -1;
+    }
+
+    // Enumerate every configuration that passes the iplc_sim_create() size check
+    for (b = 0; b < 3; b++) {
+        for (a = 0; a < 3; a++) {
+            for (index = 0;
+                 iplc_sim_cache_size(index, blocksizes[b], assocs[a]) <= MAX_CACHE_SIZE;
+                 index++) {
+                for (p = 0; p < 2; p++) {
+                    if (nresults == cap) {
+                        cap = cap ? cap * 2 : 64;
+                        grown = (sweep_result_t *) realloc(results, sizeof(sweep_result_t) * cap);
+                        if (grown == NULL) {
+                            free(results);
+                            iplc_trace_columns_free(&columns);
+                            iplc_trace_close(&trace);
+#if defined(IPLC_PERF)
+                            iplc_perf_destroy(job.perf);
+#endif
+                            return -1;
+                        }
+                        results = grown;
+                    }
+                    bzero(&results[nresults], sizeof(sweep_result_t));
+                    results[nresults].config = *base;
+                    results[nresults].config.index = index;
+                    results[nresults].config.blocksize = blocksizes[b];
+                    results[nresults].config.assoc = assocs[a];
+                    results[nresults].config.branch_predict_taken = p;
+                    results[nresults].config.quiet = 1;
+                    results[nresults].config.verbosity = VERBOSITY_STATS;
+                    results[nresults].cache_size =
+                        iplc_sim_cache_size(index, blocksizes[b], assocs[a]);
+                    nresults++;
+                }
+            }
+        }
+    }
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > nresults)
+        nthreads = nresults;
+
+    job.trace = &columns;
+    job.results = results;
+    job.nresults = nresults;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    nthreads = iplc_sim_run_workers(iplc_sim_sweep_worker, &job, nthreads);
+    pthread_mutex_destroy(&job.lock);
+
+    qsort(results, nresults, sizeof(sweep_result_t), iplc_sim_sweep_compare);
+    for (i = 0; i < nresults; i++)
+        nfailed += results[i].failed;
+
+    printf("Design Space Sweep: %ld instructions, %d configurations, %d threads \n\n",
+           trace.count, nresults, nthreads);
+    printf("Rank  Index  BlockSize  Assoc  Predict  CacheSize      Cycles       CPI  MissRate\n");
+    for (i = 0; i < nresults - nfailed; i++) {
+        printf("%4d  %5d  %9d  %5d  %7s  %9lu  %10lu  %8.6f  %8.6f\n",
+               i + 1, results[i].config.index, results[i].config.blocksize,
+               results[i].config.assoc,
+               results[i].config.branch_predict_taken ? "TAKEN" : "NOT",
+               results[i].cache_size, results[i].stats.pipeline_cycles,
+               (double)results[i].stats.pipeline_cycles / (double)results[i].stats.instruction_count,
+               (double)results[i].stats.cache_miss / (double)results[i].stats.cache_access);
+    }
+    if (nfailed > 0)
+        printf("%d configurations are not supported with these options and were not run \n",
+               nfailed);
+
+#if defined(IPLC_PERF)
+    if (job.perf != NULL) {
+        unsigned long instructions = 0;
+        printf("\n");
+        for (i = 0; i < nresults; i++)
+            instructions += results[i].stats.instruction_count;
+        printf("Phase times below are summed over all %d configurations and %d threads \n",
+               nresults - nfailed, nthreads);
+        iplc_perf_report(job.perf, instructions);
+        iplc_perf_destroy(job.perf);
+    }
+#endif
+
+    free(results);
+    iplc_trace_columns_free(&columns);
+    iplc_trace_close(&trace);
+    return 0;
+}
+
+/************************************************************************************************/
+/* Shard Functions ******************************************************************************/
+/************************************************************************************************/
+
+#define SHARD_DEFAULT_WARM 100000   // records warmed before a shard without a checkpoint
+
+typedef struct shard
+{
+    long begin, end;            // trace records [begin, end)
+    iplc_sim_stats_t stats;     // counted over just those
+    int ok;
+
+} shard_t;
+
+typedef struct shard_job
+{
+    const trace_columns_t *trace;
+    const iplc_sim_config_t *config;
+    long warm;
+    const char *prefix;         // checkpoints to start from instead of warming, or NULL
+    shard_t *shards;
+    int nshards;
+    int next;
+    pthread_mutex_t lock;
+
+} shard_job_t;
+
+static void iplc_sim_shard_name(char *name, size_t size, const char *prefix, int shard)
+{
+    snprintf(name, size, "%s.%d", prefix, shard);
+}
+
+/*
+ * Worker thread: bring each shard's simulator to its first record, from
+ * its checkpoint or by warming it on the records before it, then run the
+ * shard in detail.  Only the shard itself is counted.
+ */
+static void *iplc_sim_shard_worker(void *arg)
+{
+    shard_job_t *job = (shard_job_t *) arg;
+    iplc_sim_stats_t before;
+    char name[1024];
+    shard_t *sh;
+    iplc_sim_t *sim;
+    long position;
+    int n;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        n = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (n >= job->nshards)
+            break;
+
+        sh = &job->shards[n];
+        sim = iplc_sim_create(job->config);
+        if (sim == NULL)
+            continue;
+
+        if (job->prefix != NULL && n > 0) {
+            iplc_sim_shard_name(name, sizeof(name), job->prefix, n);
+            position = sh->begin;
+            if (iplc_sim_restore(sim, name, &position) != 0 || position != sh->begin) {
+                if (position != sh->begin)
+                    printf("Checkpoint %s is at record %ld, not %ld \n", name, position, sh->begin);
+                iplc_sim_destroy(sim);
+                continue;
+            }
+        }
+        else {
+            iplc_sim_warm_columns(sim, job->trace, sh->begin > job->warm ? sh->begin - job->warm : 0,
+                                  sh->begin);
+        }
+
+        bzero(&before, sizeof(before));
+        iplc_sim_get_stats(sim, &before);
+        iplc_sim_feed_columns(sim, job->trace, sh->begin, sh->end);
+        iplc_sim_finalize(sim, &sh->stats);
+        iplc_sim_stats_merge(&sh->stats, &before, -1);
+        sh->ok = 1;
+        iplc_sim_destroy(sim);
+    }
+
+    return NULL;
+}
+
+/*
+ * Split the trace into nshards equal runs of records.
+ */
+static shard_t *iplc_sim_shards(long count, int nshards)
+{
+    shard_t *shards = (shard_t *) calloc(nshards, sizeof(shard_t));
+    int i;
+
+    for (i = 0; shards != NULL && i < nshards; i++) {
+        shards[i].begin = count * i / nshards;
+        shards[i].end = count * (i + 1) / nshards;
+    }
+    return shards;
+}
+
+/*
+ * Functionally warm one simulator through the whole trace, which is much
+ * faster than running it, and save a checkpoint at the start of every shard
+ * but the first: prefix.1 to prefix.(nshards - 1).
+ */
+int iplc_sim_checkpoints(const char *trace_file_name, int nshards, const char *prefix,
+                         const iplc_sim_config_t *base)
+{
+    iplc_sim_config_t config = *base;
+    iplc_trace_t trace;
+    trace_columns_t columns;
+    shard_t *shards;
+    char name[1024];
+    iplc_sim_t *sim;
+    int i, rc = 0;
+
+    if (nshards < 2 || iplc_trace_open(trace_file_name, &trace) != 0)
+        return -1;
+    if (iplc_trace_columns_build(&columns, trace.records, trace.count) != 0) {
+        iplc_trace_close(&trace);
+        return -1;
+    }
+
+    // nothing is printed past the configuration
+    config.verbosity = VERBOSITY_STATS;
+    sim = iplc_sim_create(&config);
+    shards = iplc_sim_shards(trace.count, nshards);
+    if (sim == NULL || shards == NULL)
+        rc = -1;
+
+    for (i = 1; rc == 0 && i < nshards; i++) {
+        iplc_sim_warm_columns(sim, &columns, shards[i - 1].begin, shards[i].begin);
+        iplc_sim_shard_name(name, sizeof(name), prefix, i);
+        rc = iplc_sim_save(sim, name, shards[i].begin);
+        if (rc == 0)
+            printf("Checkpoint %s at record %ld \n", name, shards[i].begin);
+    }
+
+    iplc_sim_destroy(sim);
+    free(shards);
+    iplc_trace_columns_free(&columns);
+    iplc_trace_close(&trace);
+    return rc;
+}
+
+/*
+ * Run one trace as nshards pieces on a thread each and add their counters
+ * up.  Each shard starts from its checkpoint (prefix non-NULL, see
+ * iplc_sim_checkpoints()) or from caches and predictor warmed on the warm
+ * records before it.
+ *
+ * Each shard starts with an empty pipeline and drains its own at the end,
+ * where a single run would have overlapped the two.  The drain waits for
+ * the branch left unresolved and for every miss still outstanding, in an
+ * MSHR or the write buffer, so a boundary can move the total by the
+ * pipeline depth plus a memory latency for each of those.  That holds for
+ * shards started from checkpoints.  Warming on the records before a shard
+ * instead can leave its caches and predictor short of what a single run
+ * would have had, by an amount nothing here bounds.
+ */
+int iplc_sim_shard(const char *trace_file_name, int nshards, long warm, const char *prefix,
+                   const iplc_sim_config_t *base)
+{
+    iplc_sim_config_t config = *base;
+    iplc_sim_stats_t total;
+    iplc_trace_t trace;
+    trace_columns_t columns;
+    shard_job_t job;
+    iplc_sim_t *sim;
+    long bound;
+    int i, p, nthreads, depth;
+
+    if (nshards < 1 || iplc_trace_open(trace_file_name, &trace) != 0)
+        return -1;
+    if (iplc_trace_columns_build(&columns, trace.records, trace.count) != 0) {
+        iplc_trace_close(&trace);
+        return -1;
+    }
+
+    // print the configuration, and catch a bad one, once up front
+    iplc_sim_destroy(sim = iplc_sim_create(&config));
+    if (sim == NULL) {
+        iplc_trace_columns_free(&columns);
+        iplc_trace_close(&trace);
+        return -1;
+    }
+    config.quiet = 1;
+    config.verbosity = VERBOSITY_STATS;
+
+    job.trace = &columns;
+    job.config = &config;
+    job.warm = warm;
+    job.prefix = prefix;
+    job.shards = iplc_sim_shards(trace.count, nshards);
+    job.nshards = nshards;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > nshards)
+        nthreads = nshards;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    if (job.shards == NULL) {
+        pthread_mutex_destroy(&job.lock);
+        iplc_trace_columns_free(&columns);
+        iplc_trace_close(&trace);
+        return -1;
+    }
+    nthreads = iplc_sim_run_workers(iplc_sim_shard_worker, &job, nthreads);
+    pthread_mutex_destroy(&job.lock);
+
+    bzero(&total, sizeof(total));
+    for (i = 0; i < nshards; i++) {
+        if (!job.shards[i].ok) {
+            printf("Shard %d (records %ld to %ld) failed \n", i, job.shards[i].begin,
+                   job.shards[i].end);
+            free(job.shards);
+            iplc_trace_columns_free(&columns);
+            iplc_trace_close(&trace);
+            return -1;
+        }
+        iplc_sim_stats_merge(&total, &job.shards[i].stats, 1);
+    }
+
+    depth = config.pipeline_stages[0] != '\0' ? (int) strlen(config.pipeline_stages) : 5;
+    bound = (long) (nshards - 1) * (depth + 1 + (long) config.memory_latency *
+                                    (1 + config.mshrs + config.write_buffer));
+
+    printf("Sharded Simulation: %ld instructions, %d shards, %d threads \n", trace.count,
+           nshards, nthreads);
+    if (prefix != NULL)
+        printf("\t Shards start from checkpoints %s.1 to %s.%d \n", prefix, prefix, nshards - 1);
+    else
+        printf("\t Shards are warmed on the %ld records before them \n", warm);
+    printf("\n");
+    printf("Shard     First Record      Cycles  Instructions       CPI  MissRate\n");
+    for (i = 0; i < nshards; i++) {
+        const iplc_sim_stats_t *st = &job.shards[i].stats;
+        printf("%5d  %15ld  %10lu  %12lu  %8.6f  %8.6f\n", i, job.shards[i].begin,
+               st->pipeline_cycles, st->instruction_count,
+               (double)st->pipeline_cycles / (double)st->instruction_count,
+               st->cache_access ? (double)st->cache_miss / (double)st->cache_access : 0.0);
+    }
+    printf("\n");
+
+    printf(" Cache Performance \n");
+    printf("\t Number of Cache Accesses is %ld \n", total.cache_access);
+    printf("\t Number of Cache Misses is %ld \n", total.cache_miss);
+    printf("\t Number of Cache Hits is %ld \n", total.cache_hit);
+    printf("\t Cache Miss Rate is %f \n", (double)total.cache_miss / (double)total.cache_access);
+    for (p = 0; total.nlevels > 1 && p < total.nlevels; p++)
+        printf("\t %-3s Accesses %ld Misses %ld \n", total.level[p].name, total.level[p].access,
+               total.level[p].miss);
+    printf("\n");
+    if (config.profile > 0) {
+        printf(" Miss Classification \n");
+        for (p = 0; p < total.nlevels && p < (config.split_l1 ? 2 : 1); p++)
+            printf("\t %-3s Compulsory %ld Capacity %ld Conflict %ld \n", total.level[p].name,
+                   total.level[p].compulsory, total.level[p].capacity, total.level[p].conflict);
+        printf("\n");
+    }
+    printf("Pipeline Performance \n");
+    printf("\t Total Cycles is %lu \n", total.pipeline_cycles);
+    printf("\t Total Instructions is %lu \n", total.instruction_count);
+    printf("\t Total Branch Instructions is %lu \n", total.branch_count);
+    printf("\t Total Correct Branch Predictions is %lu \n", total.correct_branch_predictions);
+    printf("\t CPI is %f \n", (double)total.pipeline_cycles / (double)total.instruction_count);
+    if (prefix != NULL)
+        printf("\t Shard Boundaries move the total by at most %ld cycles (%f CPI) \n\n", bound,
+               (double)bound / (double)total.instruction_count);
+    else
+        printf("\t Shard Boundaries are not bounded: warmed caches can fall short of a single run's \n\n");
+
+    free(job.shards);
+    iplc_trace_columns_free(&columns);
+    iplc_trace_close(&trace);
+    return 0;
+}
+
+/************************************************************************************************/
+/* Multi-core Functions *************************************************************************/
+/************************************************************************************************/
+
+#define MULTICORE_DEFAULT_QUANTUM 1000  // cycles every core runs between barriers
+#define MULTICORE_DEFAULT_L2_ASSOC 8
+#define MULTICORE_DEFAULT_L2_LATENCY 10
+
+typedef struct multicore_job multicore_job_t;
+
+typedef struct core
+{
+    const char *trace_file_name;
+    iplc_trace_t trace;
+    trace_columns_t columns;
+    iplc_sim_t *sim;
+    iplc_sim_stats_t stats;
+    long position;              // next record
+    int done;
+    multicore_job_t *job;
+
+} core_t;
+
+struct multicore_job
+{
+    core_t *cores;
+    int ncores;
+    unsigned long quantum;
+    long quanta;                // run so far
+    int finished;               // cores at the end of their trace
+    int stop;
+    pthread_mutex_t lock;
+    pthread_barrier_t barrier;
+};
+
+/*
+ * Worker thread, one per core: run the core's trace until its clock
+ * passes the end of the quantum, then wait for the other cores there.  A
+ * core that has finished keeps turning up at the barrier until they all
+ * have.  Whether that happened is decided by one thread between two
+ * barriers, so every thread sees the same answer.  No core starts until
+ * every thread has been created: the caller holds the lock until then, and
+ * sets stop instead if one could not be.
+ */
+static void *iplc_sim_core_worker(void *arg)
+{
+    core_t *core = (core_t *) arg;
+    multicore_job_t *job = core->job;
+    unsigned long end = 0;
+    int stop;
+
+    pthread_mutex_lock(&job->lock);
+    stop = job->stop;
+    pthread_mutex_unlock(&job->lock);
+    if (stop)
+        return NULL;
+
+    for (;;) {
+        end += job->quantum;
+        while (core->position < core->columns.count && iplc_sim_cycles(core->sim) < end) {
+            iplc_sim_feed_columns(core->sim, &core->columns, core->position, core->position + 1);
+            core->position++;
+        }
+        if (!core->done && core->position == core->columns.count) {
+            core->done = 1;
+            pthread_mutex_lock(&job->lock);
+            job->finished++;
+            pthread_mutex_unlock(&job->lock);
+        }
+
+        if (pthread_barrier_wait(&job->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+            job->quanta++;
+            job->stop = job->finished == job->ncores;
+        }
+        pthread_barrier_wait(&job->barrier);
+        if (job->stop)
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * The options a multi-core run does not model.  Returns the first one set,
+ * or NULL if there are none.
+ */
+static const char *iplc_sim_multicore_unsupported(const iplc_sim_config_t *config)
+{
+    if (config->prefetch_i != PREFETCH_NONE || config->prefetch_d != PREFETCH_NONE)
+        return "prefetching";
+    if (config->compare_policies)
+        return "--compare-policies";
+    if (config->sample_period > 0)
+        return "--sample";
+    if (config->write_through)
+        return "--write-through";
+    if (!config->write_allocate)
+        return "--no-write-allocate";
+    if (config->l3.assoc > 0)
+        return "--l3";
+    return NULL;
+}
+
+/*
+ * Run one trace per core, each core with its own pipeline, predictor and
+ * split L1, over a shared L2 whose directory keeps the L1Ds coherent
+ * (iplc-coherence.h).  The L2 is the configuration's, or one four times
+ * the size of an L1 if it has none.  Every core is a thread, and they
+ * meet at a barrier every quantum cycles.
+ */
+int iplc_sim_multicore(char **trace_file_names, int ncores, int protocol, unsigned long quantum,
+                       const iplc_sim_config_t *base)
+{
+    iplc_sim_config_t config = *base;
+    iplc_level_config_t l2 = base->l2;
+    iplc_coherence_core_stats_t cs;
+    iplc_coherence_t *coh;
+    iplc_sim_t *sim;
+    multicore_job_t job;
+    pthread_t *threads;
+    core_t *cores;
+    const char *unsupported;
+    unsigned long cycles = 0;
+    long instructions = 0;
+    int i, started, ok = 1;
+
+    if (ncores < 1 || ncores > COHERENCE_MAX_CORES || quantum < 1) {
+        printf("A multi-core run takes 1 to %d traces and a quantum of at least 1 cycle \n",
+               COHERENCE_MAX_CORES);
+        return -1;
+    }
+    unsupported = iplc_sim_multicore_unsupported(&config);
+    if (unsupported != NULL) {
+        printf("%s is not supported with --multicore \n", unsupported);
+        return -1;
+    }
+    if (l2.assoc == 0) {
+        l2.blocksize = config.blocksize;
+        l2.assoc = MULTICORE_DEFAULT_L2_ASSOC;
+        for (l2.index = 0; (1l << l2.index) * l2.assoc < (4l << config.index) * config.assoc; )
+            l2.index++;
+        l2.latency = MULTICORE_DEFAULT_L2_LATENCY;
+    }
+    if (l2.blocksize != config.blocksize) {
+        printf("The shared L2 needs the same block size as the L1s \n");
+        return -1;
+    }
+
+    // every core's L1 is split, with nothing of its own below it
+    config.split_l1 = 1;
+    config.l2.assoc = 0;
+    iplc_sim_destroy(sim = iplc_sim_create(&config));
+    if (sim == NULL)
+        return -1;
+    config.quiet = 1;
+    config.verbosity = VERBOSITY_STATS;
+
+    coh = iplc_coherence_create(protocol, ncores, &l2, config.replacement, config.l1_latency,
+                                config.memory_latency);
+    cores = (core_t *) calloc(ncores, sizeof(core_t));
+    threads = (pthread_t *) malloc(sizeof(pthread_t) * ncores);
+    if (coh == NULL || cores == NULL || threads == NULL) {
+        printf("Unsupported shared L2 configuration \n");
+        iplc_coherence_destroy(coh);
+        free(cores);
+        free(threads);
+        return -1;
+    }
+
+    job.cores = cores;
+    job.ncores = ncores;
+    job.quantum = quantum;
+    job.quanta = 0;
+    job.finished = 0;
+    job.stop = 0;
+    for (i = 0; i < ncores; i++) {
+        cores[i].trace_file_name = trace_file_names[i];
+        cores[i].job = &job;
+        if (iplc_trace_open(trace_file_names[i], &cores[i].trace) != 0) {
+            ok = 0;
+            break;
+        }
+        if (iplc_trace_columns_build(&cores[i].columns, cores[i].trace.records,
+                                     cores[i].trace.count) != 0) {
+            iplc_trace_close(&cores[i].trace);
+            ok = 0;
+            break;
+        }
+        cores[i].sim = iplc_sim_create(&config);
+        if (cores[i].sim == NULL || iplc_sim_attach_coherence(cores[i].sim, coh, i) != 0) {
+            iplc_sim_destroy(cores[i].sim);
+            cores[i].sim = NULL;
+            iplc_trace_columns_free(&cores[i].columns);
+            iplc_trace_close(&cores[i].trace);
+            ok = 0;
+            break;
+        }
+    }
+
+    if (ok) {
+        // every core needs a thread of its own to meet the others at the barrier
+        pthread_mutex_init(&job.lock, NULL);
+        pthread_barrier_init(&job.barrier, NULL, ncores);
+        pthread_mutex_lock(&job.lock);
+        for (started = 0; started < ncores; started++) {
+            if (pthread_create(&threads[started], NULL, iplc_sim_core_worker, &cores[started]) != 0)
+                break;
+        }
+        if (started < ncores) {
+            printf("Could not start a thread for each of the %d cores \n", ncores);
+            job.stop = 1;
+            ok = 0;
+        }
+        pthread_mutex_unlock(&job.lock);
+        for (i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+        pthread_barrier_destroy(&job.barrier);
+        pthread_mutex_destroy(&job.lock);
+    }
+
+    if (ok) {
+        // the pipelines drain one at a time, now nothing else is running
+        for (i = 0; i < ncores; i++) {
+            iplc_sim_finalize(cores[i].sim, &cores[i].stats);
+            instructions += cores[i].stats.instruction_count;
+            if (cores[i].stats.pipeline_cycles > cycles)
+                cycles = cores[i].stats.pipeline_cycles;
+        }
+
+        printf("Multi-core Simulation: %d cores, %s, quantum %lu cycles, %ld quanta \n", ncores,
+               iplc_coherence_protocol_name(protocol), quantum, job.quanta);
+        printf("\t Shared L2: index %d, blocksize %d, assoc %d, latency %d \n", l2.index,
+               l2.blocksize, l2.assoc, l2.latency);
+        for (i = 0; i < ncores; i++)
+            printf("\t Core %d runs %s \n", i, cores[i].trace_file_name);
+        printf("\n");
+        printf("Core  Instructions      Cycles       CPI   L1D Misses  Coherence  Upgrades  Invalidated  Cache-to-Cache\n");
+        for (i = 0; i < ncores; i++) {
+            const iplc_sim_stats_t *st = &cores[i].stats;
+            iplc_coherence_get_stats(coh, i, &cs);
+            printf("%4d  %12lu  %10lu  %8.6f  %11ld  %9ld  %8ld  %11ld  %14ld\n", i,
+                   st->instruction_count, st->pipeline_cycles,
+                   st->instruction_count ? (double)st->pipeline_cycles / (double)st->instruction_count : 0.0,
+                   cs.misses, cs.coherence_misses, cs.upgrades, cs.invalidations_received,
+                   cs.cache_to_cache);
+        }
+        printf("\n");
+
+        iplc_coherence_report(coh, instructions);
+
+        printf("Pipeline Performance \n");
+        printf("\t Total Instructions is %ld \n", instructions);
+        printf("\t Total Cycles is %lu, those of the slowest core \n", cycles);
+        printf("\t IPC is %f across all cores \n\n",
+               cycles ? (double)instructions / (double)cycles : 0.0);
+    }
+
+    for (i = 0; i < ncores; i++) {
+        if (cores[i].sim == NULL)
+            continue;
+        iplc_sim_destroy(cores[i].sim);
+        iplc_trace_columns_free(&cores[i].columns);
+        iplc_trace_close(&cores[i].trace);
+    }
+    iplc_coherence_destroy(coh);
+    free(cores);
+    free(threads);
+    return ok ? 0 : -1;
+}
+
+/************************************************************************************************/
+/* Stack Distance Functions *********************************************************************/
+/************************************************************************************************/
+
+/*
+ * One pass over the trace drives a stack distance engine for each block
+ * size, giving LRU miss counts for every index and associativity at once.
+ */
+int iplc_sim_stackdist(const char *trace_file_name)
+{
+    static const int blocksizes[] = {1, 2, 4};
+    iplc_stackdist_t *sd[3];
+    iplc_trace_t trace;
+    long i;
+    int b, rc = 0;
+
+    if (iplc_trace_open(trace_file_name, &trace) != 0)
+        return -1;
+
+    for (b = 0; b < 3; b++) {
+        sd[b] = iplc_stackdist_create(blocksizes[b], 10, 16);
+        if (sd[b] == NULL)
+            rc = -1;
+    }
+
+    for (i = 0; rc == 0 && i < trace.count; i++) {
+        for (b = 0; b < 3; b++) {
+            if (iplc_stackdist_access(sd[b], trace.records[i].instruction_address) != 0 ||
+                ((trace.records[i].itype == LW || trace.records[i].itype == SW) &&
+                 iplc_stackdist_access(sd[b], trace.records[i].data_address) != 0))
+                rc = -1;
+        }
+    }
+
+    for (b = 0; b < 3; b++) {
+        if (rc == 0)
+            iplc_stackdist_report(sd[b]);
+        iplc_stackdist_destroy(sd[b]);
+    }
+
+    iplc_trace_close(&trace);
+    return rc;
+}
+
+/************************************************************************************************/
+/* MAIN Function ********************************************************************************/
+/************************************************************************************************/
+
+int main(int argc, char **argv)
+{
+    char trace_file_name[1024];
+    FILE *trace_file = NULL;
+    iplc_sim_config_t config;
+    iplc_sim_t *sim;
+    int protocol = COHERENCE_MESI;
+    unsigned long quantum = MULTICORE_DEFAULT_QUANTUM;
+    int i;
+
+    iplc_sim_config_init(&config);
+
+    // options shared by every mode
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            config.replacement = iplc_repl_policy_parse(argv[++i]);
+            if (config.replacement < 0) {
+                printf("Unknown replacement policy %s \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--compare-policies") == 0) {
+            config.compare_policies = 1;
+        }
+        else if ((strcmp(argv[i], "--iprefetch") == 0 || strcmp(argv[i], "--dprefetch") == 0) &&
+                 i + 1 < argc) {
+            int kind = iplc_prefetch_parse(argv[i + 1]);
+            if (kind < 0) {
+                printf("Unknown prefetcher %s \n", argv[i + 1]);
+                exit(-1);
+            }
+            if (argv[i][2] == 'i')
+                config.prefetch_i = kind;
+            else
+                config.prefetch_d = kind;
+            i++;
+        }
+        else if (strcmp(argv[i], "--prefetch-degree") == 0 && i + 1 < argc) {
+            config.prefetch_degree = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bpred") == 0 && i + 1 < argc) {
+            config.branch_predictor = iplc_bpred_parse(argv[++i]);
+            if (config.branch_predictor < 0) {
+                printf("Unknown branch predictor %s \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--bpred-bits") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d", &config.bpred_table_bits, &config.bpred_history_bits) < 1) {
+                printf("Bad predictor size %s, expected table_bits[,history_bits] \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--btb-bits") == 0 && i + 1 < argc) {
+            config.btb_bits = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--compare-predictors") == 0) {
+            config.compare_predictors = 1;
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            if (!iplc_pipe_valid_stages(argv[++i])) {
+                printf("Bad pipeline %s, expected stage letters F+ D+ X+ M+ W+ (at most %d) \n",
+                       argv[i], MAX_PIPE_STAGES);
+                exit(-1);
+            }
+            strcpy(config.pipeline_stages, argv[i]);
+        }
+        else if (strcmp(argv[i], "--issue-width") == 0 && i + 1 < argc) {
+            config.issue_width = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resolve-stage") == 0 && i + 1 < argc) {
+            config.branch_resolve_stage = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--mem-ports") == 0 && i + 1 < argc) {
+            config.mem_ports = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--hazards") == 0) {
+            config.hazards = 1;
+        }
+        else if (strcmp(argv[i], "--split") == 0) {
+            config.split_l1 = 1;
+        }
+        else if (strcmp(argv[i], "--l1-latency") == 0 && i + 1 < argc) {
+            config.l1_latency = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--memory-latency") == 0 && i + 1 < argc) {
+            config.memory_latency = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--write-through") == 0) {
+            config.write_through = 1;
+        }
+        else if (strcmp(argv[i], "--no-write-allocate") == 0) {
+            config.write_allocate = 0;
+        }
+        else if (strcmp(argv[i], "--write-buffer") == 0 && i + 1 < argc) {
+            config.write_buffer = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--mshrs") == 0 && i + 1 < argc) {
+            config.mshrs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            config.profile = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--region-bits") == 0 && i + 1 < argc) {
+            config.profile_region_bits = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            config.interval = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--interval-file") == 0 && i + 1 < argc) {
+            config.interval_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--interval-format") == 0 && i + 1 < argc) {
+            config.interval_format = iplc_interval_format_parse(argv[++i]);
+            if (config.interval_format < 0) {
+                printf("Unknown interval format %s \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--verbosity") == 0 && i + 1 < argc) {
+            config.verbosity = iplc_verbosity_parse(argv[++i]);
+            if (config.verbosity < 0) {
+                printf("Unknown verbosity %s \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--event-log") == 0 && i + 1 < argc) {
+            config.event_log = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d", &config.index, &config.blocksize, &config.assoc) != 3) {
+                printf("Bad cache %s, expected index,blocksize,assoc \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ld,%ld,%ld", &config.sample_period, &config.sample_warmup,
+                       &config.sample_size) != 3) {
+                printf("Bad sampling %s, expected period,warmup,size \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if ((strcmp(argv[i], "--l2") == 0 || strcmp(argv[i], "--l3") == 0) && i + 1 < argc) {
+            if (iplc_sim_parse_level(argv[i + 1], argv[i][3] == '2' ? &config.l2 : &config.l3) != 0) {
+                printf("Bad cache level %s, expected index,blocksize,assoc,latency[,nine|inclusive|exclusive] \n",
+                       argv[i + 1]);
+                exit(-1);
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--protocol") == 0 && i + 1 < argc) {
+            protocol = iplc_coherence_protocol_parse(argv[++i]);
+            if (protocol < 0) {
+                printf("Unknown coherence protocol %s \n", argv[i]);
+                exit(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+            quantum = strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            break;
+        }
+    }
+    argc -= i - 1;
+    argv += i - 1;
+
+    if (config.l1_latency < 1 || config.memory_latency < 1) {
+        printf("Latencies must be at least 1 cycle \n");
+        exit(-1);
+    }
+
+    // interval files and event logs follow one run; the modes below run many at once
+    if (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+        config.interval = 0;
+        config.verbosity = VERBOSITY_STATS;
+    }
+
+    // iplc-sim [options] --sweep <tracefile> [threads]
+    if (argc >= 3 && strcmp(argv[1], "--sweep") == 0) {
+        int nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (argc >= 4)
+            nthreads = atoi(argv[3]);
+        return iplc_sim_sweep(argv[2], nthreads, &config) == 0 ? 0 : -1;
+    }
+
+    // iplc-sim --checkpoint <tracefile> <shards> <prefix>
+    if (argc >= 5 && strcmp(argv[1], "--checkpoint") == 0)
+        return iplc_sim_checkpoints(argv[2], atoi(argv[3]), argv[4], &config) == 0 ? 0 : -1;
+
+    // iplc-sim --shard <tracefile> <shards> [warm records | checkpoint prefix]
+    if (argc >= 4 && strcmp(argv[1], "--shard") == 0) {
+        long warm = SHARD_DEFAULT_WARM;
+        const char *prefix = NULL;
+        char *end;
+        if (argc >= 5) {
+            warm = strtol(argv[4], &end, 10);
+            if (*end != '\0')
+                prefix = argv[4];
+        }
+        return iplc_sim_shard(argv[2], atoi(argv[3]), warm, prefix, &config) == 0 ? 0 : -1;
+    }
+
+    // iplc-sim [options] --multicore <tracefile> <tracefile> [...]
+    if (argc >= 3 && strcmp(argv[1], "--multicore") == 0)
+        return iplc_sim_multicore(argv + 2, argc - 2, protocol, quantum, &config) == 0 ? 0 : -1;
+
+    // iplc-sim --stackdist <tracefile>
+    if (argc >= 3 && strcmp(argv[1], "--stackdist") == 0)
+        return iplc_sim_stackdist(argv[2]) == 0 ? 0 : -1;
+
+    // iplc-sim --render-events <event log>
+    if (argc >= 3 && strcmp(argv[1], "--render-events") == 0)
+        return iplc_event_render_log(argv[2], stdout) == 0 ? 0 : -1;
+
+    // iplc-sim --convert <text tracefile> <binary tracefile>
+    if (argc >= 4 && strcmp(argv[1], "--convert") == 0)
+        return iplc_trace_convert(argv[2], argv[3]) == 0 ? 0 : -1;
+
+    if (argc > 1) {
+        printf("usage: iplc-sim [--policy lru|plru|fifo|random|srrip|brrip] [--compare-policies] \n"
+               "                [--pipeline FDXMW] [--issue-width n] [--resolve-stage n] [--mem-ports n] \n"
+               "                [--hazards] [--split] [--l1-latency cycles] [--memory-latency cycles] \n"
+               "                [--write-through] [--no-write-allocate] [--write-buffer entries] \n"
+               "                [--mshrs entries] [--sample period,warmup,size] [--cache index,blocksize,assoc] \n"
+               "                [--bpred static|bimodal|gshare|tournament] [--bpred-bits table[,history]] \n"
+               "                [--btb-bits n] [--compare-predictors] [--profile top] [--region-bits n] \n"
+               "                [--interval instructions] [--interval-format csv|binary] [--interval-file path] \n"
+               "                [--verbosity stats|accesses|pipeline|debug] [--event-log path] \n"
+               "                [--iprefetch|--dprefetch none|next-line|stride|stream] [--prefetch-degree n] \n"
+               "                [--l2 index,blocksize,assoc,latency[,nine|inclusive|exclusive]] \n"
+               "                [--l3 index,blocksize,assoc,latency[,nine|inclusive|exclusive]] \n"
+               "                [--protocol mesi|moesi] [--quantum cycles] \n"
+               "                [--sweep <tracefile> [threads] | --stackdist <tracefile> | \n"
+               "                 --checkpoint <tracefile> <shards> <prefix> | \n"
+               "                 --shard <tracefile> <shards> [warm records | checkpoint prefix] | \n"
+               "                 --multicore <tracefile> <tracefile> [...] | \n"
+               "                 --render-events <event log> | \n"
+               "                 --convert <text tracefile> <binary tracefile>] \n");
+        exit(-1);
+    }
+
+    printf("Please enter the tracefile: ");
+    scanf("%s", trace_file_name);
+
+    trace_file = fopen(trace_file_name, "r");
+
+    if ( trace_file == NULL ) {
+        printf("fopen failed for %s file\n", trace_file_name);
+        exit(-1);
+    }
+
+    printf("Enter Cache Size (index), Blocksize and Level of Assoc \n");
+    scanf( "%d %d %d", &config.index, &config.blocksize, &config.assoc );
+
+    printf("Enter Branch Prediction: 0 (NOT taken), 1 (TAKEN): ");
+    scanf("%d", &config.branch_predict_taken );
+
+    sim = iplc_sim_create(&config);
+    if (sim == NULL)
+        exit(-1);
+
+    if (iplc_trace_is_binary(trace_file_name)) {
+        iplc_trace_t trace;
+        long i;
+
+        if (iplc_trace_open(trace_file_name, &trace) != 0)
+            exit(-1);
+        for (i = 0; i < trace.count; i++)
+            iplc_sim_feed_record(sim, &trace.records[i]);
+        iplc_trace_close(&trace);
+    }
+    else {
+        // read and decoded on two more threads while this one simulates
+        iplc_ingest_t *ingest = iplc_ingest_open(trace_file_name);
+        const trace_record_t *batch;
+        long i, n;
+
+        if (ingest == NULL)
+            exit(-1);
+        while ((batch = iplc_ingest_next(ingest, &n)) != NULL) {
+            for (i = 0; i < n; i++)
+                iplc_sim_feed_record(sim, &batch[i]);
+            iplc_ingest_release(ingest);
+        }
+        if (iplc_ingest_close(ingest) != 0)
+            exit(-1);
+    }
+    fclose(trace_file);
+
+    iplc_sim_finalize(sim, NULL);
+    iplc_sim_destroy(sim);
+    return 0;
+}
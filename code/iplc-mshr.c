@@ -0,0 +1,133 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- miss status holding registers
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+
+#include "iplc-mshr.h"
+
+typedef struct mshr_entry
+{
+    uint32_t block;
+    unsigned long ready;        // cycle the block arrives; free from then on
+
+} mshr_entry_t;
+
+struct iplc_mshr
+{
+    int size;
+    unsigned long busy_until;   // the last cycle any entry is busy, + 1
+    mshr_entry_t entry[MSHR_MAX_ENTRIES];
+
+    iplc_mshr_stats_t stats;
+};
+
+/*
+ * Returns NULL for a size outside 1..MSHR_MAX_ENTRIES.
+ */
+iplc_mshr_t *iplc_mshr_create(int entries)
+{
+    iplc_mshr_t *mshr;
+
+    if (entries < 1 || entries > MSHR_MAX_ENTRIES)
+        return NULL;
+
+    mshr = (iplc_mshr_t *) calloc(1, sizeof(iplc_mshr_t));
+    if (mshr == NULL)
+        return NULL;
+
+    mshr->size = entries;
+    return mshr;
+}
+
+void iplc_mshr_destroy(iplc_mshr_t *mshr)
+{
+    free(mshr);
+}
+
+/*
+ * Is block still on its way at cycle now?  Returns the cycle it arrives,
+ * counting a secondary miss, or 0 if it is not outstanding.
+ */
+unsigned long iplc_mshr_lookup(iplc_mshr_t *mshr, uint32_t block, unsigned long now)
+{
+    int i;
+
+    for (i = 0; i < mshr->size; i++) {
+        if (mshr->entry[i].ready > now && mshr->entry[i].block == block) {
+            mshr->stats.merged++;
+            return mshr->entry[i].ready;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Start a primary miss to block at cycle now that takes latency cycles.
+ * Returns the cycle it actually starts, later than now if it had to wait
+ * for an entry.
+ */
+unsigned long iplc_mshr_allocate(iplc_mshr_t *mshr, uint32_t block, unsigned long now, int latency)
+{
+    mshr_entry_t *e = &mshr->entry[0];
+    unsigned long start;
+    int i, outstanding = 1;
+
+    // a free entry if there is one, otherwise the one that frees up first
+    for (i = 0; i < mshr->size; i++) {
+        if (mshr->entry[i].ready < e->ready)
+            e = &mshr->entry[i];
+    }
+
+    start = now;
+    if (e->ready > now) {
+        start = e->ready;
+        mshr->stats.full++;
+        mshr->stats.full_cycles += (long) (start - now);
+    }
+
+    e->block = block;
+    e->ready = start + latency;
+
+    for (i = 0; i < mshr->size; i++) {
+        if (&mshr->entry[i] != e && mshr->entry[i].ready > start)
+            outstanding++;
+    }
+    if (outstanding > mshr->stats.max_outstanding)
+        mshr->stats.max_outstanding = outstanding;
+
+    mshr->stats.misses++;
+    mshr->stats.miss_cycles += latency;
+    if (e->ready > mshr->busy_until) {
+        mshr->stats.busy_cycles += e->ready - (start > mshr->busy_until ? start : mshr->busy_until);
+        mshr->busy_until = e->ready;
+    }
+    return start;
+}
+
+void iplc_mshr_get_stats(const iplc_mshr_t *mshr, iplc_mshr_stats_t *stats)
+{
+    *stats = mshr->stats;
+}
+
+int iplc_mshr_save(const iplc_mshr_t *mshr, FILE *f)
+{
+    return fwrite(mshr, sizeof(iplc_mshr_t), 1, f) == 1 ? 0 : -1;
+}
+
+/*
+ * Returns -1 if the saved file had a different number of entries.  Entries
+ * still outstanding keep their arrival cycles.
+ */
+int iplc_mshr_load(iplc_mshr_t *mshr, FILE *f)
+{
+    iplc_mshr_t saved;
+
+    if (fread(&saved, sizeof(iplc_mshr_t), 1, f) != 1)
+        return -1;
+    if (saved.size != mshr->size)
+        return -1;
+    *mshr = saved;
+    return 0;
+}
@@ -0,0 +1,50 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- miss status holding registers
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_MSHR_H
+#define IPLC_MSHR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define MSHR_MAX_ENTRIES 64
+
+/*
+ * The outstanding misses of a non-blocking cache, one entry per block
+ * being fetched.  An entry is busy from the cycle its miss starts until
+ * the block arrives.  A miss to a block that already has a busy entry (a
+ * secondary miss) merges into it and gets the block when it arrives.  A
+ * primary miss with every entry busy has to wait for the first one to
+ * free up.
+ *
+ * Memory-level parallelism is the average number of misses outstanding
+ * over the cycles at least one is.
+ */
+typedef struct iplc_mshr iplc_mshr_t;
+
+typedef struct iplc_mshr_stats
+{
+    long misses;                // primary misses, each took an entry
+    long merged;                // secondary misses
+    long full;                  // primary misses that found every entry busy
+    long full_cycles;           // ... and how long they waited
+    int max_outstanding;
+    unsigned long miss_cycles;  // sum of every primary miss's latency
+    unsigned long busy_cycles;  // cycles with at least one miss outstanding
+
+} iplc_mshr_stats_t;
+
+iplc_mshr_t *iplc_mshr_create(int entries);
+void iplc_mshr_destroy(iplc_mshr_t *mshr);
+
+// Checkpoints, into a MSHR file configured the same way
+int iplc_mshr_save(const iplc_mshr_t *mshr, FILE *f);
+int iplc_mshr_load(iplc_mshr_t *mshr, FILE *f);
+
+unsigned long iplc_mshr_lookup(iplc_mshr_t *mshr, uint32_t block, unsigned long now);
+unsigned long iplc_mshr_allocate(iplc_mshr_t *mshr, uint32_t block, unsigned long now, int latency);
+void iplc_mshr_get_stats(const iplc_mshr_t *mshr, iplc_mshr_stats_t *stats);
+
+#endif
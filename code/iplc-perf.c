@@ -0,0 +1,177 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- self-profiling
+ ***********************************************************************/
+/***********************************************************************/
+#define _GNU_SOURCE
+#include "iplc-perf.h"
+
+#if defined(IPLC_PERF)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#endif
+
+static const char *phase_names[NUM_PERF_PHASES] = {"Parse", "Issue", "Cache", "Pipeline", "Output"};
+
+// CPU nanoseconds charged by threads with no profiler of their own, by phase
+static _Atomic uint64_t background[NUM_PERF_PHASES];
+
+static double perf_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * One hardware counter on this process, user space only, counting from
+ * now.  Returns the descriptor, or -1 with errno set.
+ */
+static int perf_open(int counter)
+{
+#if defined(__linux__)
+    static const uint64_t configs[NUM_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[counter];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * A profiler starting now, with the hardware counters if counters is set.
+ */
+iplc_perf_t *iplc_perf_create(int counters)
+{
+    iplc_perf_t *perf;
+    int c;
+
+    perf = (iplc_perf_t *) calloc(1, sizeof(iplc_perf_t));
+    if (perf == NULL)
+        return NULL;
+
+    for (c = 0; c < NUM_PERF_COUNTERS; c++) {
+        perf->fd[c] = counters ? perf_open(c) : -1;
+        if (counters && perf->fd[c] < 0 && perf->error == 0)
+            perf->error = errno;
+    }
+
+    perf->start_seconds = perf_seconds();
+    perf->start_ticks = iplc_perf_ticks();
+    return perf;
+}
+
+void iplc_perf_destroy(iplc_perf_t *perf)
+{
+    int c;
+
+    if (perf == NULL)
+        return;
+    for (c = 0; c < NUM_PERF_COUNTERS; c++) {
+        if (perf->fd[c] >= 0)
+            close(perf->fd[c]);
+    }
+    free(perf);
+}
+
+/*
+ * Add the phase times of perf, which has finished, to sum's.
+ */
+void iplc_perf_merge(iplc_perf_t *sum, const iplc_perf_t *perf)
+{
+    int p;
+
+    for (p = 0; p < NUM_PERF_PHASES; p++)
+        sum->ticks[p] += perf->ticks[p];
+}
+
+/*
+ * Charge ns of CPU time in phase to the process, from any thread.
+ */
+void iplc_perf_charge(int phase, uint64_t ns)
+{
+    atomic_fetch_add_explicit(&background[phase], ns, memory_order_relaxed);
+}
+
+/************************************************************************************************/
+/* Report Functions *****************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Print the phase times since iplc_perf_create() and the counters, per
+ * instruction where that means something.
+ */
+void iplc_perf_report(iplc_perf_t *perf, unsigned long instructions)
+{
+    double seconds = perf_seconds() - perf->start_seconds;
+    uint64_t total = iplc_perf_ticks() - perf->start_ticks, inside = 0;
+    uint64_t counts[NUM_PERF_COUNTERS];
+    double per_tick = total ? seconds / (double) total : 0;
+    double n = instructions ? (double) instructions : 1;
+    int p, c, have = 0;
+
+    printf("Self Profile \n");
+    printf("\t Wall Time is %f seconds, %.0f ticks per second \n", seconds,
+           per_tick > 0 ? 1 / per_tick : 0);
+    for (p = 0; p < NUM_PERF_PHASES; p++) {
+        inside += perf->ticks[p];
+        printf("\t %-9s %10.6f seconds %5.1f%% %8.1f ns per instruction \n", phase_names[p],
+               perf->ticks[p] * per_tick, total ? 100.0 * perf->ticks[p] / total : 0,
+               perf->ticks[p] * per_tick * 1e9 / n);
+    }
+    if (inside > total)
+        inside = total;
+    printf("\t %-9s %10.6f seconds %5.1f%% %8.1f ns per instruction (driver and trace input) \n",
+           "Outside", (total - inside) * per_tick, total ? 100.0 * (total - inside) / total : 0,
+           (total - inside) * per_tick * 1e9 / n);
+    for (p = 0; p < NUM_PERF_PHASES; p++) {
+        double cpu = atomic_load_explicit(&background[p], memory_order_relaxed) * 1e-9;
+        if (cpu == 0)
+            continue;
+        printf("\t %-9s %10.6f seconds %5.1f%% %8.1f ns per instruction (CPU time on other threads) \n",
+               phase_names[p], cpu, seconds > 0 ? 100.0 * cpu / seconds : 0, cpu * 1e9 / n);
+    }
+
+    for (c = 0; c < NUM_PERF_COUNTERS; c++) {
+        counts[c] = 0;
+        if (perf->fd[c] >= 0 && read(perf->fd[c], &counts[c], sizeof(uint64_t)) == sizeof(uint64_t))
+            have++;
+    }
+    if (have == 0) {
+        printf("\t Hardware Counters unavailable (perf_event_open: %s) \n\n", strerror(perf->error));
+        return;
+    }
+    printf("\t Hardware Cycles is %llu, %.1f per instruction \n",
+           (unsigned long long) counts[PERF_CYCLES], counts[PERF_CYCLES] / n);
+    printf("\t Hardware Instructions is %llu, %.1f per instruction, IPC %f \n",
+           (unsigned long long) counts[PERF_INSTRUCTIONS], counts[PERF_INSTRUCTIONS] / n,
+           counts[PERF_CYCLES] ? (double) counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES] : 0);
+    printf("\t LLC Misses is %llu, %.3f per instruction \n",
+           (unsigned long long) counts[PERF_LLC_MISSES], counts[PERF_LLC_MISSES] / n);
+    printf("\t Branch Misses is %llu, %.3f per instruction \n\n",
+           (unsigned long long) counts[PERF_BRANCH_MISSES], counts[PERF_BRANCH_MISSES] / n);
+}
+
+#endif
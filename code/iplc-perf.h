@@ -0,0 +1,133 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- self-profiling
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_PERF_H
+#define IPLC_PERF_H
+
+#include <stdint.h>
+
+/*
+ * Where the simulator's own time goes, for builds with -DIPLC_PERF (make
+ * iplc-sim-perf).  The simulator brackets each phase with
+ * IPLC_PERF_ENTER()/IPLC_PERF_LEAVE().  The timers are exclusive: time in
+ * a phase entered from inside another one, such as a cache access made
+ * from the pipeline, counts only for the inner phase.  Time outside every
+ * phase is the driver and trace input.
+ *
+ * Alongside the timers, the process's own cycles, instructions, LLC
+ * misses and branch misses are counted with perf_event_open() where the
+ * kernel allows it.  Threads started after iplc_perf_create() are
+ * included.  A profiler created without counters only keeps the timers,
+ * for simulators whose times are merged into another's report.
+ *
+ * Work done on a thread with no profiler of its own, such as decoding a
+ * text trace on the ingest decoder thread, is measured in that thread's
+ * CPU time, so time it spends waiting or preempted is left out, charged
+ * to the process as a whole with IPLC_PERF_CHARGE() and reported beside
+ * the phases.
+ *
+ * Without IPLC_PERF the macros expand to nothing and the simulator has no
+ * iplc_perf_t at all.
+ */
+enum perf_phase {PERF_PARSE, PERF_ISSUE, PERF_CACHE, PERF_PIPELINE, PERF_OUTPUT, NUM_PERF_PHASES};
+
+enum perf_counter {PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_BRANCH_MISSES,
+                   NUM_PERF_COUNTERS};
+
+#if defined(IPLC_PERF)
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define PERF_MAX_DEPTH 16
+
+typedef struct iplc_perf
+{
+    uint64_t last;              // ticks when the innermost phase last changed
+    int depth;
+    uint8_t stack[PERF_MAX_DEPTH];
+    uint64_t ticks[NUM_PERF_PHASES];
+
+    uint64_t start_ticks;
+    double start_seconds;
+    int fd[NUM_PERF_COUNTERS];  // -1 where the counter could not be opened
+    int error;                  // errno of the first one that failed, 0 if none did
+
+} iplc_perf_t;
+
+/*
+ * The TSC where there is one, else a monotonic nanosecond clock; either
+ * way iplc_perf_report() converts ticks to time against the wall clock.
+ */
+static inline uint64_t iplc_perf_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+/*
+ * CPU time of the calling thread, in nanoseconds.
+ */
+static inline uint64_t iplc_perf_thread_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static inline void iplc_perf_enter(iplc_perf_t *perf, int phase)
+{
+    uint64_t now;
+
+    if (perf == NULL || perf->depth == PERF_MAX_DEPTH)
+        return;
+
+    now = iplc_perf_ticks();
+    if (perf->depth > 0)
+        perf->ticks[perf->stack[perf->depth - 1]] += now - perf->last;
+    perf->stack[perf->depth++] = (uint8_t) phase;
+    perf->last = now;
+}
+
+static inline void iplc_perf_leave(iplc_perf_t *perf)
+{
+    uint64_t now;
+
+    if (perf == NULL || perf->depth == 0)
+        return;
+
+    now = iplc_perf_ticks();
+    perf->ticks[perf->stack[--perf->depth]] += now - perf->last;
+    perf->last = now;
+}
+
+iplc_perf_t *iplc_perf_create(int counters);
+void iplc_perf_destroy(iplc_perf_t *perf);
+void iplc_perf_merge(iplc_perf_t *sum, const iplc_perf_t *perf);
+void iplc_perf_charge(int phase, uint64_t ns);
+void iplc_perf_report(iplc_perf_t *perf, unsigned long instructions);
+
+#define IPLC_PERF_ENTER(perf, phase) iplc_perf_enter(perf, phase)
+#define IPLC_PERF_LEAVE(perf) iplc_perf_leave(perf)
+#define IPLC_PERF_THREAD_NS() iplc_perf_thread_ns()
+#define IPLC_PERF_CHARGE(phase, ns) iplc_perf_charge(phase, ns)
+
+#else
+
+#define IPLC_PERF_ENTER(perf, phase) ((void) 0)
+#define IPLC_PERF_LEAVE(perf) ((void) 0)
+#define IPLC_PERF_THREAD_NS() ((uint64_t) 0)
+#define IPLC_PERF_CHARGE(phase, ns) ((void) (ns))
+
+#endif
+
+#endif
@@ -0,0 +1,338 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- configurable in-order pipeline
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "iplc-pipe.h"
+
+struct iplc_pipe
+{
+    int depth;
+    int width;
+    int resolve;                // stage a branch resolves in
+    int mem_ports;
+    uint8_t role[PIPE_MAX_STAGES];
+    int first[NUM_PIPE_ROLES];
+    int last[NUM_PIPE_ROLES];
+
+    /*
+     * ring[s][k]: the cycle the instruction width places back from the one
+     * going in entered stage s, with k the going-in instruction's slot.
+     * It has to have moved on before the new one can take its place.
+     */
+    unsigned long ring[PIPE_MAX_STAGES][PIPE_MAX_WIDTH];
+    int slot;
+
+    unsigned long prev[PIPE_MAX_STAGES];    // the previous instruction, by stage
+    unsigned long cur[PIPE_MAX_STAGES];     // the one going in
+    iplc_pipe_insn_t insn;
+
+    unsigned long ports[PIPE_MAX_WIDTH];    // M entry + 1 of the last mem_ports loads/stores
+    int next_port;
+    unsigned long ready[PIPE_REGS];         // cycle each register can be forwarded from
+    unsigned long bypass[PIPE_REGS];        // ... and until when straight off the end of X
+    unsigned long written[PIPE_REGS];       // cycle its producer entered the last stage
+    uint8_t from_load[PIPE_REGS];
+    unsigned long fetch_ready;              // fetch is busy until then
+
+    iplc_pipe_stats_t stats;
+};
+
+static int pipe_role(char c)
+{
+    switch (c) {
+        case 'F': return PIPE_FETCH;
+        case 'D': return PIPE_DECODE;
+        case 'X': return PIPE_EXECUTE;
+        case 'M': return PIPE_MEMORY;
+        case 'W': return PIPE_WRITEBACK;
+    }
+    return -1;
+}
+
+/*
+ * A stage string is F+ D+ X+ M+ W+, at most PIPE_MAX_STAGES long.
+ */
+int iplc_pipe_valid_stages(const char *stages)
+{
+    int i, r, want = PIPE_FETCH;
+    int n = (int) strlen(stages);
+
+    if (n < NUM_PIPE_ROLES || n > PIPE_MAX_STAGES)
+        return 0;
+
+    for (i = 0; i < n; i++) {
+        r = pipe_role(stages[i]);
+        if (r == want + 1 && i > 0)
+            want = r;
+        if (r != want)
+            return 0;
+    }
+    return want == PIPE_WRITEBACK;
+}
+
+/*
+ * resolve_stage -1 resolves branches in the last decode stage.  Returns
+ * NULL for a bad stage string, width or resolve stage.
+ */
+iplc_pipe_t *iplc_pipe_create(const char *stages, int width, int resolve_stage, int mem_ports)
+{
+    iplc_pipe_t *pipe;
+    int s, r;
+
+    if (!iplc_pipe_valid_stages(stages) || width < 1 || width > PIPE_MAX_WIDTH ||
+        mem_ports < 1 || mem_ports > PIPE_MAX_WIDTH)
+        return NULL;
+
+    pipe = (iplc_pipe_t *) calloc(1, sizeof(iplc_pipe_t));
+    if (pipe == NULL)
+        return NULL;
+
+    pipe->depth = (int) strlen(stages);
+    pipe->width = width;
+    pipe->mem_ports = mem_ports;
+    for (r = 0; r < NUM_PIPE_ROLES; r++)
+        pipe->first[r] = -1;
+    for (s = 0; s < pipe->depth; s++) {
+        r = pipe_role(stages[s]);
+        pipe->role[s] = (uint8_t) r;
+        if (pipe->first[r] < 0)
+            pipe->first[r] = s;
+        pipe->last[r] = s;
+    }
+
+    pipe->resolve = resolve_stage < 0 ? pipe->last[PIPE_DECODE] : resolve_stage;
+    if (pipe->resolve < 1 || pipe->resolve >= pipe->depth) {
+        free(pipe);
+        return NULL;
+    }
+    return pipe;
+}
+
+void iplc_pipe_destroy(iplc_pipe_t *pipe)
+{
+    free(pipe);
+}
+
+int iplc_pipe_depth(const iplc_pipe_t *pipe)
+{
+    return pipe->depth;
+}
+
+int iplc_pipe_resolve_stage(const iplc_pipe_t *pipe)
+{
+    return pipe->resolve;
+}
+
+/************************************************************************************************/
+/* Timing Functions *****************************************************************************/
+/************************************************************************************************/
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/*
+ * Earliest cycle the going-in instruction can enter stage s, given it
+ * could get there at t: in order behind the previous instruction, and only
+ * once there is room in the stage.
+ */
+static inline unsigned long pipe_enter(const iplc_pipe_t *pipe, int s, unsigned long t)
+{
+    t = MAX(t, pipe->prev[s]);
+    if (s + 1 < pipe->depth)
+        t = MAX(t, pipe->ring[s + 1][pipe->slot]);
+    else
+        t = MAX(t, pipe->ring[s][pipe->slot] + 1);
+    return t;
+}
+
+/*
+ * Start the next instruction: redirect says what the previous one did to
+ * the fetch stream.  Returns the cycle it is fetched in.
+ */
+unsigned long iplc_pipe_fetch(iplc_pipe_t *pipe, int redirect)
+{
+    unsigned long t = pipe->fetch_ready, r;
+
+    if (redirect == PIPE_TAKEN) {
+        // a taken branch or jump ends the fetch group
+        t = MAX(t, pipe->prev[0] + 1);
+    }
+    else if (redirect == PIPE_MISPREDICT) {
+        r = pipe->prev[pipe->resolve] + 1;
+        if (r > t) {
+            pipe->stats.redirect_stalls += r - MAX(t, pipe->prev[0]);
+            t = r;
+        }
+    }
+
+    pipe->cur[0] = pipe_enter(pipe, 0, t);
+    return pipe->cur[0];
+}
+
+/*
+ * The going-in instruction reads its operands in a stage it entered at t:
+ * wait for the latest of them, and count where each one came from.
+ */
+static unsigned long pipe_operands(iplc_pipe_t *pipe, const iplc_pipe_insn_t *insn,
+                                   unsigned long t)
+{
+    unsigned long need = 0;
+    int i, r, load = 0, kind;
+
+    for (i = 0; i < 2; i++) {
+        r = insn->src[i];
+        if (r > 0 && r < PIPE_REGS && pipe->ready[r] > need) {
+            need = pipe->ready[r];
+            load = pipe->from_load[r];
+        }
+    }
+
+    if (need > t) {
+        kind = insn->is_branch ? HAZARD_BRANCH_OPERAND : load ? HAZARD_LOAD_USE : HAZARD_EX_EX;
+        // an ALU result waited for is still counted as a forward below
+        if (kind != HAZARD_EX_EX)
+            pipe->stats.hazards[kind]++;
+        pipe->stats.hazard_stalls[kind] += need - t;
+        pipe->stats.raw_stalls += need - t;
+        t = need;
+    }
+
+    for (i = 0; !insn->is_branch && i < 2; i++) {
+        r = insn->src[i];
+        if (r <= 0 || r >= PIPE_REGS)
+            continue;
+        if (t < pipe->bypass[r])
+            pipe->stats.hazards[HAZARD_EX_EX]++;
+        else if (t <= pipe->written[r])
+            pipe->stats.hazards[HAZARD_MEM_EX]++;
+    }
+    return t;
+}
+
+/*
+ * Take the fetched instruction up to the first memory stage.  Returns the
+ * cycle it gets there, which is when a load or store accesses the cache.
+ */
+unsigned long iplc_pipe_execute(iplc_pipe_t *pipe, const iplc_pipe_insn_t *insn)
+{
+    unsigned long t;
+    int s, operands = pipe->first[PIPE_EXECUTE];
+
+    pipe->insn = *insn;
+    pipe->stats.fetch_stalls += insn->fetch_latency - 1;
+    if (insn->is_branch && pipe->resolve < operands)
+        operands = pipe->resolve;
+
+    for (s = 1; s <= pipe->first[PIPE_MEMORY]; s++) {
+        t = pipe->cur[s - 1] + (s == 1 ? insn->fetch_latency : 1);
+        t = pipe_enter(pipe, s, t);
+
+        if (s == operands)
+            t = pipe_operands(pipe, insn, t);
+
+        if (s == pipe->first[PIPE_MEMORY] && insn->is_mem) {
+            if (insn->store_src > 0 && insn->store_src < PIPE_REGS &&
+                pipe->ready[insn->store_src] > t) {
+                pipe->stats.raw_stalls += pipe->ready[insn->store_src] - t;
+                t = pipe->ready[insn->store_src];
+            }
+            if (t + 1 <= pipe->ports[pipe->next_port]) {
+                // every port is already taken this cycle
+                pipe->stats.port_stalls += pipe->ports[pipe->next_port] - t;
+                t = pipe->ports[pipe->next_port];
+            }
+        }
+
+        pipe->cur[s] = t;
+    }
+
+    return pipe->cur[pipe->first[PIPE_MEMORY]];
+}
+
+/*
+ * Finish the instruction; mem_latency is how long its data access held it
+ * in M (1 if it had none).  A load whose miss went on without it passes
+ * data_ready, the cycle its value arrives, and 0 otherwise.  Returns the
+ * cycle it enters the last stage.
+ */
+unsigned long iplc_pipe_retire(iplc_pipe_t *pipe, int mem_latency, unsigned long data_ready)
+{
+    const iplc_pipe_insn_t *insn = &pipe->insn;
+    int m = pipe->first[PIPE_MEMORY];
+    int s;
+
+    if (insn->is_mem) {
+        pipe->stats.memory_stalls += mem_latency - 1;
+        pipe->ports[pipe->next_port] = pipe->cur[m] + 1;
+        pipe->next_port = (pipe->next_port + 1) % pipe->mem_ports;
+    }
+
+    for (s = m + 1; s < pipe->depth; s++)
+        pipe->cur[s] = pipe_enter(pipe, s, pipe->cur[s - 1] + (s == m + 1 && insn->is_mem ? mem_latency : 1));
+
+    if (insn->dest > 0 && insn->dest < PIPE_REGS) {
+        // M and W both follow X, so last X + 2 is always a stage
+        pipe->ready[insn->dest] = pipe->cur[(insn->is_load ? pipe->last[PIPE_MEMORY]
+                                                           : pipe->last[PIPE_EXECUTE]) + 1];
+        pipe->ready[insn->dest] = MAX(pipe->ready[insn->dest], data_ready);
+        pipe->bypass[insn->dest] = insn->is_load ? 0 : pipe->cur[pipe->last[PIPE_EXECUTE] + 2];
+        pipe->written[insn->dest] = pipe->cur[pipe->depth - 1];
+        pipe->from_load[insn->dest] = (uint8_t) insn->is_load;
+    }
+
+    pipe->fetch_ready = pipe->cur[0] + insn->fetch_latency - 1;
+
+    for (s = 0; s < pipe->depth; s++) {
+        pipe->ring[s][pipe->slot] = pipe->cur[s];
+        pipe->prev[s] = pipe->cur[s];
+    }
+    pipe->slot = (pipe->slot + 1) % pipe->width;
+
+    pipe->stats.instructions++;
+    pipe->stats.cycles = MAX(pipe->stats.cycles, pipe->cur[pipe->depth - 1] + 1);
+    return pipe->cur[pipe->depth - 1];
+}
+
+/*
+ * The cycle the last instruction entered stage s.
+ */
+unsigned long iplc_pipe_stage_cycle(const iplc_pipe_t *pipe, int stage)
+{
+    if (stage < 0 || stage >= pipe->depth)
+        return 0;
+    return pipe->prev[stage];
+}
+
+void iplc_pipe_get_stats(const iplc_pipe_t *pipe, iplc_pipe_stats_t *stats)
+{
+    *stats = pipe->stats;
+}
+
+/*
+ * Every cycle the pipeline remembers is in the struct itself, so that is
+ * the checkpoint.
+ */
+int iplc_pipe_save(const iplc_pipe_t *pipe, FILE *f)
+{
+    return fwrite(pipe, sizeof(iplc_pipe_t), 1, f) == 1 ? 0 : -1;
+}
+
+/*
+ * Returns -1 for a different stage string, width, resolve stage or port
+ * count.
+ */
+int iplc_pipe_load(iplc_pipe_t *pipe, FILE *f)
+{
+    iplc_pipe_t saved;
+
+    if (fread(&saved, sizeof(iplc_pipe_t), 1, f) != 1)
+        return -1;
+    if (saved.depth != pipe->depth || saved.width != pipe->width || saved.resolve != pipe->resolve ||
+        saved.mem_ports != pipe->mem_ports || memcmp(saved.role, pipe->role, sizeof(pipe->role)) != 0)
+        return -1;
+    *pipe = saved;
+    return 0;
+}
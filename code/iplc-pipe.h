@@ -0,0 +1,99 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- configurable in-order pipeline
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_PIPE_H
+#define IPLC_PIPE_H
+
+#include <stdio.h>
+
+#include "iplc-sim.h"
+
+#define PIPE_MAX_STAGES MAX_PIPE_STAGES
+#define PIPE_MAX_WIDTH 8
+#define PIPE_REGS 32
+
+// stage roles, as written in a stage string such as "FDXMW" or "FFDDXXMMW"
+enum pipe_role {PIPE_FETCH, PIPE_DECODE, PIPE_EXECUTE, PIPE_MEMORY, PIPE_WRITEBACK,
+                NUM_PIPE_ROLES};
+
+// how the previous instruction left the fetch stream
+enum pipe_redirect {PIPE_SEQUENTIAL, PIPE_TAKEN, PIPE_MISPREDICT};
+
+/*
+ * An in-order pipeline of any depth and issue width, timed by when each
+ * instruction enters each stage rather than by moving stage contents
+ * around cycle by cycle.  Every instruction goes through every stage in
+ * order, and each stage holds at most width instructions at once, so a
+ * stalled instruction holds up everything behind it.
+ *
+ * The stage string gives one letter per stage: F(etch), D(ecode),
+ * X (execute), M(emory) and W(riteback), in that order, each at least
+ * once.  A role spread over several letters takes that many cycles.
+ *
+ *   fetch       up to width instructions a cycle; a taken branch ends the
+ *               group, a mispredicted one restarts fetch the cycle after it
+ *               reaches the resolve stage, and an instruction cache access
+ *               that takes L cycles holds fetch for L - 1 more
+ *   execute     needs its source registers, fully forwarded: an ALU result
+ *               is there once its producer leaves the last X stage, a load
+ *               once it leaves the last M stage
+ *   resolve     a branch or register jump reads its operands in the resolve
+ *               stage instead (or the first X, if that comes first), and
+ *               waits there for them the same way
+ *   memory      at most mem_ports loads/stores enter M per cycle, and a data
+ *               access that takes L cycles stays in the first M stage L
+ *
+ * One instruction goes in with iplc_pipe_fetch(), iplc_pipe_execute() and
+ * iplc_pipe_retire(), in that order; the simulator does the cache accesses
+ * in between at the cycles these return.
+ */
+typedef struct iplc_pipe iplc_pipe_t;
+
+typedef struct iplc_pipe_insn
+{
+    int fetch_latency;          // cycles to get the instruction
+    int is_mem;                 // LW or SW
+    int is_load;
+    int dest;                   // register written, -1 if none
+    int src[2];                 // registers read in X, -1 if none
+    int store_src;              // register a store reads in M, -1 if none
+    int is_branch;              // BRANCH or JR: src[] are read where it resolves
+
+} iplc_pipe_insn_t;
+
+typedef struct iplc_pipe_stats
+{
+    unsigned long cycles;
+    unsigned long instructions;
+    unsigned long raw_stalls;       // cycles execute (or resolve) waited for an operand
+    unsigned long port_stalls;      // cycles a load/store waited for a memory port
+    unsigned long memory_stalls;    // data access cycles past the first
+    unsigned long fetch_stalls;     // instruction access cycles past the first
+    unsigned long redirect_stalls;  // fetch cycles lost to mispredicted branches
+    unsigned long hazards[NUM_HAZARD_KINDS];        // forwarded operands, or instructions held up
+    unsigned long hazard_stalls[NUM_HAZARD_KINDS];  // raw_stalls, by what was waited for
+
+} iplc_pipe_stats_t;
+
+int iplc_pipe_valid_stages(const char *stages);
+
+iplc_pipe_t *iplc_pipe_create(const char *stages, int width, int resolve_stage, int mem_ports);
+void iplc_pipe_destroy(iplc_pipe_t *pipe);
+
+// Checkpoints, into a pipeline configured the same way
+int iplc_pipe_save(const iplc_pipe_t *pipe, FILE *f);
+int iplc_pipe_load(iplc_pipe_t *pipe, FILE *f);
+
+int iplc_pipe_depth(const iplc_pipe_t *pipe);
+int iplc_pipe_resolve_stage(const iplc_pipe_t *pipe);
+
+unsigned long iplc_pipe_fetch(iplc_pipe_t *pipe, int redirect);
+unsigned long iplc_pipe_execute(iplc_pipe_t *pipe, const iplc_pipe_insn_t *insn);
+unsigned long iplc_pipe_retire(iplc_pipe_t *pipe, int mem_latency, unsigned long data_ready);
+unsigned long iplc_pipe_stage_cycle(const iplc_pipe_t *pipe, int stage);
+
+void iplc_pipe_get_stats(const iplc_pipe_t *pipe, iplc_pipe_stats_t *stats);
+
+#endif
@@ -0,0 +1,219 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- hardware prefetchers
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "iplc-prefetch.h"
+
+typedef struct stride_entry
+{
+    uint32_t pc;
+    uint32_t last;              // last data address of this PC
+    int32_t stride;
+    uint8_t confidence;         // 0..3, prefetch from 2 up
+    uint8_t valid;
+
+} stride_entry_t;
+
+typedef struct stream_buffer
+{
+    uint32_t head;              // next block the stream expects
+    uint32_t next;              // next block to prefetch
+    unsigned long used;         // LRU stamp
+    int valid;
+
+} stream_buffer_t;
+
+struct iplc_prefetch
+{
+    int kind;
+    int degree;
+    int blockoffsetbits;
+    unsigned long clock;
+
+    stride_entry_t stride[PREFETCH_STRIDE_ENTRIES];
+    stream_buffer_t stream[PREFETCH_STREAMS];
+};
+
+static const char *prefetch_names[NUM_PREFETCH_KINDS] = {"none", "next-line", "stride", "stream"};
+
+const char *iplc_prefetch_name(int kind)
+{
+    if (kind < 0 || kind >= NUM_PREFETCH_KINDS)
+        return "?";
+    return prefetch_names[kind];
+}
+
+/*
+ * Look a prefetcher up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_prefetch_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_PREFETCH_KINDS; i++) {
+        if (strcasecmp(name, prefetch_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+iplc_prefetch_t *iplc_prefetch_create(int kind, int degree, int blockoffsetbits)
+{
+    iplc_prefetch_t *pf;
+
+    if (kind <= PREFETCH_NONE || kind >= NUM_PREFETCH_KINDS ||
+        degree < 1 || degree > PREFETCH_MAX_DEGREE)
+        return NULL;
+
+    pf = (iplc_prefetch_t *) calloc(1, sizeof(iplc_prefetch_t));
+    if (pf == NULL)
+        return NULL;
+
+    pf->kind = kind;
+    pf->degree = degree;
+    pf->blockoffsetbits = blockoffsetbits;
+    return pf;
+}
+
+void iplc_prefetch_destroy(iplc_prefetch_t *pf)
+{
+    free(pf);
+}
+
+/************************************************************************************************/
+/* Prefetcher Functions *************************************************************************/
+/************************************************************************************************/
+
+static int next_line_observe(iplc_prefetch_t *pf, uint32_t block, int event, uint32_t *candidates)
+{
+    int k;
+
+    if (event == PREFETCH_EVENT_HIT)
+        return 0;
+
+    for (k = 0; k < pf->degree; k++)
+        candidates[k] = (block + 1 + k) << pf->blockoffsetbits;
+    return pf->degree;
+}
+
+static int stride_observe(iplc_prefetch_t *pf, uint32_t pc, uint32_t address,
+                          uint32_t *candidates)
+{
+    stride_entry_t *e = &pf->stride[(pc >> 2) % PREFETCH_STRIDE_ENTRIES];
+    int32_t delta;
+    uint32_t block, last_block;
+    int k, n = 0;
+
+    if (!e->valid || e->pc != pc) {
+        bzero(e, sizeof(stride_entry_t));
+        e->pc = pc;
+        e->last = address;
+        e->valid = 1;
+        return 0;
+    }
+
+    delta = (int32_t) (address - e->last);
+    if (delta != 0 && delta == e->stride) {
+        if (e->confidence < 3)
+            e->confidence++;
+    }
+    else {
+        if (e->confidence > 0)
+            e->confidence--;
+        if (e->confidence < 2)
+            e->stride = delta;
+    }
+    e->last = address;
+
+    if (e->confidence < 2)
+        return 0;
+
+    // one candidate per block, however short the stride
+    last_block = address >> pf->blockoffsetbits;
+    for (k = 1; k <= pf->degree; k++) {
+        block = (address + (uint32_t) (e->stride * k)) >> pf->blockoffsetbits;
+        if (block != last_block)
+            candidates[n++] = block << pf->blockoffsetbits;
+        last_block = block;
+    }
+    return n;
+}
+
+static int stream_observe(iplc_prefetch_t *pf, uint32_t block, int event, uint32_t *candidates)
+{
+    stream_buffer_t *s, *victim = &pf->stream[0];
+    int i, n = 0;
+
+    pf->clock++;
+
+    for (i = 0; i < PREFETCH_STREAMS; i++) {
+        s = &pf->stream[i];
+        if (s->valid && block >= s->head && block < s->next) {
+            // the stream moved on: stay degree blocks ahead of it
+            s->head = block + 1;
+            s->used = pf->clock;
+            while (s->next < block + 1 + pf->degree)
+                candidates[n++] = s->next++ << pf->blockoffsetbits;
+            return n;
+        }
+        if (!s->valid || s->used < victim->used)
+            victim = s;
+    }
+
+    if (event != PREFETCH_EVENT_MISS)
+        return 0;
+
+    victim->valid = 1;
+    victim->used = pf->clock;
+    victim->head = block + 1;
+    for (victim->next = block + 1; victim->next < block + 1 + pf->degree; victim->next++)
+        candidates[n++] = victim->next << pf->blockoffsetbits;
+    return n;
+}
+
+/*
+ * Tell the prefetcher about one demand access.  Fills candidates (room for
+ * PREFETCH_MAX_DEGREE) with block addresses to prefetch and returns how
+ * many there are.
+ */
+int iplc_prefetch_observe(iplc_prefetch_t *pf, uint32_t pc, uint32_t address, int event,
+                          uint32_t *candidates)
+{
+    switch (pf->kind) {
+        case PREFETCH_NEXT_LINE:
+            return next_line_observe(pf, address >> pf->blockoffsetbits, event, candidates);
+        case PREFETCH_STRIDE:
+            return stride_observe(pf, pc, address, candidates);
+        case PREFETCH_STREAM:
+            return stream_observe(pf, address >> pf->blockoffsetbits, event, candidates);
+    }
+    return 0;
+}
+
+/*
+ * The stride table and stream buffers are written out as they are.
+ */
+int iplc_prefetch_save(const iplc_prefetch_t *pf, FILE *f)
+{
+    return fwrite(pf, sizeof(iplc_prefetch_t), 1, f) == 1 ? 0 : -1;
+}
+
+/*
+ * Returns -1 for a different kind, degree or block size.
+ */
+int iplc_prefetch_load(iplc_prefetch_t *pf, FILE *f)
+{
+    iplc_prefetch_t saved;
+
+    if (fread(&saved, sizeof(iplc_prefetch_t), 1, f) != 1)
+        return -1;
+    if (saved.kind != pf->kind || saved.degree != pf->degree || saved.blockoffsetbits != pf->blockoffsetbits)
+        return -1;
+    *pf = saved;
+    return 0;
+}
@@ -0,0 +1,53 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- hardware prefetchers
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_PREFETCH_H
+#define IPLC_PREFETCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum prefetch_kind {PREFETCH_NONE, PREFETCH_NEXT_LINE, PREFETCH_STRIDE, PREFETCH_STREAM,
+                    NUM_PREFETCH_KINDS};
+
+// what the demand access that a prefetcher observes did in L1
+enum prefetch_event {PREFETCH_EVENT_MISS, PREFETCH_EVENT_HIT, PREFETCH_EVENT_PREFETCH_HIT};
+
+#define PREFETCH_MAX_DEGREE 16
+#define PREFETCH_STRIDE_ENTRIES 64  // reference prediction table, direct mapped on the PC
+#define PREFETCH_STREAMS 4
+
+/*
+ * A prefetcher watches the demand accesses of one L1 and answers each one
+ * with up to degree block addresses worth bringing in.  It never touches a
+ * cache itself; the simulator issues the prefetches, skipping blocks that
+ * are already there.
+ *
+ *   next-line  on a miss or the first use of a prefetched block, the next
+ *              degree blocks (tagged next-line)
+ *   stride     per-PC table of the last address and stride with a 2-bit
+ *              confidence; once a stride repeats, degree strides ahead.
+ *              Keyed on the LW/SW address, so meant for L1D.
+ *   stream     a few stream buffers, each following one ascending run of
+ *              blocks and staying degree blocks ahead of it.  Streams are
+ *              allocated on a miss and replaced LRU.  The prefetched blocks
+ *              go into the cache rather than a separate buffer.
+ */
+typedef struct iplc_prefetch iplc_prefetch_t;
+
+const char *iplc_prefetch_name(int kind);
+int iplc_prefetch_parse(const char *name);
+
+iplc_prefetch_t *iplc_prefetch_create(int kind, int degree, int blockoffsetbits);
+void iplc_prefetch_destroy(iplc_prefetch_t *pf);
+
+// Checkpoints, into a prefetcher configured the same way
+int iplc_prefetch_save(const iplc_prefetch_t *pf, FILE *f);
+int iplc_prefetch_load(iplc_prefetch_t *pf, FILE *f);
+
+int iplc_prefetch_observe(iplc_prefetch_t *pf, uint32_t pc, uint32_t address, int event,
+                          uint32_t *candidates);
+
+#endif
@@ -0,0 +1,443 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- miss classification and hotspot profiling
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iplc-profile.h"
+
+#define MAP_EMPTY INT32_MIN
+#define MAP_INITIAL_SLOTS 1024
+
+/*
+ * Open addressing hash map from a 32-bit key to an int32_t, grown at half
+ * full.  Nothing is ever removed.
+ */
+typedef struct profile_map
+{
+    uint32_t *keys;
+    int32_t *values;            // MAP_EMPTY for a free slot
+    uint32_t mask;              // slots - 1
+    uint32_t count;
+
+} profile_map_t;
+
+typedef struct profile_cache
+{
+    int blockoffsetbits;
+    uint32_t capacity;          // blocks in the real cache, and so in the shadow
+    uint32_t used;
+    uint32_t *block;            // fully associative shadow, a list from mru to lru
+    int32_t *prev;
+    int32_t *next;
+    int32_t mru;
+    int32_t lru;
+    profile_map_t seen;         // every block ever touched -> its node above, -1 if not there
+    long classes[NUM_MISS_CLASSES];
+
+} profile_cache_t;
+
+typedef struct profile_entry
+{
+    uint32_t key;
+    long accesses;
+    long misses;
+    long stall_cycles;
+    long classes[NUM_MISS_CLASSES];
+
+} profile_entry_t;
+
+typedef struct profile_table
+{
+    profile_map_t map;          // key -> index into entries
+    profile_entry_t *entries;
+    uint32_t count;
+    uint32_t cap;
+    long misses;
+
+} profile_table_t;
+
+enum profile_tables {TABLE_FETCH_PC, TABLE_DATA_PC, TABLE_DATA_REGION, NUM_TABLES};
+
+struct iplc_profile
+{
+    int region_bits;
+    int ncaches;
+    profile_cache_t cache[PROFILE_MAX_CACHES];
+    profile_table_t table[NUM_TABLES];
+};
+
+static const char *class_names[NUM_MISS_CLASSES] = {"compulsory", "capacity", "conflict"};
+
+const char *iplc_profile_class_name(int miss_class)
+{
+    if (miss_class < 0 || miss_class >= NUM_MISS_CLASSES)
+        return "?";
+    return class_names[miss_class];
+}
+
+/************************************************************************************************/
+/* Map Functions ********************************************************************************/
+/************************************************************************************************/
+
+static inline uint32_t map_hash(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x7feb352du;
+    key ^= key >> 15;
+    key *= 0x846ca68bu;
+    key ^= key >> 16;
+    return key;
+}
+
+static int map_init(profile_map_t *map, uint32_t slots)
+{
+    uint32_t i;
+
+    map->keys = (uint32_t *) malloc(slots * sizeof(uint32_t));
+    map->values = (int32_t *) malloc(slots * sizeof(int32_t));
+    if (map->keys == NULL || map->values == NULL) {
+        free(map->keys);
+        free(map->values);
+        return -1;
+    }
+    for (i = 0; i < slots; i++)
+        map->values[i] = MAP_EMPTY;
+    map->mask = slots - 1;
+    map->count = 0;
+    return 0;
+}
+
+static void map_free(profile_map_t *map)
+{
+    free(map->keys);
+    free(map->values);
+}
+
+static int32_t *map_find(const profile_map_t *map, uint32_t key)
+{
+    uint32_t i = map_hash(key) & map->mask;
+
+    while (map->values[i] != MAP_EMPTY) {
+        if (map->keys[i] == key)
+            return &map->values[i];
+        i = (i + 1) & map->mask;
+    }
+    return NULL;
+}
+
+/*
+ * The value slot of key, added (and left MAP_EMPTY, with *fresh set) if it
+ * was not there.  The pointer is good until the next insert.  Returns NULL
+ * if the map could not grow.
+ */
+static int32_t *map_insert(profile_map_t *map, uint32_t key, int *fresh)
+{
+    profile_map_t bigger;
+    uint32_t i;
+
+    *fresh = 0;
+    if ((map->count + 1) * 2 > map->mask + 1) {
+        if (map_init(&bigger, (map->mask + 1) * 2) != 0)
+            return NULL;
+        for (i = 0; i <= map->mask; i++) {
+            if (map->values[i] != MAP_EMPTY) {
+                uint32_t j = map_hash(map->keys[i]) & bigger.mask;
+                while (bigger.values[j] != MAP_EMPTY)
+                    j = (j + 1) & bigger.mask;
+                bigger.keys[j] = map->keys[i];
+                bigger.values[j] = map->values[i];
+            }
+        }
+        bigger.count = map->count;
+        map_free(map);
+        *map = bigger;
+    }
+
+    i = map_hash(key) & map->mask;
+    while (map->values[i] != MAP_EMPTY) {
+        if (map->keys[i] == key)
+            return &map->values[i];
+        i = (i + 1) & map->mask;
+    }
+    map->keys[i] = key;
+    map->count++;
+    *fresh = 1;
+    return &map->values[i];
+}
+
+/************************************************************************************************/
+/* Lifetime Functions ***************************************************************************/
+/************************************************************************************************/
+
+/*
+ * region_bits sets the data region size of the hotspot report.  Returns
+ * NULL for a region_bits outside 0..31.
+ */
+iplc_profile_t *iplc_profile_create(int region_bits)
+{
+    iplc_profile_t *prof;
+    int t;
+
+    if (region_bits < 0 || region_bits > 31)
+        return NULL;
+
+    prof = (iplc_profile_t *) calloc(1, sizeof(iplc_profile_t));
+    if (prof == NULL)
+        return NULL;
+
+    prof->region_bits = region_bits;
+    for (t = 0; t < NUM_TABLES; t++) {
+        if (map_init(&prof->table[t].map, MAP_INITIAL_SLOTS) != 0) {
+            iplc_profile_destroy(prof);
+            return NULL;
+        }
+    }
+    return prof;
+}
+
+void iplc_profile_destroy(iplc_profile_t *prof)
+{
+    int i;
+
+    if (prof == NULL)
+        return;
+
+    for (i = 0; i < prof->ncaches; i++) {
+        free(prof->cache[i].block);
+        free(prof->cache[i].prev);
+        free(prof->cache[i].next);
+        map_free(&prof->cache[i].seen);
+    }
+    for (i = 0; i < NUM_TABLES; i++) {
+        map_free(&prof->table[i].map);
+        free(prof->table[i].entries);
+    }
+    free(prof);
+}
+
+/*
+ * Watch one more L1, of blocks blocks.  Returns its number for
+ * iplc_profile_access(), or -1.
+ */
+int iplc_profile_add_cache(iplc_profile_t *prof, int blockoffsetbits, uint32_t blocks)
+{
+    profile_cache_t *c;
+
+    if (prof->ncaches == PROFILE_MAX_CACHES || blocks == 0)
+        return -1;
+
+    c = &prof->cache[prof->ncaches];
+    c->blockoffsetbits = blockoffsetbits;
+    c->capacity = blocks;
+    c->block = (uint32_t *) malloc(blocks * sizeof(uint32_t));
+    c->prev = (int32_t *) malloc(blocks * sizeof(int32_t));
+    c->next = (int32_t *) malloc(blocks * sizeof(int32_t));
+    c->mru = c->lru = -1;
+    if (c->block == NULL || c->prev == NULL || c->next == NULL ||
+        map_init(&c->seen, MAP_INITIAL_SLOTS) != 0) {
+        free(c->block);
+        free(c->prev);
+        free(c->next);
+        bzero(c, sizeof(profile_cache_t));
+        return -1;
+    }
+    return prof->ncaches++;
+}
+
+/************************************************************************************************/
+/* Classification Functions *********************************************************************/
+/************************************************************************************************/
+
+static inline void fa_unlink(profile_cache_t *c, int32_t n)
+{
+    if (c->prev[n] >= 0)
+        c->next[c->prev[n]] = c->next[n];
+    else
+        c->mru = c->next[n];
+    if (c->next[n] >= 0)
+        c->prev[c->next[n]] = c->prev[n];
+    else
+        c->lru = c->prev[n];
+}
+
+static inline void fa_push(profile_cache_t *c, int32_t n)
+{
+    c->prev[n] = -1;
+    c->next[n] = c->mru;
+    if (c->mru >= 0)
+        c->prev[c->mru] = n;
+    c->mru = n;
+    if (c->lru < 0)
+        c->lru = n;
+}
+
+/*
+ * Run block through both shadows.  Returns the class of a miss in the real
+ * cache, or -1 for a hit there.
+ */
+static int profile_classify(profile_cache_t *c, uint32_t block, int hit)
+{
+    int32_t *node, *old;
+    int32_t n;
+    int fresh, fa_hit;
+
+    node = map_insert(&c->seen, block, &fresh);
+    if (node == NULL)
+        return hit ? -1 : MISS_CAPACITY;
+    if (fresh)
+        *node = -1;
+
+    fa_hit = *node >= 0;
+    if (fa_hit) {
+        n = *node;
+        fa_unlink(c, n);
+    }
+    else if (c->used < c->capacity) {
+        n = (int32_t) c->used++;
+    }
+    else {
+        n = c->lru;
+        fa_unlink(c, n);
+        old = map_find(&c->seen, c->block[n]);
+        if (old != NULL)
+            *old = -1;
+    }
+    c->block[n] = block;
+    fa_push(c, n);
+    *node = n;
+
+    if (hit)
+        return -1;
+    return fresh ? MISS_COMPULSORY : fa_hit ? MISS_CONFLICT : MISS_CAPACITY;
+}
+
+static void table_add(profile_table_t *t, uint32_t key, int miss_class, int stall)
+{
+    profile_entry_t *e, *grown;
+    int32_t *index;
+    int fresh;
+
+    index = map_insert(&t->map, key, &fresh);
+    if (index == NULL)
+        return;
+    if (fresh) {
+        if (t->count == t->cap) {
+            grown = (profile_entry_t *) realloc(t->entries, sizeof(profile_entry_t) *
+                                                (t->cap ? t->cap * 2 : 256));
+            if (grown == NULL) {
+                *index = MAP_EMPTY;     // give the slot back; nothing else points at it yet
+                t->map.count--;
+                return;
+            }
+            t->entries = grown;
+            t->cap = t->cap ? t->cap * 2 : 256;
+        }
+        *index = (int32_t) t->count;
+        e = &t->entries[t->count++];
+        bzero(e, sizeof(profile_entry_t));
+        e->key = key;
+    }
+
+    e = &t->entries[*index];
+    e->accesses++;
+    e->stall_cycles += stall;
+    if (miss_class >= 0) {
+        e->misses++;
+        e->classes[miss_class]++;
+        t->misses++;
+    }
+}
+
+/*
+ * One access to L1 number cache: hit or not in the real cache, and stall
+ * the cycles it took past an L1 hit.  Returns the class of a miss, or -1
+ * for a hit.
+ */
+int iplc_profile_access(iplc_profile_t *prof, int cache, int kind, uint32_t pc, uint32_t address,
+                        int hit, int stall)
+{
+    profile_cache_t *c = &prof->cache[cache];
+    int miss_class;
+
+    miss_class = profile_classify(c, address >> c->blockoffsetbits, hit);
+    if (miss_class >= 0)
+        c->classes[miss_class]++;
+
+    if (kind == PROFILE_FETCH) {
+        table_add(&prof->table[TABLE_FETCH_PC], pc, miss_class, stall);
+    }
+    else {
+        table_add(&prof->table[TABLE_DATA_PC], pc, miss_class, stall);
+        table_add(&prof->table[TABLE_DATA_REGION], address >> prof->region_bits, miss_class, stall);
+    }
+    return miss_class;
+}
+
+/************************************************************************************************/
+/* Result Functions *****************************************************************************/
+/************************************************************************************************/
+
+void iplc_profile_classes(const iplc_profile_t *prof, int cache, long classes[NUM_MISS_CLASSES])
+{
+    memcpy(classes, prof->cache[cache].classes, sizeof(long) * NUM_MISS_CLASSES);
+}
+
+static int profile_entry_compare(const void *a, const void *b)
+{
+    const profile_entry_t *ea = *(const profile_entry_t * const *) a;
+    const profile_entry_t *eb = *(const profile_entry_t * const *) b;
+
+    if (ea->misses != eb->misses)
+        return ea->misses > eb->misses ? -1 : 1;
+    if (ea->stall_cycles != eb->stall_cycles)
+        return ea->stall_cycles > eb->stall_cycles ? -1 : 1;
+    return ea->key < eb->key ? -1 : ea->key > eb->key;
+}
+
+static void profile_table_report(const profile_table_t *t, const char *title, const char *what,
+                                 int shift, int top)
+{
+    const profile_entry_t **sorted;
+    const profile_entry_t *e;
+    uint32_t i, n = 0;
+
+    sorted = (const profile_entry_t **) malloc(sizeof(profile_entry_t *) * (t->count + 1));
+    if (sorted == NULL)
+        return;
+    for (i = 0; i < t->count; i++) {
+        if (t->entries[i].misses > 0)
+            sorted[n++] = &t->entries[i];
+    }
+    qsort(sorted, n, sizeof(profile_entry_t *), profile_entry_compare);
+
+    printf(" %s: top %d of %u %s with misses \n", title, top < (int) n ? top : (int) n, n, what);
+    printf("\t Rank  Address       Misses   Share   Accesses  Stall Cycles  Compulsory  Capacity  Conflict\n");
+    for (i = 0; i < n && (int) i < top; i++) {
+        e = sorted[i];
+        printf("\t %4u  0x%08x  %8ld  %5.1f%%  %9ld  %12ld  %10ld  %8ld  %8ld\n", i + 1,
+               e->key << shift, e->misses, 100.0 * (double) e->misses / (double) t->misses,
+               e->accesses, e->stall_cycles, e->classes[MISS_COMPULSORY],
+               e->classes[MISS_CAPACITY], e->classes[MISS_CONFLICT]);
+    }
+    printf("\n");
+    free(sorted);
+}
+
+/*
+ * The top hotspots, most misses first: instruction fetches by PC, data
+ * accesses by the PC of the load or store, and data accesses by region.
+ */
+void iplc_profile_report(const iplc_profile_t *prof, int top)
+{
+    char regions[32];
+
+    snprintf(regions, sizeof(regions), "%d-byte regions", 1 << prof->region_bits);
+    profile_table_report(&prof->table[TABLE_FETCH_PC], "Instruction Miss Hotspots", "PCs", 0, top);
+    profile_table_report(&prof->table[TABLE_DATA_PC], "Data Miss Hotspots by PC", "PCs", 0, top);
+    profile_table_report(&prof->table[TABLE_DATA_REGION], "Data Miss Hotspots by Region", regions,
+                         prof->region_bits, top);
+}
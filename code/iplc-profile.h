@@ -0,0 +1,45 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- miss classification and hotspot profiling
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_PROFILE_H
+#define IPLC_PROFILE_H
+
+#include <stdint.h>
+
+enum miss_class {MISS_COMPULSORY, MISS_CAPACITY, MISS_CONFLICT, NUM_MISS_CLASSES};
+
+// which L1 an access went to, and what it was
+#define PROFILE_MAX_CACHES 2
+enum profile_access {PROFILE_FETCH, PROFILE_LOAD, PROFILE_STORE};
+
+/*
+ * Watches every L1 access and says where the misses came from.
+ *
+ * Each L1 gets two shadows: an infinite cache (every block ever touched)
+ * and a fully associative LRU cache with the same number of blocks.  A
+ * miss is compulsory if the infinite cache had never seen the block,
+ * capacity if the fully associative cache missed too, and conflict if only
+ * the real cache's mapping lost it.
+ *
+ * Misses, the cycles they took past an L1 hit, and their classes are also
+ * added up per instruction address (fetches and data accesses apart) and
+ * per data region of 2^region_bits bytes, for the hotspot report.
+ */
+typedef struct iplc_profile iplc_profile_t;
+
+const char *iplc_profile_class_name(int miss_class);
+
+iplc_profile_t *iplc_profile_create(int region_bits);
+void iplc_profile_destroy(iplc_profile_t *prof);
+
+int iplc_profile_add_cache(iplc_profile_t *prof, int blockoffsetbits, uint32_t blocks);
+int iplc_profile_access(iplc_profile_t *prof, int cache, int kind, uint32_t pc, uint32_t address,
+                        int hit, int stall);
+
+// Results
+void iplc_profile_classes(const iplc_profile_t *prof, int cache, long classes[NUM_MISS_CLASSES]);
+void iplc_profile_report(const iplc_profile_t *prof, int top);
+
+#endif
@@ -0,0 +1,251 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- replacement policies
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "iplc-cache.h"
+
+#define NO_WAY 0xff
+
+/************************************************************************************************/
+/* LRU: doubly linked recency order, MRU at the head ********************************************/
+/************************************************************************************************/
+/*
+ * meta: head, tail, prev[assoc], next[assoc]
+ */
+static size_t lru_set_bytes(int assoc)
+{
+    return 2 + 2 * (size_t) assoc;
+}
+
+static void lru_init_set(iplc_cache_t *cache, uint8_t *meta)
+{
+    uint8_t *prev = meta + 2, *next = meta + 2 + cache->assoc;
+    int i;
+
+    for (i = 0; i < cache->assoc; i++) {
+        prev[i] = i == 0 ? NO_WAY : i - 1;
+        next[i] = i == cache->assoc - 1 ? NO_WAY : i + 1;
+    }
+    meta[0] = 0;
+    meta[1] = cache->assoc - 1;
+}
+
+static int lru_victim(iplc_cache_t *cache, uint8_t *meta)
+{
+    return meta[1];
+}
+
+static void lru_touch(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+    uint8_t *prev = meta + 2, *next = meta + 2 + cache->assoc;
+
+    if (meta[0] == way)
+        return;
+
+    // unlink
+    next[prev[way]] = next[way];
+    if (next[way] != NO_WAY)
+        prev[next[way]] = prev[way];
+    else
+        meta[1] = prev[way];
+
+    // push on the front
+    prev[way] = NO_WAY;
+    next[way] = meta[0];
+    prev[meta[0]] = way;
+    meta[0] = way;
+}
+
+/************************************************************************************************/
+/* Tree-PLRU: one bit per internal node, pointing away from the last use ************************/
+/************************************************************************************************/
+
+static size_t plru_set_bytes(int assoc)
+{
+    return sizeof(uint64_t);
+}
+
+static void plru_init_set(iplc_cache_t *cache, uint8_t *meta)
+{
+    memset(meta, 0, sizeof(uint64_t));
+}
+
+static int plru_victim(iplc_cache_t *cache, uint8_t *meta)
+{
+    uint64_t bits;
+    int node = 1;
+
+    memcpy(&bits, meta, sizeof(bits));
+    while (node < cache->assoc)
+        node = 2 * node + (int) ((bits >> node) & 1);
+    return node - cache->assoc;
+}
+
+static void plru_touch(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+    uint64_t bits;
+    int node = way + cache->assoc;
+
+    memcpy(&bits, meta, sizeof(bits));
+    while (node > 1) {
+        int right = node & 1;
+        node >>= 1;
+        // point the parent at the other half
+        if (right)
+            bits &= ~(1ull << node);
+        else
+            bits |= 1ull << node;
+    }
+    memcpy(meta, &bits, sizeof(bits));
+}
+
+/************************************************************************************************/
+/* FIFO: ways in the order they were filled, oldest first ***************************************/
+/************************************************************************************************/
+/*
+ * meta: order[assoc].  A round-robin pointer is not enough: invalid ways
+ * are filled first, and once back-invalidation or coherence has left one
+ * in the middle of a full set, the pointer would no longer be at the
+ * oldest block.
+ */
+static size_t fifo_set_bytes(int assoc)
+{
+    return (size_t) assoc;
+}
+
+static void fifo_init_set(iplc_cache_t *cache, uint8_t *meta)
+{
+    int i;
+
+    for (i = 0; i < cache->assoc; i++)
+        meta[i] = i;
+}
+
+static int fifo_victim(iplc_cache_t *cache, uint8_t *meta)
+{
+    return meta[0];
+}
+
+static void fifo_touch(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+}
+
+static void fifo_insert(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+    int i;
+
+    for (i = 0; meta[i] != way; i++)
+        ;
+    memmove(meta + i, meta + i + 1, cache->assoc - 1 - i);
+    meta[cache->assoc - 1] = way;
+}
+
+/************************************************************************************************/
+/* Random: xorshift, seeded per cache so runs are repeatable ************************************/
+/************************************************************************************************/
+
+static size_t random_set_bytes(int assoc)
+{
+    return 0;
+}
+
+static void random_init_set(iplc_cache_t *cache, uint8_t *meta)
+{
+}
+
+static int random_victim(iplc_cache_t *cache, uint8_t *meta)
+{
+    cache->rng ^= cache->rng << 13;
+    cache->rng ^= cache->rng >> 7;
+    cache->rng ^= cache->rng << 17;
+    return (int) (cache->rng % (uint64_t) cache->assoc);
+}
+
+/************************************************************************************************/
+/* SRRIP/BRRIP: 2-bit re-reference prediction value per way *************************************/
+/************************************************************************************************/
+
+#define RRPV_MAX 3
+#define BRRIP_LONG_ONE_IN 32
+
+static size_t rrip_set_bytes(int assoc)
+{
+    return (size_t) assoc;
+}
+
+static void rrip_init_set(iplc_cache_t *cache, uint8_t *meta)
+{
+    memset(meta, RRPV_MAX, cache->assoc);
+}
+
+static int rrip_victim(iplc_cache_t *cache, uint8_t *meta)
+{
+    int i;
+
+    for (;;) {
+        for (i = 0; i < cache->assoc; i++) {
+            if (meta[i] == RRPV_MAX)
+                return i;
+        }
+        for (i = 0; i < cache->assoc; i++)
+            meta[i]++;
+    }
+}
+
+static void rrip_touch(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+    meta[way] = 0;
+}
+
+static void srrip_insert(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+    meta[way] = RRPV_MAX - 1;
+}
+
+static void brrip_insert(iplc_cache_t *cache, uint8_t *meta, int way)
+{
+    // mostly distant re-reference, occasionally long
+    cache->rng ^= cache->rng << 13;
+    cache->rng ^= cache->rng >> 7;
+    cache->rng ^= cache->rng << 17;
+    meta[way] = (cache->rng % BRRIP_LONG_ONE_IN) == 0 ? RRPV_MAX - 1 : RRPV_MAX;
+}
+
+/************************************************************************************************/
+/* Policy Table *********************************************************************************/
+/************************************************************************************************/
+
+static const iplc_repl_policy_t policies[NUM_REPL_POLICIES] = {
+    {"LRU", lru_set_bytes, lru_init_set, lru_victim, lru_touch, lru_touch},
+    {"PLRU", plru_set_bytes, plru_init_set, plru_victim, plru_touch, plru_touch},
+    {"FIFO", fifo_set_bytes, fifo_init_set, fifo_victim, fifo_touch, fifo_insert},
+    {"RANDOM", random_set_bytes, random_init_set, random_victim, fifo_touch, fifo_touch},
+    {"SRRIP", rrip_set_bytes, rrip_init_set, rrip_victim, rrip_touch, srrip_insert},
+    {"BRRIP", rrip_set_bytes, rrip_init_set, rrip_victim, rrip_touch, brrip_insert},
+};
+
+const iplc_repl_policy_t *iplc_repl_policy(int policy)
+{
+    if (policy < 0 || policy >= NUM_REPL_POLICIES)
+        return NULL;
+    return &policies[policy];
+}
+
+/*
+ * Look a policy up by name, case-insensitively.  Returns -1 if unknown.
+ */
+int iplc_repl_policy_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_REPL_POLICIES; i++) {
+        if (strcasecmp(name, policies[i].name) == 0)
+            return i;
+    }
+    return -1;
+}
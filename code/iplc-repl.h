@@ -0,0 +1,38 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- replacement policies
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_REPL_H
+#define IPLC_REPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct iplc_cache;
+
+enum repl_policy {REPL_LRU, REPL_PLRU, REPL_FIFO, REPL_RANDOM, REPL_SRRIP, REPL_BRRIP,
+                  NUM_REPL_POLICIES};
+
+/*
+ * A replacement policy keeps set_bytes(assoc) bytes of state per set in the
+ * cache arena.  The cache fills invalid ways itself and only asks for a
+ * victim when the set is full, so victim() always picks a valid way.
+ * Every operation is O(1) or O(log assoc) except the RRIP victim search,
+ * which only runs on a miss.
+ */
+typedef struct iplc_repl_policy
+{
+    const char *name;
+    size_t (*set_bytes)(int assoc);
+    void (*init_set)(struct iplc_cache *cache, uint8_t *meta);
+    int (*victim)(struct iplc_cache *cache, uint8_t *meta);
+    void (*touch)(struct iplc_cache *cache, uint8_t *meta, int way);     // hit
+    void (*insert)(struct iplc_cache *cache, uint8_t *meta, int way);    // fill
+
+} iplc_repl_policy_t;
+
+const iplc_repl_policy_t *iplc_repl_policy(int policy);
+int iplc_repl_policy_parse(const char *name);
+
+#endif
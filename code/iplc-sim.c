@@ -8,83 +8,26 @@
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
-
-#define MAX_CACHE_SIZE 10240
-#define CACHE_MISS_DELAY 10 // 10 cycle cache miss penalty
-#define MAX_STAGES 5
-
-// init the simulator
-void iplc_sim_init(int index, int blocksize, int assoc);
-
-// Cache simulator functions
-void iplc_sim_LRU_replace_on_miss(int index, int tag);
-void iplc_sim_LRU_update_on_hit(int index, int assoc);
-int iplc_sim_trap_address(unsigned int address);
-
-// Pipeline functions
-unsigned int iplc_sim_parse_reg(char *reg_str);
-void iplc_sim_parse_instruction(char *buffer);
-void iplc_sim_push_pipeline_stage();
-void iplc_sim_process_pipeline_rtype(char *instruction, int dest_reg,
-                                     int reg1, int reg2_or_constant);
-void iplc_sim_process_pipeline_lw(int dest_reg, int base_reg, unsigned int data_address);
-void iplc_sim_process_pipeline_sw(int src_reg, int base_reg, unsigned int data_address);
-void iplc_sim_process_pipeline_branch(int reg1, int reg2);
-void iplc_sim_process_pipeline_jump();
-void iplc_sim_process_pipeline_syscall();
-void iplc_sim_process_pipeline_nop();
-
-// Outout performance results
-void iplc_sim_finalize();
-
-typedef struct assoc_set
-{
-  // Due to 2-way and 4-way set asasociativity, cache lines could have
-  // sets that can fit multiple blocks in them.
-  int valid;
-  int tag;
-} set_t;
-
-typedef struct cache_line
-{
-    // Your data structures for implementing your cache should include:
-    // a valid bit
-    // a tag
-    // a method for handling varying levels of associativity
-    // a method for selecting which item in the cache is going to be replaced
-    set_t* sets;
-    unsigned int* replacements;
-} cache_line_t;
-
-cache_line_t *cache=NULL;
-int cache_index=0;
-int cache_blocksize=0;
-int cache_blockoffsetbits = 0;
-int cache_assoc=0;
-long cache_miss=0;
-long cache_access=0;
-long cache_hit=0;
-
-char instruction[16];
-char reg1[16];
-char reg2[16];
-char offsetwithreg[16];
-unsigned int data_address=0;
-unsigned int instruction_address=0;
-unsigned int pipeline_cycles=0;   // how many cycles did your pipeline consume
-unsigned int instruction_count=0; // how many real instructions ran thru the pipeline
-unsigned int branch_predict_taken=0;
-unsigned int branch_count=0;
-unsigned int correct_branch_predictions=0;
-
-unsigned int debug=0;
-unsigned int dump_pipeline=1;
-
-enum instruction_type {NOP, RTYPE, LW, SW, BRANCH, JUMP, JAL, SYSCALL};
+#include <strings.h>
+
+#include "iplc-sim.h"
+#include "iplc-cache.h"
+#include "iplc-repl.h"
+#include "iplc-prefetch.h"
+#include "iplc-bpred.h"
+#include "iplc-pipe.h"
+#include "iplc-wbuf.h"
+#include "iplc-mshr.h"
+#include "iplc-profile.h"
+#include "iplc-interval.h"
+#include "iplc-event.h"
+#include "iplc-perf.h"
+#include "iplc-coherence.h"
 
 typedef struct rtype
 {
-    char instruction[16];
+    int opcode;
+    int immediate;  // reg2_or_constant is a constant, not a register
     int reg1;
     int reg2_or_constant;
     int dest_reg;
@@ -115,7 +58,9 @@ typedef struct branch
 
 typedef struct jump
 {
-    char instruction[16];
+    int opcode;
+    int reg;        // JR/JALR target register, -1 for J/JAL
+    int dest_reg;   // JAL/JALR link register, -1 for J/JR
 
 } jump_t;
 
@@ -135,242 +80,1724 @@ typedef struct pipeline
 
 } pipeline_t;
 
-enum pipeline_stages {FETCH, DECODE, ALU, MEM, WRITEBACK};
+enum pipeline_stages {FETCH, DECODE, ALU, MEM, WRITEBACK};
+
+#define PIPELINE_RING_SIZE 8    // a power of two, at least MAX_STAGES
+#define PIPELINE_RING_MASK (PIPELINE_RING_SIZE - 1)
+
+#define SAMPLE_Z 1.96           // 95% two-sided
+#define SAMPLE_TARGET_Z 3.0     // 99.7%, for the samples a +-3% estimate needs
+#define SAMPLE_TARGET_ERROR 0.03
+
+enum hierarchy_level {LEVEL_L1I, LEVEL_L1D, LEVEL_L2, LEVEL_L3};
+
+/*
+ * Everything one simulation owns.  These used to be file-scope globals; the
+ * names are kept so the cache and pipeline code reads the same.
+ */
+struct iplc_sim
+{
+    iplc_sim_config_t config;
+
+    iplc_cache_t *l1i;          // instruction fetches
+    iplc_cache_t *l1d;          // loads and stores, the same cache as l1i unless split_l1
+    iplc_cache_t *lower[2];     // L2 and L3
+    int nlower;                 // how many of lower[] are there
+    int latency[3];             // hit latency of L1, L2, L3
+    int inclusion[3];           // of L2 and L3 (index 0 unused)
+    long back_invalidations[IPLC_MAX_LEVELS];   // by enum hierarchy_level
+    long memory_cycles;         // sum of the latencies of every access
+    long memory_reads;          // blocks, and bytes, to and from memory
+    long memory_writes;
+    long memory_read_bytes;
+    long memory_write_bytes;
+    iplc_wbuf_t *wbuf;          // NULL without a write buffer
+    int write_stall;            // cycles the current access waited for the write buffer
+    iplc_mshr_t *mshr;          // NULL for a blocking L1D
+    unsigned long reg_ready[32];    // cycle an outstanding load's register arrives, 0 if none is
+    long mshr_wait_cycles;      // classic pipeline: cycles spent waiting for one
+    iplc_prefetch_t *prefetch_i;    // NULL when not prefetching
+    iplc_prefetch_t *prefetch_d;
+    iplc_cache_t *shadow[NUM_REPL_POLICIES];    // compare_policies only
+    iplc_bpred_t *bpred;
+    iplc_bpred_t *bpred_shadow[NUM_BPRED_KINDS];    // compare_predictors only
+    iplc_profile_t *profile;    // config.profile only
+    iplc_interval_t *interval;  // config.interval only
+    unsigned long interval_next;    // instruction count that ends the current interval
+    long fetches;               // L1 accesses by kind, which a unified L1 does not keep apart
+    long fetch_misses;
+    long data_accesses;
+    long data_misses;
+    iplc_coherence_t *coherence;    // a core of a multi-core run: the shared L2 and directory
+    int core;                       // ... and which core this is
+
+    unsigned int instruction_address;
+    unsigned long pipeline_cycles;   // how many cycles did your pipeline consume
+    unsigned long instruction_count; // how many real instructions ran thru the pipeline
+    unsigned long branch_count;
+    unsigned long correct_branch_predictions;
+    long hazards[NUM_HAZARD_KINDS];         // config.hazards only; the pipe model counts its own
+    long hazard_stalls[NUM_HAZARD_KINDS];
+    int branch_waiting;                     // the branch in DECODE has already been held up
+
+    unsigned int quiet;
+    int verbosity;              // VERBOSITY_STATS unless there is somewhere for events to go
+    iplc_event_sink_t *events;
+#if defined(IPLC_PERF)
+    iplc_perf_t *perf;          // without hardware counters when quiet
+#endif
+
+    /*
+     * The pipeline is a ring of stage slots: stage s is in
+     * pipeline[(pipeline_head + s) & PIPELINE_RING_MASK], so moving every
+     * stage on is just pipeline_head--.
+     */
+    pipeline_t pipeline[PIPELINE_RING_SIZE];
+    unsigned int pipeline_head;
+
+    // the configurable pipeline; NULL runs the classic one above
+    iplc_pipe_t *pipe;
+    unsigned int pending_branch;    // address of a BRANCH waiting to see where fetch went next
+    int pending_jump;
+
+    // sampled simulation (config.sample_period)
+    long sample_pos;                // instruction within the current period
+    int warming;                    // functional warming: the caches see no time pass
+    unsigned int warm_branch;       // a warmed BRANCH waiting to see where the trace went next
+    int measuring;
+    long instructions_fed;          // detailed or only warmed
+    long warmed_instructions;       // only warmed
+    unsigned long sample_cycles;    // counters when the current measurement began
+    long sample_instructions;
+    long sample_access;
+    long sample_miss;
+    long samples;
+    double cpi_sum, cpi_sumsq;
+    double miss_sum, miss_sumsq;
+};
+
+static inline pipeline_t *iplc_sim_stage(iplc_sim_t *sim, int stage)
+{
+    return &sim->pipeline[(sim->pipeline_head + stage) & PIPELINE_RING_MASK];
+}
+
+/*
+ * Hand one event to the sink.  Callers check sim->verbosity first, so a
+ * run that prints nothing never builds one.
+ */
+static inline void iplc_sim_event(iplc_sim_t *sim, int kind, unsigned long cycle, unsigned int address,
+                                  int itype, int stage, int flags)
+{
+    iplc_event_t e;
+
+    IPLC_PERF_ENTER(sim->perf, PERF_OUTPUT);
+    e.cycle = cycle;
+    e.address = address;
+    e.kind = (uint8_t) kind;
+    e.itype = (uint8_t) itype;
+    e.stage = (uint8_t) stage;
+    e.flags = (uint8_t) flags;
+    iplc_event_emit(sim->events, &e);
+    IPLC_PERF_LEAVE(sim->perf);
+}
+
+// Cache simulator functions
+static int iplc_sim_trap_address(iplc_sim_t *sim, iplc_cache_t *l1, iplc_prefetch_t *pf,
+                                 unsigned int pc, unsigned int address, int kind, int *latency);
+
+// Pipeline functions
+static unsigned int iplc_sim_parse_reg(char *reg_str);
+static void iplc_sim_push_pipeline_stage(iplc_sim_t *sim);
+static void iplc_sim_process_pipeline_rtype(iplc_sim_t *sim, int opcode, int immediate,
+                                            int dest_reg, int reg1, int reg2_or_constant);
+static void iplc_sim_process_pipeline_lw(iplc_sim_t *sim, int dest_reg, int base_reg,
+                                         unsigned int data_address);
+static void iplc_sim_process_pipeline_sw(iplc_sim_t *sim, int src_reg, int base_reg,
+                                         unsigned int data_address);
+static void iplc_sim_process_pipeline_branch(iplc_sim_t *sim, int reg1, int reg2);
+static void iplc_sim_process_pipeline_jump(iplc_sim_t *sim, int opcode, int reg, int dest_reg);
+static void iplc_sim_process_pipeline_syscall(iplc_sim_t *sim);
+static void iplc_sim_process_pipeline_nop(iplc_sim_t *sim);
+static void iplc_sim_dump_pipeline(iplc_sim_t *sim);
+static void iplc_sim_drain_pipeline(iplc_sim_t *sim);
+
+// Sampling functions
+static double iplc_sim_confidence(long n, double sum, double sumsq, double z, double *mean);
+
+// Interval functions
+static void iplc_sim_interval_counters(const iplc_sim_t *sim, iplc_interval_counters_t *c);
+static void iplc_sim_interval(iplc_sim_t *sim);
+
+/************************************************************************************************/
+/* Cache Functions ******************************************************************************/
+/************************************************************************************************/
+/*
+ * Size of a cache configuration in bits: data, tag and valid bit per block.
+ */
+unsigned long iplc_sim_cache_size(int index, int blocksize, int assoc)
+{
+    int blockoffsetbits =
+    (int) rint((log( (double) (blocksize * 4) )/ log(2)));
+    /* Note: rint function rounds the result up prior to casting */
+
+    return assoc * ( 1 << index ) * ((32 * blocksize) + 33 - index - blockoffsetbits);
+}
+
+/*
+ * Default configuration: the same settings the original interactive
+ * simulator started with.
+ */
+void iplc_sim_config_init(iplc_sim_config_t *config)
+{
+    bzero(config, sizeof(iplc_sim_config_t));
+    config->index = 7;
+    config->blocksize = 1;
+    config->assoc = 1;
+    config->branch_predict_taken = 0;
+    config->replacement = REPL_LRU;
+    config->compare_policies = 0;
+    config->split_l1 = 0;
+    config->l1_latency = 1;
+    config->memory_latency = CACHE_MISS_DELAY;
+    config->write_through = 0;
+    config->write_allocate = 1;
+    config->write_buffer = 0;
+    config->mshrs = 0;
+    config->prefetch_i = PREFETCH_NONE;
+    config->prefetch_d = PREFETCH_NONE;
+    config->prefetch_degree = 2;
+    config->branch_predictor = BPRED_STATIC;
+    config->bpred_table_bits = 10;
+    config->bpred_history_bits = 10;
+    config->btb_bits = 0;
+    config->compare_predictors = 0;
+    config->pipeline_stages[0] = '\0';
+    config->issue_width = 1;
+    config->branch_resolve_stage = -1;
+    config->mem_ports = 1;
+    config->hazards = 0;
+    config->sample_period = 0;
+    config->sample_warmup = 0;
+    config->sample_size = 0;
+    config->profile = 0;
+    config->profile_region_bits = 12;
+    config->interval = 0;
+    config->interval_format = INTERVAL_CSV;
+    config->interval_file = NULL;
+    config->quiet = 0;
+    config->verbosity = VERBOSITY_STATS;
+    config->event_log = NULL;
+}
+
+static const char *inclusion_names[NUM_INCLUSION_POLICIES] = {"NINE", "inclusive", "exclusive"};
+
+const char *iplc_sim_inclusion_name(int inclusion)
+{
+    if (inclusion < 0 || inclusion >= NUM_INCLUSION_POLICIES)
+        return "?";
+    return inclusion_names[inclusion];
+}
+
+/*
+ * Look an inclusion policy up by name, case-insensitively.  Returns -1 if
+ * unknown.
+ */
+int iplc_sim_inclusion_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_INCLUSION_POLICIES; i++) {
+        if (strcasecmp(name, inclusion_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Anything beyond the original single cache with a flat miss penalty?
+ */
+static int iplc_sim_has_hierarchy(const iplc_sim_config_t *config)
+{
+    return config->split_l1 || config->l2.assoc > 0 || config->l1_latency != 1 ||
+           config->memory_latency != CACHE_MISS_DELAY;
+}
+
+/*
+ * Anything beyond the original write-back, write-allocate L1 whose stores
+ * wait for themselves like loads?
+ */
+static int iplc_sim_has_write_model(const iplc_sim_config_t *config)
+{
+    return config->write_through || !config->write_allocate || config->write_buffer > 0;
+}
+
+static const char *iplc_sim_interval_file(const iplc_sim_config_t *config)
+{
+    if (config->interval_file != NULL)
+        return config->interval_file;
+    return config->interval_format == INTERVAL_BINARY ? "iplc-intervals.bin" : "iplc-intervals.csv";
+}
+
+/*
+ * Correctly configure the cache.  Returns NULL if the configuration does not
+ * fit in MAX_CACHE_SIZE.  MAX_CACHE_SIZE only limits L1 (each of L1I and
+ * L1D when split); L2 and L3 can be any size.
+ */
+iplc_sim_t *iplc_sim_create(const iplc_sim_config_t *config)
+{
+    unsigned long cache_size = 0;
+    iplc_sim_t *sim;
+
+    cache_size = iplc_sim_cache_size(config->index, config->blocksize, config->assoc);
+
+    if (!config->quiet) {
+        printf("Cache Configuration \n");
+        printf("   Index: %d bits or %d lines \n", config->index, (1<<config->index) );
+        printf("   BlockSize: %d \n", config->blocksize );
+        printf("   Associativity: %d \n", config->assoc );
+        if (iplc_repl_policy(config->replacement) != NULL)
+            printf("   Replacement: %s \n", iplc_repl_policy(config->replacement)->name );
+        printf("   BlockOffSetBits: %d \n",
+               (int) rint((log( (double) (config->blocksize * 4) )/ log(2))) );
+        printf("   CacheSize: %lu \n", cache_size );
+        if (iplc_sim_has_hierarchy(config)) {
+            if (config->split_l1)
+                printf("   Split L1: L1I and L1D, %lu each \n", cache_size );
+            printf("   L1 Latency: %d cycles \n", config->l1_latency );
+            if (config->l2.assoc > 0)
+                printf("   L2: Index %d BlockSize %d Associativity %d Latency %d %s \n",
+                       config->l2.index, config->l2.blocksize, config->l2.assoc,
+                       config->l2.latency, iplc_sim_inclusion_name(config->l2.inclusion) );
+            if (config->l2.assoc > 0 && config->l3.assoc > 0)
+                printf("   L3: Index %d BlockSize %d Associativity %d Latency %d %s \n",
+                       config->l3.index, config->l3.blocksize, config->l3.assoc,
+                       config->l3.latency, iplc_sim_inclusion_name(config->l3.inclusion) );
+            printf("   Memory Latency: %d cycles \n", config->memory_latency );
+        }
+        if (iplc_sim_has_write_model(config))
+            printf("   Writes: %s, %s, %d write buffer entries \n",
+                   config->write_through ? "write-through" : "write-back",
+                   config->write_allocate ? "write-allocate" : "no-write-allocate",
+                   config->write_buffer );
+        if (config->mshrs > 0)
+            printf("   Non-blocking L1D: %d MSHRs \n", config->mshrs );
+        if (config->sample_period > 0)
+            printf("   Sampling: %ld of every %ld instructions, after %ld in detail \n",
+                   config->sample_size, config->sample_period, config->sample_warmup );
+        if (config->pipeline_stages[0] != '\0')
+            printf("   Pipeline: %s, %d-wide, %d memory port(s), branches resolve in stage %d \n",
+                   config->pipeline_stages, config->issue_width, config->mem_ports,
+                   config->branch_resolve_stage >= 0 || strchr(config->pipeline_stages, 'D') == NULL ?
+                   config->branch_resolve_stage :
+                   (int) (strrchr(config->pipeline_stages, 'D') - config->pipeline_stages) );
+        if (config->branch_predictor != BPRED_STATIC || config->btb_bits > 0)
+            printf("   Branch Predictor: %s, %d table bits, %d history bits, %d BTB entries \n",
+                   iplc_bpred_name(config->branch_predictor), config->bpred_table_bits,
+                   config->bpred_history_bits, config->btb_bits ? 1 << config->btb_bits : 0 );
+        if (config->prefetch_i != PREFETCH_NONE || config->prefetch_d != PREFETCH_NONE)
+            printf("   Prefetch: L1I %s, L1D %s, degree %d \n", iplc_prefetch_name(config->prefetch_i),
+                   iplc_prefetch_name(config->prefetch_d), config->prefetch_degree );
+        if (config->profile > 0)
+            printf("   Profiling: top %d hotspots, %d-bit data regions \n", config->profile,
+                   config->profile_region_bits );
+        if (config->interval > 0)
+            printf("   Intervals: every %ld instructions, %s to %s \n", config->interval,
+                   iplc_interval_format_name(config->interval_format), iplc_sim_interval_file(config) );
+    }
+
+    if (cache_size > MAX_CACHE_SIZE ) {
+        if (!config->quiet)
+            printf("Cache too big. Great than MAX SIZE of %d .... \n", MAX_CACHE_SIZE);
+        return NULL;
+    }
+
+    /*
+     * An exclusive level swaps whole blocks with the level above, so the
+     * block sizes have to agree.
+     */
+    if ((config->l2.assoc > 0 && config->l2.inclusion == INCLUSION_EXCLUSIVE &&
+         config->l2.blocksize != config->blocksize) ||
+        (config->l2.assoc > 0 && config->l3.assoc > 0 &&
+         config->l3.inclusion == INCLUSION_EXCLUSIVE &&
+         config->l3.blocksize != config->l2.blocksize)) {
+        if (!config->quiet)
+            printf("An exclusive cache needs the same block size as the level above it \n");
+        return NULL;
+    }
+
+    // all counters start at zero and every pipeline stage starts as a NOP
+    sim = (iplc_sim_t *) calloc(1, sizeof(iplc_sim_t));
+    if (sim == NULL)
+        return NULL;
+
+    sim->config = *config;
+    sim->quiet = config->quiet;
+
+    // Dynamically create our cache based on the information the user entered
+    sim->l1i = iplc_cache_create(config->index, config->blocksize, config->assoc,
+                                 config->replacement);
+    if (sim->l1i == NULL) {
+        if (!config->quiet)
+            printf("Unsupported replacement policy for this cache \n");
+        free(sim);
+        return NULL;
+    }
+    sim->l1d = sim->l1i;
+    if (config->split_l1) {
+        sim->l1d = iplc_cache_create(config->index, config->blocksize, config->assoc,
+                                     config->replacement);
+        if (sim->l1d == NULL) {
+            if (!config->quiet)
+                printf("Unsupported L1D configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    sim->latency[0] = config->l1_latency;
+    if (config->l2.assoc > 0) {
+        sim->lower[0] = iplc_cache_create(config->l2.index, config->l2.blocksize,
+                                          config->l2.assoc, config->replacement);
+        sim->latency[1] = config->l2.latency;
+        sim->inclusion[1] = config->l2.inclusion;
+        sim->nlower = 1;
+        if (sim->lower[0] == NULL) {
+            if (!config->quiet)
+                printf("Unsupported L2 configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+    if (config->l2.assoc > 0 && config->l3.assoc > 0) {
+        sim->lower[1] = iplc_cache_create(config->l3.index, config->l3.blocksize,
+                                          config->l3.assoc, config->replacement);
+        sim->latency[2] = config->l3.latency;
+        sim->inclusion[2] = config->l3.inclusion;
+        sim->nlower = 2;
+        if (sim->lower[1] == NULL) {
+            if (!config->quiet)
+                printf("Unsupported L3 configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    if (config->prefetch_i != PREFETCH_NONE) {
+        sim->prefetch_i = iplc_prefetch_create(config->prefetch_i, config->prefetch_degree,
+                                               sim->l1i->blockoffsetbits);
+        if (iplc_cache_enable_prefetch(sim->l1i) != 0) {
+            iplc_prefetch_destroy(sim->prefetch_i);
+            sim->prefetch_i = NULL;
+        }
+    }
+    if (config->prefetch_d != PREFETCH_NONE) {
+        sim->prefetch_d = iplc_prefetch_create(config->prefetch_d, config->prefetch_degree,
+                                               sim->l1d->blockoffsetbits);
+        if (iplc_cache_enable_prefetch(sim->l1d) != 0) {
+            iplc_prefetch_destroy(sim->prefetch_d);
+            sim->prefetch_d = NULL;
+        }
+    }
+    if ((config->prefetch_i != PREFETCH_NONE && sim->prefetch_i == NULL) ||
+        (config->prefetch_d != PREFETCH_NONE && sim->prefetch_d == NULL)) {
+        if (!config->quiet)
+            printf("Unsupported prefetcher configuration \n");
+        iplc_sim_destroy(sim);
+        return NULL;
+    }
+
+    sim->bpred = iplc_bpred_create(config->branch_predictor, config->bpred_table_bits,
+                                   config->bpred_history_bits, config->btb_bits,
+                                   config->branch_predict_taken);
+    if (sim->bpred == NULL) {
+        if (!config->quiet)
+            printf("Unsupported branch predictor configuration \n");
+        iplc_sim_destroy(sim);
+        return NULL;
+    }
+    if (config->compare_predictors) {
+        int k;
+        for (k = 0; k < NUM_BPRED_KINDS; k++) {
+            if (k != config->branch_predictor)
+                sim->bpred_shadow[k] = iplc_bpred_create(k, config->bpred_table_bits,
+                                                         config->bpred_history_bits,
+                                                         config->btb_bits,
+                                                         config->branch_predict_taken);
+        }
+    }
+
+    if (config->write_buffer > 0) {
+        sim->wbuf = iplc_wbuf_create(config->write_buffer);
+        if (sim->wbuf == NULL) {
+            if (!config->quiet)
+                printf("Unsupported write buffer configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    if (config->sample_period < 0 || (config->sample_period > 0 &&
+        (config->sample_size < 1 || config->sample_warmup < 0 ||
+         config->sample_warmup + config->sample_size > config->sample_period))) {
+        if (!config->quiet)
+            printf("Unsupported sampling configuration \n");
+        iplc_sim_destroy(sim);
+        return NULL;
+    }
+
+    if (config->mshrs > 0) {
+        sim->mshr = iplc_mshr_create(config->mshrs);
+        if (sim->mshr == NULL) {
+            if (!config->quiet)
+                printf("Unsupported MSHR configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    /*
+     * The fully associative shadow of each L1 gets as many blocks as the
+     * real one, so a miss it does not share is down to the set mapping.
+     */
+    if (config->profile != 0) {
+        uint32_t blocks = (1u << config->index) * (uint32_t) config->assoc;
+        sim->profile = config->profile > 0 ? iplc_profile_create(config->profile_region_bits) : NULL;
+        if (sim->profile == NULL ||
+            iplc_profile_add_cache(sim->profile, sim->l1i->blockoffsetbits, blocks) < 0 ||
+            (sim->l1d != sim->l1i &&
+             iplc_profile_add_cache(sim->profile, sim->l1d->blockoffsetbits, blocks) < 0)) {
+            if (!config->quiet)
+                printf("Unsupported profiling configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    if (config->interval != 0) {
+        sim->interval = config->interval > 0 ?
+                        iplc_interval_create(iplc_sim_interval_file(config), config->interval_format,
+                                             (unsigned long) config->interval) : NULL;
+        if (sim->interval == NULL) {
+            if (!config->quiet)
+                printf("Could not write intervals to %s \n", iplc_sim_interval_file(config));
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+        sim->interval_next = (unsigned long) config->interval;
+    }
+
+    // a quiet simulator can still log events, but prints none
+    if (config->verbosity > VERBOSITY_STATS && (config->event_log != NULL || !config->quiet)) {
+        sim->events = iplc_event_sink_create(config->event_log != NULL ? EVENT_SINK_BINARY : EVENT_SINK_TEXT,
+                                             config->event_log);
+        if (sim->events == NULL) {
+            if (!config->quiet)
+                printf("Could not write events to %s \n", config->event_log);
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+        sim->verbosity = config->verbosity;
+    }
+
+    if (config->pipeline_stages[0] != '\0') {
+        sim->pipe = iplc_pipe_create(config->pipeline_stages, config->issue_width,
+                                     config->branch_resolve_stage, config->mem_ports);
+        if (sim->pipe == NULL) {
+            if (!config->quiet)
+                printf("Unsupported pipeline configuration \n");
+            iplc_sim_destroy(sim);
+            return NULL;
+        }
+    }
+
+    // shadow tag arrays see the same accesses but never affect timing
+    if (config->compare_policies) {
+        int p;
+        for (p = 0; p < NUM_REPL_POLICIES; p++) {
+            if (p != config->replacement)
+                sim->shadow[p] = iplc_cache_create(config->index, config->blocksize,
+                                                   config->assoc, p);
+        }
+    }
+
+#if defined(IPLC_PERF)
+    // last, so the clock starts when the simulator is ready to run; a quiet
+    // one only keeps times for its driver to merge (iplc_sim_perf())
+    sim->perf = iplc_perf_create(!config->quiet);
+#endif
+
+    return sim;
+}
+
+/*
+ * Release everything iplc_sim_create() allocated.
+ */
+void iplc_sim_destroy(iplc_sim_t *sim)
+{
+    int p;
+
+    if (sim == NULL)
+        return;
+
+    if (sim->l1d != sim->l1i)
+        iplc_cache_destroy(sim->l1d);
+    iplc_cache_destroy(sim->l1i);
+    iplc_cache_destroy(sim->lower[0]);
+    iplc_cache_destroy(sim->lower[1]);
+    iplc_prefetch_destroy(sim->prefetch_i);
+    iplc_prefetch_destroy(sim->prefetch_d);
+    iplc_bpred_destroy(sim->bpred);
+    iplc_pipe_destroy(sim->pipe);
+    iplc_wbuf_destroy(sim->wbuf);
+    iplc_mshr_destroy(sim->mshr);
+    iplc_profile_destroy(sim->profile);
+    iplc_interval_destroy(sim->interval);
+    iplc_event_sink_destroy(sim->events);
+#if defined(IPLC_PERF)
+    iplc_perf_destroy(sim->perf);
+#endif
+    for (p = 0; p < NUM_BPRED_KINDS; p++)
+        iplc_bpred_destroy(sim->bpred_shadow[p]);
+    for (p = 0; p < NUM_REPL_POLICIES; p++)
+        iplc_cache_destroy(sim->shadow[p]);
+    free(sim);
+}
+
+/*
+ * Make sim core number core of a multi-core run: its L1D is kept coherent
+ * with the other cores' by coh, and its misses go to coh's shared L2.  It
+ * needs a split L1 and no levels of its own below it.  Returns -1 if it
+ * does not have that shape.
+ */
+int iplc_sim_attach_coherence(iplc_sim_t *sim, iplc_coherence_t *coh, int core)
+{
+    if (!sim->config.split_l1 || sim->nlower > 0 || core < 0 || core >= COHERENCE_MAX_CORES)
+        return -1;
+    sim->coherence = coh;
+    sim->core = core;
+    return 0;
+}
+
+/*
+ * The self profile of a build with IPLC_PERF, for drivers running quiet
+ * simulators to merge; NULL otherwise.
+ */
+struct iplc_perf *iplc_sim_perf(iplc_sim_t *sim)
+{
+#if defined(IPLC_PERF)
+    return sim->perf;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * The cycle the simulation has reached, for drivers that keep several in
+ * step.
+ */
+unsigned long iplc_sim_cycles(const iplc_sim_t *sim)
+{
+    return sim->pipeline_cycles;
+}
+
+/*
+ * bytes of the block at address leave level k (0 is L1) for the levels
+ * below it: the first one holding the block takes the write and marks it
+ * dirty, otherwise it goes to memory.  With a write buffer the write is
+ * queued there, and any wait for room is added to the current access.
+ * Returns the cycles the write takes.
+ */
+static int iplc_sim_write_back(iplc_sim_t *sim, int k, uint32_t address, uint32_t bytes)
+{
+    int j, latency = sim->config.memory_latency;
+
+    for (j = k + 1; j <= sim->nlower; j++) {
+        if (iplc_cache_set_dirty(sim->lower[j - 1], address)) {
+            latency = sim->latency[j];
+            break;
+        }
+    }
+    if (j > sim->nlower) {
+        sim->memory_writes++;
+        sim->memory_write_bytes += bytes;
+    }
+
+    if (sim->wbuf != NULL && !sim->warming)
+        sim->write_stall += iplc_wbuf_write(sim->wbuf, address >> sim->l1d->blockoffsetbits,
+                                            sim->pipeline_cycles, latency);
+    return latency;
+}
+
+/*
+ * Level k (1 is L2, 2 is L3) is inclusive and just lost the block at
+ * victim: knock every copy of it out of the levels above.  A dirty copy is
+ * written on down past level k.
+ */
+static void iplc_sim_back_invalidate(iplc_sim_t *sim, int k, uint32_t victim)
+{
+    iplc_cache_t *above[3] = {sim->l1i, sim->l1d != sim->l1i ? sim->l1d : NULL,
+                              k == 2 ? sim->lower[0] : NULL};
+    static const int id[3] = {LEVEL_L1I, LEVEL_L1D, LEVEL_L2};
+    uint32_t bytes = 1u << sim->lower[k - 1]->blockoffsetbits;
+    uint32_t offset;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (above[i] == NULL)
+            continue;
+        // the victim may span several smaller blocks of the level above
+        for (offset = 0; offset < bytes; offset += 1u << above[i]->blockoffsetbits) {
+            if (iplc_cache_invalidate(above[i], victim + offset)) {
+                sim->back_invalidations[id[i]]++;
+                if (above[i]->victim_dirty)
+                    iplc_sim_write_back(sim, k, victim + offset, 1u << above[i]->blockoffsetbits);
+            }
+        }
+    }
+}
+
+/*
+ * Level k (0 is L1) just evicted the block at victim.  An inclusive level
+ * takes it out of the levels above; an exclusive level below takes it in,
+ * dirty or not.  Otherwise a dirty victim is written back.
+ */
+static void iplc_sim_evicted(iplc_sim_t *sim, int k, uint32_t victim, int dirty)
+{
+    iplc_cache_t *cache = k == 0 ? sim->l1d : sim->lower[k - 1];
+    uint32_t evicted;
+
+    if (k > 0 && sim->inclusion[k] == INCLUSION_INCLUSIVE)
+        iplc_sim_back_invalidate(sim, k, victim);
+
+    if (k < sim->nlower && sim->inclusion[k + 1] == INCLUSION_EXCLUSIVE) {
+        if (iplc_cache_fill(sim->lower[k], victim, &evicted))
+            iplc_sim_evicted(sim, k + 1, evicted, sim->lower[k]->victim_dirty);
+        if (dirty)
+            iplc_cache_set_dirty(sim->lower[k], victim);
+    }
+    else if (dirty) {
+        iplc_sim_write_back(sim, k, victim, 1u << cache->blockoffsetbits);
+    }
+}
+
+/*
+ * Find a block that missed L1 in whatever is below it.  Each level is only
+ * probed if the one above missed; on the way back the block is filled into
+ * every level it missed in, except exclusive ones, and an exclusive level
+ * that hit gives its copy up.  Returns the cycles the access takes.
+ */
+static int iplc_sim_lower_access(iplc_sim_t *sim, unsigned int address)
+{
+    uint32_t evicted;
+    int found, k;
+
+    for (found = 1; found <= sim->nlower; found++) {
+        if (iplc_cache_probe(sim->lower[found - 1], address))
+            break;
+    }
+
+    if (found > sim->nlower) {
+        sim->memory_reads++;
+        sim->memory_read_bytes += 1u << (sim->nlower ? sim->lower[sim->nlower - 1] : sim->l1d)->blockoffsetbits;
+    }
+
+    // the block moves up clean, so a dirty copy is written on down first
+    if (found <= sim->nlower && sim->inclusion[found] == INCLUSION_EXCLUSIVE &&
+        iplc_cache_invalidate(sim->lower[found - 1], address) && sim->lower[found - 1]->victim_dirty)
+        iplc_sim_write_back(sim, found, address, 1u << sim->lower[found - 1]->blockoffsetbits);
+
+    for (k = found - 1; k >= 1; k--) {
+        if (sim->inclusion[k] != INCLUSION_EXCLUSIVE &&
+            iplc_cache_fill(sim->lower[k - 1], address, &evicted))
+            iplc_sim_evicted(sim, k, evicted, sim->lower[k - 1]->victim_dirty);
+    }
+
+    return found <= sim->nlower ? sim->latency[found] : sim->config.memory_latency;
+}
+
+/*
+ * Run an access through L1 and whatever is below it.  Returns 1 for an L1
+ * hit and the cycles the access took in *latency.
+ */
+static int iplc_sim_hierarchy_access(iplc_sim_t *sim, iplc_cache_t *l1, unsigned int address,
+                                     int *latency)
+{
+    uint32_t evicted;
+
+    if (iplc_cache_probe(l1, address)) {
+        *latency = sim->latency[0];
+        return 1;
+    }
+
+    *latency = iplc_sim_lower_access(sim, address);
+    if (iplc_cache_fill(l1, address, &evicted))
+        iplc_sim_evicted(sim, 0, evicted, l1->victim_dirty);
+    return 0;
+}
+
+/*
+ * The write half of a store that has been looked up in L1D, hit or not.
+ * Write-back marks the block dirty if it is there now; write-through, and
+ * a miss that did not allocate, send the word on down.  Without a write
+ * buffer the store waits for that write; with one, it waits for neither
+ * the write nor a fill, only for room in the buffer.  Returns the
+ * store's latency.
+ */
+static int iplc_sim_store(iplc_sim_t *sim, unsigned int address, int hit, int latency)
+{
+    int down;
+
+    if (sim->wbuf != NULL && !sim->warming && !hit && sim->config.write_allocate) {
+        sim->write_stall += iplc_wbuf_write(sim->wbuf, address >> sim->l1d->blockoffsetbits,
+                                            sim->pipeline_cycles, latency);
+        latency = sim->latency[0];
+    }
+
+    if ((hit || sim->config.write_allocate) && !sim->config.write_through) {
+        iplc_cache_set_dirty(sim->l1d, address);
+    }
+    else {
+        down = iplc_sim_write_back(sim, 0, address, 4);
+        if (sim->wbuf == NULL && down > latency)
+            latency = down;
+    }
+    return latency;
+}
+
+/*
+ * Show a demand access to the prefetcher of its L1 and start every block it
+ * asks for that is not there yet.  A prefetch finds its block below L1 the
+ * same way a miss does and arrives that many cycles from now.
+ */
+static void iplc_sim_prefetch(iplc_sim_t *sim, iplc_prefetch_t *pf, iplc_cache_t *l1,
+                              unsigned int pc, unsigned int address, int event)
+{
+    uint32_t candidates[PREFETCH_MAX_DEGREE];
+    uint32_t evicted;
+    int n, i, latency;
+
+    n = iplc_prefetch_observe(pf, pc, address, event, candidates);
+    for (i = 0; i < n; i++) {
+        if (iplc_cache_contains(l1, candidates[i]))
+            continue;
+        latency = iplc_sim_lower_access(sim, candidates[i]);
+        if (iplc_cache_prefetch(l1, candidates[i], sim->pipeline_cycles + latency, &evicted))
+            iplc_sim_evicted(sim, 0, evicted, l1->victim_dirty);
+    }
+}
+
+/*
+ * Check if the address is in our cache.  Update our counter statistics
+ * for cache_access, cache_hit, etc.  The cache module handles the
+ * associativity and replacement.  l1 is the L1I or L1D the access goes
+ * to and pf its prefetcher, if any; pc is the instruction making the
+ * access, and kind says whether it is a fetch, a LW or a SW.  *latency
+ * gets the cycles it takes.
+ */
+static int iplc_sim_trap_address(iplc_sim_t *sim, iplc_cache_t *l1, iplc_prefetch_t *pf,
+                                 unsigned int pc, unsigned int address, int kind, int *latency)
+{
+    long useful = l1->prefetch_useful;
+    int store = kind == PROFILE_STORE;
+    int p, hit, event;
+
+    IPLC_PERF_ENTER(sim->perf, PERF_CACHE);
+    if (sim->config.compare_policies) {
+        for (p = 0; p < NUM_REPL_POLICIES; p++) {
+            if (sim->shadow[p] != NULL)
+                iplc_cache_access(sim->shadow[p], address);
+        }
+    }
+
+    l1->now = sim->pipeline_cycles;
+
+    /* expects you to return 1 for hit, 0 for miss */
+    if (store && !sim->config.write_allocate) {
+        hit = iplc_cache_probe(l1, address);
+        *latency = sim->latency[0];
+    }
+    else if (sim->coherence != NULL && l1 == sim->l1d) {
+        hit = iplc_coherence_data(sim->coherence, sim->core, l1, address, store, latency);
+    }
+    else if (sim->coherence != NULL) {
+        hit = iplc_coherence_fetch(sim->coherence, sim->core, l1, address, latency);
+    }
+    else if (sim->nlower == 0) {
+        hit = iplc_cache_access(l1, address);
+        *latency = sim->latency[0];
+        if (!hit) {
+            *latency = sim->config.memory_latency;
+            sim->memory_reads++;
+            sim->memory_read_bytes += 1u << l1->blockoffsetbits;
+            if (l1->victim_dirty)
+                iplc_sim_write_back(sim, 0, l1->victim, 1u << l1->blockoffsetbits);
+        }
+    }
+    else {
+        hit = iplc_sim_hierarchy_access(sim, l1, address, latency);
+    }
+
+    if (pf != NULL) {
+        event = PREFETCH_EVENT_MISS;
+        if (hit && l1->prefetch_useful != useful) {
+            // first use of a prefetched block, which may still be on its way
+            event = PREFETCH_EVENT_PREFETCH_HIT;
+            if (l1->wait > (uint64_t) *latency)
+                *latency = (int) l1->wait;
+        }
+        else if (hit) {
+            event = PREFETCH_EVENT_HIT;
+        }
+        iplc_sim_prefetch(sim, pf, l1, pc, address, event);
+    }
+
+    if (store)
+        *latency = iplc_sim_store(sim, address, hit, *latency);
+    *latency += sim->write_stall;
+    sim->write_stall = 0;
+
+    if (kind == PROFILE_FETCH) {
+        sim->fetches++;
+        sim->fetch_misses += !hit;
+    }
+    else {
+        sim->data_accesses++;
+        sim->data_misses += !hit;
+    }
+    if (sim->profile != NULL)
+        iplc_profile_access(sim->profile, l1 == sim->l1i ? 0 : 1, kind, pc, address, hit,
+                            *latency - sim->latency[0]);
+
+    sim->memory_cycles += *latency;
+    IPLC_PERF_LEAVE(sim->perf);
+    return hit;
+}
+
+/*
+ * The data access of a LW or SW at pc, printed like the original.  A
+ * blocking L1D holds the instruction for the whole access.  With MSHRs a
+ * miss only holds it for an L1 hit's time, plus any wait for a free MSHR:
+ * the block arrives later, and a later miss to it while it is still on
+ * its way (already filled in the tags, so an L1 hit) merges into the same
+ * MSHR.  Returns 1 for a hit; *latency gets how long the instruction is
+ * held and *ready the cycle its data is there.
+ */
+static int iplc_sim_data_access(iplc_sim_t *sim, unsigned int pc, unsigned int address, int store,
+                                int *latency, unsigned long *ready)
+{
+    unsigned long now = sim->pipeline_cycles, pending, start = now;
+    uint32_t block = address >> sim->l1d->blockoffsetbits;
+    int hit;
+
+    hit = iplc_sim_trap_address(sim, sim->l1d, sim->prefetch_d, pc, address,
+                                store ? PROFILE_STORE : PROFILE_LOAD, latency);
+    if (sim->verbosity >= VERBOSITY_ACCESSES)
+        iplc_sim_event(sim, hit ? EVENT_DATA_HIT : EVENT_DATA_MISS, now, address, 0, 0, 0);
+
+    *ready = now + *latency;
+    if (sim->mshr == NULL)
+        return hit;
+
+    pending = iplc_mshr_lookup(sim->mshr, block, now);
+    if (pending != 0) {
+        if (pending > *ready)
+            *ready = pending;
+    }
+    else if (!hit) {
+        start = iplc_mshr_allocate(sim->mshr, block, now, *latency);
+        *ready = start + *latency;
+    }
+    *latency = sim->latency[0] + (int) (start - now);
+    return hit;
+}
+
+/*
+ * Per-level counters, L1 first.
+ */
+static void iplc_sim_level_stats(const iplc_sim_t *sim, iplc_sim_stats_t *stats)
+{
+    static const char *names[IPLC_MAX_LEVELS] = {"L1I", "L1D", "L2", "L3"};
+    const iplc_cache_t *caches[IPLC_MAX_LEVELS] = {sim->l1i, sim->l1d, sim->lower[0],
+                                                   sim->lower[1]};
+    iplc_level_stats_t *level;
+    int i;
+
+    stats->nlevels = 0;
+    for (i = 0; i < IPLC_MAX_LEVELS; i++) {
+        if (caches[i] == NULL || (i == LEVEL_L1D && sim->l1d == sim->l1i))
+            continue;
+        level = &stats->level[stats->nlevels++];
+        level->name = sim->l1d == sim->l1i && i == LEVEL_L1I ? "L1" : names[i];
+        level->access = caches[i]->access;
+        level->hit = caches[i]->hit;
+        level->miss = caches[i]->miss;
+        level->back_invalidations = sim->back_invalidations[i];
+        level->evictions = caches[i]->evictions;
+        level->writebacks = caches[i]->writebacks;
+        level->prefetch_issued = caches[i]->prefetch_issued;
+        level->prefetch_useful = caches[i]->prefetch_useful;
+        level->prefetch_late = caches[i]->prefetch_late;
+        level->compulsory = level->capacity = level->conflict = 0;
+        if (sim->profile != NULL && i <= LEVEL_L1D) {
+            long classes[NUM_MISS_CLASSES];
+            iplc_profile_classes(sim->profile, i, classes);
+            level->compulsory = classes[MISS_COMPULSORY];
+            level->capacity = classes[MISS_CAPACITY];
+            level->conflict = classes[MISS_CONFLICT];
+        }
+    }
+
+    stats->cache_access = stats->level[0].access;
+    stats->cache_miss = stats->level[0].miss;
+    stats->cache_hit = stats->level[0].hit;
+    stats->memory_reads = sim->memory_reads;
+    stats->memory_writes = sim->memory_writes;
+    stats->memory_read_bytes = sim->memory_read_bytes;
+    stats->memory_write_bytes = sim->memory_write_bytes;
+    stats->write_buffer_stalls = 0;
+    if (sim->wbuf != NULL) {
+        iplc_wbuf_stats_t ws;
+        iplc_wbuf_get_stats(sim->wbuf, &ws);
+        stats->write_buffer_stalls = ws.stall_cycles;
+    }
+    stats->mshr_misses = stats->mshr_merged = stats->mshr_full_cycles = 0;
+    stats->mshr_wait_cycles = sim->mshr_wait_cycles;
+    stats->mlp = 0.0;
+    if (sim->mshr != NULL) {
+        iplc_mshr_stats_t ms;
+        iplc_mshr_get_stats(sim->mshr, &ms);
+        stats->mshr_misses = ms.misses;
+        stats->mshr_merged = ms.merged;
+        stats->mshr_full_cycles = ms.full_cycles;
+        if (ms.busy_cycles > 0)
+            stats->mlp = (double) ms.miss_cycles / (double) ms.busy_cycles;
+    }
+    if (sim->l1d != sim->l1i) {
+        stats->cache_access += stats->level[1].access;
+        stats->cache_miss += stats->level[1].miss;
+        stats->cache_hit += stats->level[1].hit;
+    }
+}
+
+/*
+ * The counters so far.  Unlike iplc_sim_finalize() this neither drains the
+ * pipeline nor prints anything, so it can be called part way through a
+ * trace.
+ */
+void iplc_sim_get_stats(const iplc_sim_t *sim, iplc_sim_stats_t *stats)
+{
+    iplc_sim_level_stats(sim, stats);
+    stats->pipeline_cycles = sim->pipeline_cycles;
+    stats->instruction_count = sim->instruction_count;
+    stats->branch_count = sim->branch_count;
+    stats->correct_branch_predictions = sim->correct_branch_predictions;
+    memcpy(stats->hazards, sim->hazards, sizeof(stats->hazards));
+    memcpy(stats->hazard_stalls, sim->hazard_stalls, sizeof(stats->hazard_stalls));
+    if (sim->pipe != NULL) {
+        iplc_pipe_stats_t ps;
+        int p;
+        iplc_pipe_get_stats(sim->pipe, &ps);
+        stats->pipeline_cycles = ps.cycles;
+        for (p = 0; p < NUM_HAZARD_KINDS; p++) {
+            stats->hazards[p] = (long) ps.hazards[p];
+            stats->hazard_stalls[p] = (long) ps.hazard_stalls[p];
+        }
+    }
+    stats->samples = sim->samples;
+    stats->sample_cpi_error = iplc_sim_confidence(sim->samples, sim->cpi_sum, sim->cpi_sumsq,
+                                                  SAMPLE_Z, &stats->sample_cpi);
+    stats->sample_miss_rate_error = iplc_sim_confidence(sim->samples, sim->miss_sum,
+                                                        sim->miss_sumsq, SAMPLE_Z,
+                                                        &stats->sample_miss_rate);
+}
+
+/*
+ * sum += sign * s, counter by counter: adds up the shards of one trace,
+ * or takes out what warming one of them counted.  MLP and the sampling
+ * results are not sums and are left alone.
+ */
+void iplc_sim_stats_merge(iplc_sim_stats_t *sum, const iplc_sim_stats_t *s, int sign)
+{
+    iplc_level_stats_t *l;
+    const iplc_level_stats_t *m;
+    int i;
+
+    if (sum->nlevels == 0) {
+        sum->nlevels = s->nlevels;
+        for (i = 0; i < s->nlevels; i++)
+            sum->level[i].name = s->level[i].name;
+    }
+    for (i = 0; i < s->nlevels && i < sum->nlevels; i++) {
+        l = &sum->level[i];
+        m = &s->level[i];
+        l->access += sign * m->access;
+        l->hit += sign * m->hit;
+        l->miss += sign * m->miss;
+        l->back_invalidations += sign * m->back_invalidations;
+        l->evictions += sign * m->evictions;
+        l->writebacks += sign * m->writebacks;
+        l->prefetch_issued += sign * m->prefetch_issued;
+        l->prefetch_useful += sign * m->prefetch_useful;
+        l->prefetch_late += sign * m->prefetch_late;
+        l->compulsory += sign * m->compulsory;
+        l->capacity += sign * m->capacity;
+        l->conflict += sign * m->conflict;
+    }
+
+    sum->cache_access += sign * s->cache_access;
+    sum->cache_miss += sign * s->cache_miss;
+    sum->cache_hit += sign * s->cache_hit;
+    sum->memory_reads += sign * s->memory_reads;
+    sum->memory_writes += sign * s->memory_writes;
+    sum->memory_read_bytes += sign * s->memory_read_bytes;
+    sum->memory_write_bytes += sign * s->memory_write_bytes;
+    sum->write_buffer_stalls += sign * s->write_buffer_stalls;
+    sum->mshr_misses += sign * s->mshr_misses;
+    sum->mshr_merged += sign * s->mshr_merged;
+    sum->mshr_full_cycles += sign * s->mshr_full_cycles;
+    sum->mshr_wait_cycles += sign * s->mshr_wait_cycles;
+    sum->pipeline_cycles += sign * s->pipeline_cycles;
+    sum->instruction_count += sign * s->instruction_count;
+    sum->branch_count += sign * s->branch_count;
+    sum->correct_branch_predictions += sign * s->correct_branch_predictions;
+    for (i = 0; i < NUM_HAZARD_KINDS; i++) {
+        sum->hazards[i] += sign * s->hazards[i];
+        sum->hazard_stalls[i] += sign * s->hazard_stalls[i];
+    }
+}
+
+/*
+ * Finish processing all instructions in the Pipeline
+ */
+static void iplc_sim_drain_pipeline(iplc_sim_t *sim)
+{
+    while (iplc_sim_stage(sim, FETCH)->itype != NOP  ||
+           iplc_sim_stage(sim, DECODE)->itype != NOP ||
+           iplc_sim_stage(sim, ALU)->itype != NOP    ||
+           iplc_sim_stage(sim, MEM)->itype != NOP    ||
+           iplc_sim_stage(sim, WRITEBACK)->itype != NOP) {
+        iplc_sim_push_pipeline_stage(sim);
+    }
+}
+
+/*
+ * Nothing in any stage, not even a NOP instruction from the trace?
+ */
+static inline int iplc_sim_pipeline_empty(iplc_sim_t *sim)
+{
+    int i;
+
+    for (i = 0; i < MAX_STAGES; i++) {
+        if (iplc_sim_stage(sim, i)->itype != NOP || iplc_sim_stage(sim, i)->instruction_address)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Let cycles go by with nothing being fetched.  Whatever is in flight is
+ * pushed through a cycle at a time as usual, but once the pipeline is
+ * empty a push does nothing but count the cycle, so the rest of the stall
+ * is added in one step.
+ */
+static void iplc_sim_stall(iplc_sim_t *sim, int cycles)
+{
+    for (; cycles > 0 && !iplc_sim_pipeline_empty(sim); cycles--)
+        iplc_sim_push_pipeline_stage(sim);
+    sim->pipeline_cycles += cycles;
+}
+
+static const char *hazard_names[NUM_HAZARD_KINDS] = {"EX->EX", "MEM->EX", "Load-Use",
+                                                      "Branch Operand"};
+
+/*
+ * Drain the pipeline, hand back our counters and, unless we are quiet, just
+ * output our summary statistics.
+ */
+void iplc_sim_finalize(iplc_sim_t *sim, iplc_sim_stats_t *stats)
+{
+    iplc_sim_stats_t local;
+    int p;
+
+    if (sim->pipe != NULL) {
+        iplc_pipe_stats_t ps;
+        iplc_pipe_get_stats(sim->pipe, &ps);
+        sim->pipeline_cycles = ps.cycles;
+        for (p = 0; p < NUM_HAZARD_KINDS; p++) {
+            sim->hazards[p] = (long) ps.hazards[p];
+            sim->hazard_stalls[p] = (long) ps.hazard_stalls[p];
+        }
+    }
+    else {
+        iplc_sim_drain_pipeline(sim);
+    }
+
+    if (stats == NULL)
+        stats = &local;
+
+    // whatever is left over after the last full interval
+    if (sim->interval != NULL)
+        iplc_sim_interval(sim);
+
+    iplc_sim_get_stats(sim, stats);
+
+    if (sim->quiet)
+        return;
+
+    printf(" Cache Performance \n");
+    printf("\t Number of Cache Accesses is %ld \n", stats->cache_access);
+    printf("\t Number of Cache Misses is %ld \n", stats->cache_miss);
+    printf("\t Number of Cache Hits is %ld \n", stats->cache_hit);
+    printf("\t Cache Miss Rate is %f \n", (double)stats->cache_miss / (double)stats->cache_access);
+    printf("\t Replacement Policy %s Hit Rate is %f \n", sim->l1i->policy->name,
+           (double)stats->cache_hit / (double)stats->cache_access);
+    for (p = 0; p < NUM_REPL_POLICIES; p++) {
+        if (sim->shadow[p] != NULL)
+            printf("\t    (shadow) %s Hit Rate is %f \n", sim->shadow[p]->policy->name,
+                   (double)sim->shadow[p]->hit / (double)sim->shadow[p]->access);
+    }
+    printf("\n");
+    if (iplc_sim_has_hierarchy(&sim->config)) {
+        printf(" Cache Hierarchy \n");
+        for (p = 0; p < stats->nlevels; p++)
+            printf("\t %-3s Accesses %ld Misses %ld Miss Rate %f Back Invalidations %ld \n",
+                   stats->level[p].name, stats->level[p].access, stats->level[p].miss,
+                   stats->level[p].access ? (double)stats->level[p].miss / (double)stats->level[p].access : 0.0,
+                   stats->level[p].back_invalidations);
+        printf("\t Average Memory Access Time is %f cycles \n",
+               (double)sim->memory_cycles / (double)stats->cache_access);
+        printf("\n");
+    }
+    if (iplc_sim_has_write_model(&sim->config) || iplc_sim_has_hierarchy(&sim->config)) {
+        printf(" Evictions and Memory Traffic \n");
+        for (p = 0; p < stats->nlevels; p++)
+            printf("\t %-3s Evictions %ld Writebacks %ld \n", stats->level[p].name,
+                   stats->level[p].evictions, stats->level[p].writebacks);
+        printf("\t Memory Reads %ld (%ld bytes) Writes %ld (%ld bytes) \n", stats->memory_reads,
+               stats->memory_read_bytes, stats->memory_writes, stats->memory_write_bytes);
+        if (sim->wbuf != NULL) {
+            iplc_wbuf_stats_t ws;
+            iplc_wbuf_get_stats(sim->wbuf, &ws);
+            printf("\t Write Buffer Writes %ld Coalesced %ld Full %ld Stall Cycles %ld \n",
+                   ws.writes, ws.coalesced, ws.full, ws.stall_cycles);
+        }
+        printf("\n");
+    }
+    if (sim->mshr != NULL) {
+        iplc_mshr_stats_t ms;
+        iplc_mshr_get_stats(sim->mshr, &ms);
+        printf(" Non-blocking L1D \n");
+        printf("\t Primary Misses %ld Secondary (merged) %ld \n", ms.misses, ms.merged);
+        printf("\t MSHRs Full %ld times, %ld cycles \n", ms.full, ms.full_cycles);
+        printf("\t Max Outstanding %d Memory-Level Parallelism %f \n", ms.max_outstanding,
+               stats->mlp);
+        if (sim->pipe == NULL)
+            printf("\t Cycles Waiting for Outstanding Loads %ld \n", stats->mshr_wait_cycles);
+        printf("\n");
+    }
+    if (sim->prefetch_i != NULL || sim->prefetch_d != NULL) {
+        printf(" Prefetching \n");
+        for (p = 0; p < (sim->l1d != sim->l1i ? 2 : 1); p++) {
+            const iplc_level_stats_t *l = &stats->level[p];
+            if (sim->l1d != sim->l1i && (p == 0 ? sim->prefetch_i : sim->prefetch_d) == NULL)
+                continue;
+            printf("\t %-3s Issued %ld Useful %ld Late %ld \n", l->name, l->prefetch_issued,
+                   l->prefetch_useful, l->prefetch_late);
+            printf("\t     Accuracy %f Coverage %f Timeliness %f \n",
+                   l->prefetch_issued ? (double)l->prefetch_useful / (double)l->prefetch_issued : 0.0,
+                   l->prefetch_useful + l->miss ? (double)l->prefetch_useful / (double)(l->prefetch_useful + l->miss) : 0.0,
+                   l->prefetch_useful ? (double)(l->prefetch_useful - l->prefetch_late) / (double)l->prefetch_useful : 0.0);
+        }
+        printf("\n");
+    }
+    if (sim->profile != NULL) {
+        printf(" Miss Classification \n");
+        for (p = 0; p < (sim->l1d != sim->l1i ? 2 : 1); p++) {
+            const iplc_level_stats_t *l = &stats->level[p];
+            printf("\t %-3s Compulsory %ld Capacity %ld Conflict %ld \n", l->name, l->compulsory,
+                   l->capacity, l->conflict);
+        }
+        printf("\n");
+        iplc_profile_report(sim->profile, sim->config.profile);
+    }
+    printf("Pipeline Performance \n");
+    printf("\t Total Cycles is %lu \n", sim->pipeline_cycles);
+    printf("\t Total Instructions is %lu \n", sim->instruction_count);
+    printf("\t Total Branch Instructions is %lu \n", sim->branch_count);
+    printf("\t Total Correct Branch Predictions is %lu \n", sim->correct_branch_predictions);
+    printf("\t CPI is %f \n", (double)sim->pipeline_cycles / (double)sim->instruction_count);
+    printf("\t IPC is %f \n\n", (double)sim->instruction_count / (double)sim->pipeline_cycles);
+
+    if (sim->interval != NULL) {
+        printf("Intervals \n");
+        printf("\t %ld rows of %ld instructions written to %s \n\n", iplc_interval_rows(sim->interval),
+               sim->config.interval, iplc_sim_interval_file(&sim->config));
+    }
+
+    if (sim->events != NULL && sim->config.event_log != NULL) {
+        printf("Events \n");
+        printf("\t %ld events logged to %s (verbosity %s) \n\n", iplc_event_count(sim->events),
+               sim->config.event_log, iplc_verbosity_name(sim->verbosity));
+    }
+
+    if (sim->config.sample_period > 0) {
+        double cv = stats->sample_cpi > 0.0 ?
+                    stats->sample_cpi_error / SAMPLE_Z * sqrt((double) stats->samples) / stats->sample_cpi : 0.0;
+        printf("Sampled Simulation \n");
+        printf("\t Samples is %ld, %ld of %ld instructions in detail \n", stats->samples,
+               sim->instructions_fed - sim->warmed_instructions, sim->instructions_fed);
+        printf("\t CPI is %f +- %f (95%% confidence, +-%.2f%%) \n", stats->sample_cpi,
+               stats->sample_cpi_error,
+               stats->sample_cpi > 0.0 ? 100.0 * stats->sample_cpi_error / stats->sample_cpi : 0.0);
+        printf("\t L1 Miss Rate is %f +- %f (95%% confidence) \n", stats->sample_miss_rate,
+               stats->sample_miss_rate_error);
+        printf("\t Estimated Total Cycles is %.0f \n", stats->sample_cpi * (double) sim->instructions_fed);
+        printf("\t Samples for +-%.0f%% CPI at 99.7%% confidence is %.0f \n", 100.0 * SAMPLE_TARGET_ERROR,
+               ceil(pow(SAMPLE_TARGET_Z * cv / SAMPLE_TARGET_ERROR, 2.0)));
+        printf("\n");
+    }
+
+    if (sim->pipe != NULL) {
+        iplc_pipe_stats_t ps;
+        iplc_pipe_get_stats(sim->pipe, &ps);
+        printf("Pipeline Stalls \n");
+        printf("\t Operand (RAW) Stall Cycles is %lu \n", ps.raw_stalls);
+        printf("\t Memory Port Stall Cycles is %lu \n", ps.port_stalls);
+        printf("\t Data Access Stall Cycles is %lu \n", ps.memory_stalls);
+        printf("\t Fetch Stall Cycles is %lu \n", ps.fetch_stalls);
+        printf("\t Branch Redirect Cycles is %lu \n\n", ps.redirect_stalls);
+    }
+
+    if (sim->pipe != NULL || sim->config.hazards) {
+        printf("Pipeline Hazards \n");
+        for (p = 0; p < NUM_HAZARD_KINDS; p++)
+            printf("\t %-14s %s %ld Stall Cycles %ld \n", hazard_names[p],
+                   p == HAZARD_EX_EX || p == HAZARD_MEM_EX ? "Forwards" : "Hazards ",
+                   sim->hazards[p], sim->hazard_stalls[p]);
+        printf("\n");
+    }
+
+    if (sim->config.branch_predictor != BPRED_STATIC || sim->config.btb_bits > 0 ||
+        sim->config.compare_predictors) {
+        printf("Branch Prediction \n");
+        for (p = -1; p < NUM_BPRED_KINDS; p++) {
+            const iplc_bpred_t *bp = p < 0 ? sim->bpred : sim->bpred_shadow[p];
+            if (bp == NULL)
+                continue;
+            printf("\t %s%-10s Branches %ld Mispredictions %ld BTB Misses %ld MPKI %f \n",
+                   p < 0 ? "" : "(shadow) ", iplc_bpred_name(iplc_bpred_kind(bp)),
+                   iplc_bpred_branches(bp), iplc_bpred_mispredictions(bp), iplc_bpred_btb_misses(bp),
+                   1000.0 * (double)iplc_bpred_mispredictions(bp) /
+                   (double)(sim->config.sample_period > 0 ? sim->instructions_fed : sim->instruction_count));
+        }
+        printf("\n");
+    }
+
+#if defined(IPLC_PERF)
+    if (sim->perf != NULL)
+        iplc_perf_report(sim->perf, sim->config.sample_period > 0 ? sim->instructions_fed :
+                                                                     sim->instruction_count);
+#endif
+}
+
+/************************************************************************************************/
+/* Pipeline Functions ***************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Dump the current contents of our pipeline.
+ */
+static void iplc_sim_dump_pipeline(iplc_sim_t *sim) //DONE
+{
+    int i;
+
+    for (i = 0; i < MAX_STAGES; i++)
+        iplc_sim_event(sim, EVENT_STAGE, sim->pipeline_cycles, iplc_sim_stage(sim, i)->instruction_address,
+                       iplc_sim_stage(sim, i)->itype, i, i == WRITEBACK ? EVENT_LAST : 0);
+}
+
+/*
+ * Run a branch with a known outcome past the predictor, and past every
+ * predictor it is being compared with.  Returns 1 if it was predicted right.
+ */
+static int iplc_sim_resolve_branch(iplc_sim_t *sim, unsigned int pc, int taken,
+                                   unsigned int target)
+{
+    int k;
 
-pipeline_t pipeline[MAX_STAGES];
+    for (k = 0; k < NUM_BPRED_KINDS; k++) {
+        if (sim->bpred_shadow[k] != NULL)
+            iplc_bpred_resolve(sim->bpred_shadow[k], pc, taken, target);
+    }
+    return iplc_bpred_resolve(sim->bpred, pc, taken, target);
+}
 
-/************************************************************************************************/
-/* Cache Functions ******************************************************************************/
-/************************************************************************************************/
 /*
- * Correctly configure the cache.
+ * The running totals an interval row is the difference of.  The classic
+ * pipeline has no stall accounting of its own, so there a miss costs what
+ * it took past an L1 hit and a misprediction its one cycle.
  */
-void iplc_sim_init(int index, int blocksize, int assoc)
+static void iplc_sim_interval_counters(const iplc_sim_t *sim, iplc_interval_counters_t *c)
 {
-    int i=0, j=0;
-    unsigned long cache_size = 0;
-    cache_index = index;
-    cache_blocksize = blocksize;
-    cache_assoc = assoc;
+    int p;
+
+    c->instructions = sim->instruction_count;
+    c->fetches = sim->fetches;
+    c->fetch_misses = sim->fetch_misses;
+    c->data_accesses = sim->data_accesses;
+    c->data_misses = sim->data_misses;
+    c->branches = sim->branch_count;
+    c->mispredictions = (long) sim->branch_count - (long) sim->correct_branch_predictions;
+
+    if (sim->pipe != NULL) {
+        iplc_pipe_stats_t ps;
+        iplc_pipe_get_stats(sim->pipe, &ps);
+        c->cycles = ps.cycles;
+        c->memory_stalls = (long) (ps.memory_stalls + ps.fetch_stalls);
+        c->branch_stalls = (long) ps.redirect_stalls;
+        c->hazard_stalls = (long) (ps.raw_stalls + ps.port_stalls);
+        return;
+    }
 
+    c->cycles = sim->pipeline_cycles;
+    c->memory_stalls = sim->memory_cycles - (sim->fetches + sim->data_accesses) * sim->latency[0];
+    c->branch_stalls = c->mispredictions;
+    c->hazard_stalls = sim->mshr_wait_cycles;
+    for (p = 0; p < NUM_HAZARD_KINDS; p++)
+        c->hazard_stalls += sim->hazard_stalls[p];
+}
 
-    cache_blockoffsetbits =
-    (int) rint((log( (double) (blocksize * 4) )/ log(2)));
-    /* Note: rint function rounds the result up prior to casting */
+static void iplc_sim_interval(iplc_sim_t *sim)
+{
+    iplc_interval_counters_t c;
 
-    cache_size = assoc * ( 1 << index ) * ((32 * blocksize) + 33 - index - cache_blockoffsetbits);
+    IPLC_PERF_ENTER(sim->perf, PERF_OUTPUT);
+    iplc_sim_interval_counters(sim, &c);
+    sim->interval_next = iplc_interval_record(sim->interval, &c);
+    IPLC_PERF_LEAVE(sim->perf);
+}
 
-    printf("Cache Configuration \n");
-    printf("   Index: %d bits or %d lines \n", cache_index, (1<<cache_index) );
-    printf("   BlockSize: %d \n", cache_blocksize );
-    printf("   Associativity: %d \n", cache_assoc );
-    printf("   BlockOffSetBits: %d \n", cache_blockoffsetbits );
-    printf("   CacheSize: %lu \n", cache_size );
+/*
+ * Called wherever instructions retire: one compare unless an interval
+ * just ended.
+ */
+static inline void iplc_sim_interval_check(iplc_sim_t *sim)
+{
+    if (sim->interval != NULL && sim->instruction_count >= sim->interval_next)
+        iplc_sim_interval(sim);
+}
 
-    if (cache_size > MAX_CACHE_SIZE ) {
-        printf("Cache too big. Great than MAX SIZE of %d .... \n", MAX_CACHE_SIZE);
-        exit(-1);
+/*
+ * Count the instruction in WRITEBACK as retired.
+ */
+static void iplc_sim_retire(iplc_sim_t *sim)
+{
+    if (iplc_sim_stage(sim, WRITEBACK)->instruction_address) {
+        sim->instruction_count++;
+        if (sim->verbosity >= VERBOSITY_DEBUG)
+            iplc_sim_event(sim, EVENT_RETIRE, sim->pipeline_cycles,
+                           iplc_sim_stage(sim, WRITEBACK)->instruction_address,
+                           iplc_sim_stage(sim, WRITEBACK)->itype, 0, 0);
     }
+}
 
-    cache = (cache_line_t *) malloc((sizeof(cache_line_t) * 1<<index));
+/*
+ * Do the data access of a LW or SW in MEM, adding all but one cycle of its
+ * latency (the cycle the stage takes anyway is added by the caller).
+ * Returns the latency, 1 if there was no access.
+ */
+static int iplc_sim_mem_access(iplc_sim_t *sim)
+{
+    pipeline_t *mem = iplc_sim_stage(sim, MEM);
+    unsigned int address;
+    unsigned long ready;
+    int latency = 1;
+    int dest;
+
+    if (mem->itype != LW && mem->itype != SW)
+        return 1;
+
+    address = mem->itype == LW ? mem->stage.lw.data_address : mem->stage.sw.data_address;
+    iplc_sim_data_access(sim, mem->instruction_address, address, mem->itype == SW,
+                         &latency, &ready);
+
+    // a load that went on without its data leaves its register outstanding
+    dest = mem->itype == LW ? mem->stage.lw.dest_reg : -1;
+    if (dest > 0 && dest < 32)
+        sim->reg_ready[dest] = ready > sim->pipeline_cycles + latency ? ready : 0;
+
+    sim->pipeline_cycles += latency - 1;
+    return latency;
+}
 
-    // Dynamically create our cache based on the information the user entered
-    for (; i < (1<<index); i++) {
-      cache[i].replacements = (unsigned int*) malloc(sizeof(unsigned int) * assoc);
-      cache[i].sets = (set_t*) malloc(sizeof(set_t) * assoc);
-      for (; j < assoc; j++) {
-        cache[i].sets[j].valid = 0;
-        cache[i].sets[j].tag = 0;
-        cache[i].replacements[j] = j;
-      }
+/*
+ * The register an instruction writes, or -1.  A LW's value comes at the end
+ * of MEM; everything else has its result at the end of ALU.
+ */
+static int iplc_sim_dest_reg(const pipeline_t *p)
+{
+    switch (p->itype) {
+        case RTYPE:
+            return p->stage.rtype.dest_reg;
+        case LW:
+            return p->stage.lw.dest_reg;
+        case JUMP:
+        case JAL:
+            return p->stage.jump.dest_reg;
+        default:
+            return -1;
     }
+}
 
-    // init the pipeline -- set all data to zero and instructions to NOP
-    for (i = 0; i < MAX_STAGES; i++) {
-        // itype is set to O which is NOP type instruction
-        bzero(&(pipeline[i]), sizeof(pipeline_t));
-    }
+static inline int iplc_sim_writes(const pipeline_t *p, int reg)
+{
+    return reg > 0 && iplc_sim_dest_reg(p) == reg;
 }
 
 /*
- * iplc_sim_trap_address() determined this is not in our cache.  Put it there
- * and make sure that is now our Most Recently Used (MRU) entry.
+ * The registers an instruction reads, and the stage it reads them in:
+ * ALU for RTYPE operands and LW/SW base registers, DECODE for branch and
+ * JR operands, since that is where branches resolve.  The register a SW
+ * stores is only needed in MEM, by when it can always be forwarded, so it
+ * never holds anything up.  Returns -1 if nothing is read.
  */
-void iplc_sim_LRU_replace_on_miss(int index, int tag)
+static int iplc_sim_src_regs(const pipeline_t *p, int src[2])
 {
-    int i=0;
-
-    // Iterate through items to shift them forward.
-    for (; i < cache_assoc - 1; i++) {
-      cache[index].sets[i] = cache[index].sets[i+1];
-      cache[index].replacements[i] = cache[index].replacements[i+1];
+    src[0] = src[1] = -1;
+
+    switch (p->itype) {
+        case RTYPE:
+            src[0] = p->stage.rtype.reg1;
+            if (!p->stage.rtype.immediate)
+                src[1] = p->stage.rtype.reg2_or_constant;
+            return ALU;
+        case LW:
+            src[0] = p->stage.lw.base_reg;
+            return ALU;
+        case SW:
+            src[0] = p->stage.sw.base_reg;
+            return ALU;
+        case BRANCH:
+            src[0] = p->stage.branch.reg1;
+            src[1] = p->stage.branch.reg2;
+            return DECODE;
+        case JUMP:
+        case JAL:
+            src[0] = p->stage.jump.reg;
+            return src[0] >= 0 ? DECODE : -1;
+        default:
+            return -1;
     }
-
-    // Replace MRU entry
-    cache[index].sets[cache_assoc-1].valid = 1;
-    cache[index].sets[cache_assoc-1].tag = tag;
-    cache[index].replacements[cache_assoc-1] = 0;
 }
 
 /*
- * iplc_sim_trap_address() determined the entry is in our cache.  Update its
- * information in the cache.
+ * The instruction in ALU is executing: count which of its operands come
+ * off a forwarding path rather than the register file.
  */
-void iplc_sim_LRU_update_on_hit(int index, int assoc_entry)
+static void iplc_sim_count_forwards(iplc_sim_t *sim)
 {
-    int i=0, j=0;
+    int src[2], i;
 
-    // Iterate through items to shift them backwards.
-    for (i = assoc_entry; i > 0; i--) {
-        cache[index].replacements[i] = cache[index].replacements[i-1];
-    }
+    if (iplc_sim_src_regs(iplc_sim_stage(sim, ALU), src) != ALU)
+        return;
 
-    // LRU is replaced with entry in cache
-    cache[index].replacements[0] = cache[index].replacements[assoc_entry];
+    for (i = 0; i < 2; i++) {
+        if (iplc_sim_writes(iplc_sim_stage(sim, MEM), src[i]))
+            sim->hazards[HAZARD_EX_EX]++;
+        else if (iplc_sim_writes(iplc_sim_stage(sim, WRITEBACK), src[i]))
+            sim->hazards[HAZARD_MEM_EX]++;
+    }
 }
 
 /*
- * Check if the address is in our cache.  Update our counter statistics
- * for cache_access, cache_hit, etc.  If our configuration supports
- * associativity we may need to check through multiple entries for our
- * desired index.  In that case we will also need to call the LRU functions.
- */
-int iplc_sim_trap_address(unsigned int address)
-{
-    int i=0, index=0;
-    int tag=0;
-    int hit=0;
-
-    // Index prepared using mask, tag is collected using combination of index and BOB
-    cache_access++;
-    index = address >> cache_blockoffsetbits & ((1 << cache_index) - 1);
-    tag = address >> (cache_index + cache_blockoffsetbits);
-
-    for (; i < cache_assoc; i++) {
-      if (cache[index].sets[i].tag == tag) {
-        hit = 1; // hit, use prepared method
-        iplc_sim_LRU_update_on_hit(index, i);
-        cache_hit++;
-        return hit;
-      }
+ * Which stage has to wait this cycle for a register, if any: ALU when it
+ * needs a LW that is still in MEM, DECODE when a branch needs a result
+ * that cannot be forwarded to it yet (anything still in ALU, or a LW in
+ * MEM).  Returns -1 if nothing waits.
+ */
+static int iplc_sim_hazard(iplc_sim_t *sim)
+{
+    pipeline_t *alu = iplc_sim_stage(sim, ALU);
+    pipeline_t *mem = iplc_sim_stage(sim, MEM);
+    int src[2], i;
+
+    if (iplc_sim_src_regs(alu, src) == ALU && mem->itype == LW) {
+        for (i = 0; i < 2; i++) {
+            if (iplc_sim_writes(mem, src[i]))
+                return ALU;
+        }
     }
 
-    // miss, use prepared method
-    iplc_sim_LRU_replace_on_miss(index, tag);
-    cache_miss++;
-
-    /* expects you to return 1 for hit, 0 for miss */
-    return hit;
+    if (iplc_sim_src_regs(iplc_sim_stage(sim, DECODE), src) == DECODE) {
+        for (i = 0; i < 2; i++) {
+            if (iplc_sim_writes(alu, src[i]) || (mem->itype == LW && iplc_sim_writes(mem, src[i])))
+                return DECODE;
+        }
+    }
+    return -1;
 }
 
 /*
- * Just output our summary statistics.
+ * Non-blocking L1D: everything waits until the registers the instructions
+ * in DECODE, ALU and MEM are about to read have arrived, a SW's data
+ * included.  The instruction in skip is not checked; the hazard model
+ * holds it for a cycle anyway.  What the one in MEM writes is no longer
+ * outstanding, unless it is the load that just went out.
  */
-void iplc_sim_finalize()
+static void iplc_sim_wait_operands(iplc_sim_t *sim, int skip)
 {
-    /* Finish processing all instructions in the Pipeline */
-    while (pipeline[FETCH].itype != NOP  ||
-           pipeline[DECODE].itype != NOP ||
-           pipeline[ALU].itype != NOP    ||
-           pipeline[MEM].itype != NOP    ||
-           pipeline[WRITEBACK].itype != NOP) {
-        iplc_sim_push_pipeline_stage();
+    pipeline_t *mem = iplc_sim_stage(sim, MEM);
+    unsigned long need = 0;
+    int src[2], i, s, dest;
+
+    if (mem->itype != LW) {
+        dest = iplc_sim_dest_reg(mem);
+        if (dest > 0 && dest < 32)
+            sim->reg_ready[dest] = 0;
     }
 
-    printf(" Cache Performance \n");
-    printf("\t Number of Cache Accesses is %ld \n", cache_access);
-    printf("\t Number of Cache Misses is %ld \n", cache_miss);
-    printf("\t Number of Cache Hits is %ld \n", cache_hit);
-    printf("\t Cache Miss Rate is %f \n\n", (double)cache_miss / (double)cache_access);
-    printf("Pipeline Performance \n");
-    printf("\t Total Cycles is %u \n", pipeline_cycles);
-    printf("\t Total Instructions is %u \n", instruction_count);
-    printf("\t Total Branch Instructions is %u \n", branch_count);
-    printf("\t Total Correct Branch Predictions is %u \n", correct_branch_predictions);
-    printf("\t CPI is %f \n\n", (double)pipeline_cycles / (double)instruction_count);
-}
+    for (s = DECODE; s <= MEM; s++) {
+        if (s == skip)
+            continue;
+        if (s == MEM) {
+            if (mem->itype != SW)
+                continue;
+            src[0] = mem->stage.sw.src_reg;
+            src[1] = -1;
+        }
+        else if (iplc_sim_src_regs(iplc_sim_stage(sim, s), src) != s) {
+            continue;
+        }
+        for (i = 0; i < 2; i++) {
+            if (src[i] > 0 && src[i] < 32 && sim->reg_ready[src[i]] > need)
+                need = sim->reg_ready[src[i]];
+        }
+    }
 
-/************************************************************************************************/
-/* Pipeline Functions ***************************************************************************/
-/************************************************************************************************/
+    if (need > sim->pipeline_cycles) {
+        sim->mshr_wait_cycles += need - sim->pipeline_cycles;
+        sim->pipeline_cycles = need;
+    }
+}
 
 /*
- * Dump the current contents of our pipeline.
+ * One cycle of the full hazard model (config.hazards).  Stages from the one
+ * that waits forward are held, and a NOP goes in behind the stages that
+ * still move on.  A branch resolves the cycle it leaves DECODE, and a
+ * misprediction holds FETCH for a cycle the same way.  Returns 1 if the
+ * cycle was a stall and FETCH is still busy, 0 once everything moved on.
  */
-void iplc_sim_dump_pipeline() //DONE
+static int iplc_sim_hazard_cycle(iplc_sim_t *sim)
 {
-    int i;
-
-    for (i = 0; i < MAX_STAGES; i++) {
-        switch(i) {
-            case FETCH:
-                printf("(cyc: %u) FETCH:\t %d: 0x%x \t", pipeline_cycles, pipeline[i].itype, pipeline[i].instruction_address);
-                break;
-            case DECODE:
-                printf("DECODE:\t %d: 0x%x \t", pipeline[i].itype, pipeline[i].instruction_address);
-                break;
-            case ALU:
-                printf("ALU:\t %d: 0x%x \t", pipeline[i].itype, pipeline[i].instruction_address);
-                break;
-            case MEM:
-                printf("MEM:\t %d: 0x%x \t", pipeline[i].itype, pipeline[i].instruction_address);
-                break;
-            case WRITEBACK:
-                printf("WB:\t %d: 0x%x \n", pipeline[i].itype, pipeline[i].instruction_address);
-                break;
-            default:
-                printf("DUMP: Bad stage!\n" );
-                exit(-1);
+    int wait, bubble, s, taken, correct;
+    pipeline_t *fetch = iplc_sim_stage(sim, FETCH);
+    pipeline_t *decode = iplc_sim_stage(sim, DECODE);
+
+    iplc_sim_retire(sim);
+    iplc_sim_mem_access(sim);
+
+    wait = iplc_sim_hazard(sim);
+    bubble = wait + 1;
+    if (sim->mshr != NULL)
+        iplc_sim_wait_operands(sim, wait);
+    sim->pipeline_cycles++;
+
+    if (wait == ALU) {
+        sim->hazards[HAZARD_LOAD_USE]++;
+        sim->hazard_stalls[HAZARD_LOAD_USE]++;
+    }
+    else if (wait == DECODE) {
+        if (!sim->branch_waiting)
+            sim->hazards[HAZARD_BRANCH_OPERAND]++;
+        sim->hazard_stalls[HAZARD_BRANCH_OPERAND]++;
+        sim->branch_waiting = 1;
+    }
+    else {
+        sim->branch_waiting = 0;
+        bubble = FETCH;
+        if (decode->itype == BRANCH) {
+            sim->branch_count++;
+            if (fetch->instruction_address) {
+                taken = fetch->instruction_address - decode->instruction_address != 4;
+                correct = iplc_sim_resolve_branch(sim, decode->instruction_address, taken,
+                                                  fetch->instruction_address);
+                if (correct)
+                    sim->correct_branch_predictions++;
+                else
+                    bubble = DECODE;
+            }
         }
     }
+
+    if (bubble <= ALU)
+        iplc_sim_count_forwards(sim);
+
+    for (s = WRITEBACK; s > bubble; s--)
+        *iplc_sim_stage(sim, s) = *iplc_sim_stage(sim, s - 1);
+    bzero(iplc_sim_stage(sim, bubble), sizeof(pipeline_t));
+
+    return bubble != FETCH;
 }
 
 /*
  * Check if various stages of our pipeline require stalls, forwarding, etc.
  * Then push the contents of our various pipeline stages through the pipeline.
  */
-void iplc_sim_push_pipeline_stage() //TYLER
+static void iplc_sim_push_pipeline_stage(iplc_sim_t *sim) //TYLER
 {
     int i;
-    int data_hit=1;
+    int latency=1;
 
-    /* 1. Count WRITEBACK stage is "retired" -- This I'm giving you */
-    if (pipeline[WRITEBACK].instruction_address) {
-        instruction_count++;
-        if (debug)
-            printf("DEBUG: Retired Instruction at 0x%x, Type %d, at Time %u \n",
-                   pipeline[WRITEBACK].instruction_address, pipeline[WRITEBACK].itype, pipeline_cycles);
+    IPLC_PERF_ENTER(sim->perf, PERF_PIPELINE);
+
+    if (sim->config.hazards) {
+        while (iplc_sim_hazard_cycle(sim))
+            ;
+        IPLC_PERF_LEAVE(sim->perf);
+        iplc_sim_interval_check(sim);
+        return;
     }
 
+    /* 1. Count WRITEBACK stage is "retired" -- This I'm giving you */
+    iplc_sim_retire(sim);
+
     /* 2. Check for BRANCH and correct/incorrect Branch Prediction */
-    if (pipeline[DECODE].itype == BRANCH)
+    if (iplc_sim_stage(sim, DECODE)->itype == BRANCH)
     {
-    	branch_count++; //hey, I found a branch!
+    	sim->branch_count++; //hey, I found a branch!
         int branch_taken = 0;
-        if(pipeline[FETCH].instruction_address!=0 && (pipeline[FETCH].instruction_address -pipeline[DECODE].instruction_address != 4))
+        if(iplc_sim_stage(sim, FETCH)->instruction_address!=0 && (iplc_sim_stage(sim, FETCH)->instruction_address -iplc_sim_stage(sim, DECODE)->instruction_address != 4))
         {
         	branch_taken = 1;
         }
+        int branch_correct = 1;
+        //ask the predictor (and any it is being compared with) what it would have done
+        if (iplc_sim_stage(sim, FETCH)->instruction_address != 0)
+        {
+        	branch_correct = iplc_sim_resolve_branch(sim, iplc_sim_stage(sim, DECODE)->instruction_address,
+        	                                         branch_taken, iplc_sim_stage(sim, FETCH)->instruction_address);
+        }
         //if the branch is not correctly predicted, add one cycle, push stages through (except for decode), and insert a nop
-		if (pipeline[FETCH].instruction_address != 0 && branch_taken != branch_predict_taken)
+		if (iplc_sim_stage(sim, FETCH)->instruction_address != 0 && !branch_correct)
 		{
-			pipeline_cycles++;
+			sim->pipeline_cycles++;
 
-			memcpy(&pipeline[WRITEBACK], &pipeline[MEM], sizeof(pipeline_t)); //MEM->WB
-			memcpy(&pipeline[MEM], &pipeline[ALU], sizeof(pipeline_t));	//ALU->MEM
-			memcpy(&pipeline[ALU], &pipeline[DECODE], sizeof(pipeline_t));//DECODE->ALU
+			//rotate everything one stage on (MEM->WB, ALU->MEM, DECODE->ALU, FETCH->DECODE),
+			//then put FETCH back where it was
+			sim->pipeline_head--;
+			*iplc_sim_stage(sim, FETCH) = *iplc_sim_stage(sim, DECODE);
 
-			if (pipeline[WRITEBACK].instruction_address)
+			if (iplc_sim_stage(sim, WRITEBACK)->instruction_address)
 			{
-				instruction_count++;
+				sim->instruction_count++;
 			}
 
-			bzero(&(pipeline[DECODE]), sizeof(pipeline_t)); //this is where the NOP goes
+			bzero(iplc_sim_stage(sim, DECODE), sizeof(pipeline_t)); //this is where the NOP goes
 		}
 		//if the instruction address exists and is all dandy, then you correctly predicted a branch. Congrats!
-		else if (pipeline[FETCH].instruction_address != 0)
+		else if (iplc_sim_stage(sim, FETCH)->instruction_address != 0)
 		{
-			correct_branch_predictions++;
+			sim->correct_branch_predictions++;
 		}
     }
 
@@ -378,183 +1805,164 @@ void iplc_sim_push_pipeline_stage() //TYLER
     /* 3. Check for LW delays due to use in ALU stage and if data hit/miss
      *    add delay cycles if needed.
      */
-    if (pipeline[MEM].itype == LW)
+    if (iplc_sim_stage(sim, MEM)->itype == LW)
     {
         int inserted_nop = 0;
 
-		//is the data in the cache?
-		data_hit = iplc_sim_trap_address(pipeline[MEM].stage.lw.data_address);
-
-		if (data_hit)
-		{
-			//if the data is in the cache, it's a hit. Print that.
-			printf("DATA HIT:\t Address 0x%x \n", pipeline[MEM].stage.lw.data_address);
-		}
-		else
-		{
-			//if not, it's a miss. Print that.
-			printf("DATA MISS:\t Address 0x%x \n", pipeline[MEM].stage.lw.data_address);
-
-			//cache missing has a delay, so we add almost all of those cycles here (one is still added in Step 5)
-			pipeline_cycles += CACHE_MISS_DELAY - 1;
-		}
+		//is the data in the cache? (prints the hit or miss and adds almost all of a miss's
+		//delay -- one cycle is still added in Step 5)
+		latency = iplc_sim_mem_access(sim);
 
 		//check if the ALU stage is an r-type instruction
 		//this could cause some memory conflicts
-		if (pipeline[ALU].itype == RTYPE)
+		if (iplc_sim_stage(sim, ALU)->itype == RTYPE)
 		{
 			//if so, we need to check more
-			int instructionLength = strlen(pipeline[ALU].stage.rtype.instruction);
 			// Is either reg in the ALU stage being used in the MEM stage?
-			if ((pipeline[ALU].stage.rtype.reg1 == pipeline[MEM].stage.lw.dest_reg) || ((pipeline[ALU].stage.rtype.reg2_or_constant == pipeline[MEM].stage.lw.dest_reg) && pipeline[ALU].stage.rtype.instruction[instructionLength - 1] != 'i'))
+			if ((iplc_sim_stage(sim, ALU)->stage.rtype.reg1 == iplc_sim_stage(sim, MEM)->stage.lw.dest_reg) || ((iplc_sim_stage(sim, ALU)->stage.rtype.reg2_or_constant == iplc_sim_stage(sim, MEM)->stage.lw.dest_reg) && !iplc_sim_stage(sim, ALU)->stage.rtype.immediate))
 			{
-				pipeline_cycles++; //tentatively add the cycle
+				sim->pipeline_cycles++; //tentatively add the cycle
 
 				//Moving the stuff from MEM into WB, to make room
-				memcpy(&pipeline[WRITEBACK], &pipeline[MEM], sizeof(pipeline_t));
+				*iplc_sim_stage(sim, WRITEBACK) = *iplc_sim_stage(sim, MEM);
 
 				//adding the NOP here
-				bzero(&(pipeline[MEM]), sizeof(pipeline_t));
+				bzero(iplc_sim_stage(sim, MEM), sizeof(pipeline_t));
 				inserted_nop = 1;
 
-				if (pipeline[WRITEBACK].instruction_address)
+				if (iplc_sim_stage(sim, WRITEBACK)->instruction_address)
 				{
-					instruction_count++;
+					sim->instruction_count++;
 				}
 			}
 		}
-		if (!data_hit && inserted_nop)
+		if (latency > 1 && inserted_nop)
 		{
-			pipeline_cycles--; //we didn't actually take that cycle, so...
+			sim->pipeline_cycles--; //we didn't actually take that cycle, so...
 		}
     }
 
 
     /* 4. Check for SW mem access and data miss and add delay cycles if needed */
-    if (pipeline[MEM].itype == SW)
+    if (iplc_sim_stage(sim, MEM)->itype == SW)
     {
-        //Similar to step 3, is the data in the cache?
-        data_hit = iplc_sim_trap_address(pipeline[MEM].stage.sw.data_address);
-
-        if(data_hit)
-        {
-        	printf("DATA HIT:\t Address 0x%x \n",pipeline[MEM].stage.sw.data_address);
-        }
-        else
-        {
-        	//if we miss, print it
-        	printf("DATA MISS:\t Address 0x%x \n",pipeline[MEM].stage.sw.data_address);
-
-        	//and we need to add almost all of the miss delay, except for the one cycle in Step 5 below.
-            pipeline_cycles += CACHE_MISS_DELAY - 1;
-
-        }
+        //Similar to step 3, is the data in the cache?  Almost all of the miss delay is added
+        //there, except for the one cycle in Step 5 below.
+        iplc_sim_mem_access(sim);
     }
 
+    // with MSHRs, a miss only holds up what reads its register
+    if (sim->mshr != NULL)
+        iplc_sim_wait_operands(sim, -1);
+
 
     /* 5. Increment pipe_cycles 1 cycle for normal processing */
-    pipeline_cycles++;
+    sim->pipeline_cycles++;
 
 
     /* 6. push stages thru MEM->WB, ALU->MEM, DECODE->ALU, FETCH->DECODE */
 
     //let me re-write that as: FETCH->DECODE->ALU->MEM->WB
-    //working backwards is the best way to avoid losing data
+    //the stages are a ring, so moving the head back one slot moves every stage on at once
+    //and the old WB slot comes round as the new FETCH
 
-    memcpy(&pipeline[WRITEBACK], &pipeline[MEM], sizeof(pipeline_t)); 	//MEM->WB
-    memcpy(&pipeline[MEM], &pipeline[ALU], sizeof(pipeline_t));			//ALU->MEM
-    memcpy(&pipeline[ALU], &pipeline[DECODE], sizeof(pipeline_t));		//DECODE->ALU
-    memcpy(&pipeline[DECODE], &pipeline[FETCH], sizeof(pipeline_t));	//FETCH->DECODE
+    sim->pipeline_head--;
 
     //...and there's nothing prior to FETCH to put in, so we move on to step 7
 
 
     // 7. This is a give'me -- Reset the FETCH stage to NOP via bezero */
-    bzero(&(pipeline[FETCH]), sizeof(pipeline_t));
+    bzero(iplc_sim_stage(sim, FETCH), sizeof(pipeline_t));
+
+    IPLC_PERF_LEAVE(sim->perf);
+    iplc_sim_interval_check(sim);
 }
 
 /*
  * This function is fully implemented.  You should use this as a reference
  * for implementing the remaining instruction types.
  */
-void iplc_sim_process_pipeline_rtype(char *instruction, int dest_reg, int reg1, int reg2_or_constant) //DONE
+static void iplc_sim_process_pipeline_rtype(iplc_sim_t *sim, int opcode, int immediate, int dest_reg, int reg1, int reg2_or_constant) //DONE
 {
     /* This is an example of what you need to do for the rest */ //Hi yes I'm writing in here to template stuff for myself
-    iplc_sim_push_pipeline_stage(); //Step 1: push stage
+    iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-    pipeline[FETCH].itype = RTYPE; //Step 2: set itype and instruction_address. This is the same among ALL instructions
-    pipeline[FETCH].instruction_address = instruction_address;
+    iplc_sim_stage(sim, FETCH)->itype = RTYPE; //Step 2: set itype and instruction_address. This is the same among ALL instructions
+    iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
 
-    strcpy(pipeline[FETCH].stage.rtype.instruction, instruction); //Step 3: set instruction-specific variables. These are different between.
-    pipeline[FETCH].stage.rtype.reg1 = reg1;
-    pipeline[FETCH].stage.rtype.reg2_or_constant = reg2_or_constant;
-    pipeline[FETCH].stage.rtype.dest_reg = dest_reg;
+    iplc_sim_stage(sim, FETCH)->stage.rtype.opcode = opcode; //Step 3: set instruction-specific variables. These are different between.
+    iplc_sim_stage(sim, FETCH)->stage.rtype.immediate = immediate;
+    iplc_sim_stage(sim, FETCH)->stage.rtype.reg1 = reg1;
+    iplc_sim_stage(sim, FETCH)->stage.rtype.reg2_or_constant = reg2_or_constant;
+    iplc_sim_stage(sim, FETCH)->stage.rtype.dest_reg = dest_reg;
 }
 
-void iplc_sim_process_pipeline_lw(int dest_reg, int base_reg, unsigned int data_address) //TYLER
+static void iplc_sim_process_pipeline_lw(iplc_sim_t *sim, int dest_reg, int base_reg, unsigned int data_address) //TYLER
 {
-	iplc_sim_push_pipeline_stage(); //Step 1: push stage
+	iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-	pipeline[FETCH].itype = LW;		//Step 2: set itype and address
-	pipeline[FETCH].instruction_address = instruction_address;
+	iplc_sim_stage(sim, FETCH)->itype = LW;		//Step 2: set itype and address
+	iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
 
-	pipeline[FETCH].stage.lw.base_reg = base_reg; //step 3: Copy specific variables/arguments
-	pipeline[FETCH].stage.lw.dest_reg = dest_reg;
-	pipeline[FETCH].stage.lw.data_address = data_address;
+	iplc_sim_stage(sim, FETCH)->stage.lw.base_reg = base_reg; //step 3: Copy specific variables/arguments
+	iplc_sim_stage(sim, FETCH)->stage.lw.dest_reg = dest_reg;
+	iplc_sim_stage(sim, FETCH)->stage.lw.data_address = data_address;
     /* You must implement this function */
 }
 
-void iplc_sim_process_pipeline_sw(int src_reg, int base_reg, unsigned int data_address) //TYLER
+static void iplc_sim_process_pipeline_sw(iplc_sim_t *sim, int src_reg, int base_reg, unsigned int data_address) //TYLER
 {
-	iplc_sim_push_pipeline_stage(); //Step 1: push stage
+	iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-	pipeline[FETCH].itype = SW;		//Step 2: set itype and address
-	pipeline[FETCH].instruction_address = instruction_address;
+	iplc_sim_stage(sim, FETCH)->itype = SW;		//Step 2: set itype and address
+	iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
 
-	pipeline[FETCH].stage.sw.base_reg = base_reg; //step 3: Copy specific variables/arguments
-	pipeline[FETCH].stage.sw.src_reg = src_reg;
-	pipeline[FETCH].stage.sw.data_address = data_address;
+	iplc_sim_stage(sim, FETCH)->stage.sw.base_reg = base_reg; //step 3: Copy specific variables/arguments
+	iplc_sim_stage(sim, FETCH)->stage.sw.src_reg = src_reg;
+	iplc_sim_stage(sim, FETCH)->stage.sw.data_address = data_address;
     /* You must implement this function */
 }
 
-void iplc_sim_process_pipeline_branch(int reg1, int reg2) //TYLER
+static void iplc_sim_process_pipeline_branch(iplc_sim_t *sim, int reg1, int reg2) //TYLER
 {
-	iplc_sim_push_pipeline_stage(); //Step 1: push stage
+	iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-	pipeline[FETCH].itype = BRANCH;		//Step 2: set itype and address
-	pipeline[FETCH].instruction_address = instruction_address;
+	iplc_sim_stage(sim, FETCH)->itype = BRANCH;		//Step 2: set itype and address
+	iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
 
-	pipeline[FETCH].stage.branch.reg1 = reg1; //step 3: Copy specific variables/arguments
-	pipeline[FETCH].stage.branch.reg2 = reg2;
+	iplc_sim_stage(sim, FETCH)->stage.branch.reg1 = reg1; //step 3: Copy specific variables/arguments
+	iplc_sim_stage(sim, FETCH)->stage.branch.reg2 = reg2;
     /* You must implement this function */
 }
 
-void iplc_sim_process_pipeline_jump(char *instruction) //TYLER
+static void iplc_sim_process_pipeline_jump(iplc_sim_t *sim, int opcode, int reg, int dest_reg) //TYLER
 {
-	iplc_sim_push_pipeline_stage(); //Step 1: push stage
+	iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-	pipeline[FETCH].itype = JUMP;		//Step 2: set itype and address
-	pipeline[FETCH].instruction_address = instruction_address;
+	iplc_sim_stage(sim, FETCH)->itype = JUMP;		//Step 2: set itype and address
+	iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
 
-	strcpy(pipeline[FETCH].stage.jump.instruction, instruction); //step 3: Copy specific variables/arguments
+	iplc_sim_stage(sim, FETCH)->stage.jump.opcode = opcode; //step 3: Copy specific variables/arguments
+	iplc_sim_stage(sim, FETCH)->stage.jump.reg = reg;
+	iplc_sim_stage(sim, FETCH)->stage.jump.dest_reg = dest_reg;
     /* You must implement this function */
 }
 
-void iplc_sim_process_pipeline_syscall() //TYLER
+static void iplc_sim_process_pipeline_syscall(iplc_sim_t *sim) //TYLER
 {
-	iplc_sim_push_pipeline_stage(); //Step 1: push stage
+	iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-	pipeline[FETCH].itype = SYSCALL;//Step 2: set itype and address
-	pipeline[FETCH].instruction_address = instruction_address;
+	iplc_sim_stage(sim, FETCH)->itype = SYSCALL;//Step 2: set itype and address
+	iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
     /* You must implement this function */
 }
 
-void iplc_sim_process_pipeline_nop() //TYLER
+static void iplc_sim_process_pipeline_nop(iplc_sim_t *sim) //TYLER
 {
-	iplc_sim_push_pipeline_stage(); //Step 1: push stage
+	iplc_sim_push_pipeline_stage(sim); //Step 1: push stage
 
-	pipeline[FETCH].itype = NOP;	//Step 2: set itype and address
-	pipeline[FETCH].instruction_address = instruction_address;
+	iplc_sim_stage(sim, FETCH)->itype = NOP;	//Step 2: set itype and address
+	iplc_sim_stage(sim, FETCH)->instruction_address = sim->instruction_address;
     /* You must implement this function */
 }
 
@@ -562,10 +1970,111 @@ void iplc_sim_process_pipeline_nop() //TYLER
 /* parse Function *******************************************************************************/
 /************************************************************************************************/
 
+/*
+ * How an instruction's operands are written in the trace, which says what
+ * each register does:
+ *
+ *   FMT_RRR     rd, rs, rt              writes rd, reads rs and rt
+ *   FMT_RRI     rd, rs, imm             writes rd, reads rs
+ *   FMT_RI      rd, imm                 writes rd
+ *   FMT_MEM     rt, off(rs): address    LW writes rt, SW reads it; both read rs
+ *   FMT_BRANCH  rs, rt, offset          reads rs and rt
+ *   FMT_JUMP    target                  JAL writes $31
+ *   FMT_JR      [rd,] rs                reads rs; JALR writes rd ($31 if not given)
+ *   FMT_NONE
+ */
+enum operand_format {FMT_RRR, FMT_RRI, FMT_RI, FMT_MEM, FMT_BRANCH, FMT_JUMP, FMT_JR, FMT_NONE};
+
+/*
+ * Mnemonics indexed by enum opcode_id, with their instruction type, operand
+ * format and the fewest operands a line must have.
+ */
+typedef struct opcode_info
+{
+    const char *name;
+    uint8_t itype;              // enum instruction_type
+    uint8_t format;             // enum operand_format
+    uint8_t operands;
+
+} opcode_info_t;
+
+static const opcode_info_t opcode_table[NUM_OPCODES] = {
+    {"add",     RTYPE,   FMT_RRR,    3},
+    {"addi",    RTYPE,   FMT_RRI,    3},
+    {"addiu",   RTYPE,   FMT_RRI,    3},
+    {"addu",    RTYPE,   FMT_RRR,    3},
+    {"sll",     RTYPE,   FMT_RRI,    3},
+    {"sllv",    RTYPE,   FMT_RRR,    3},
+    {"ori",     RTYPE,   FMT_RRI,    3},
+    {"lui",     RTYPE,   FMT_RI,     2},
+    {"lw",      LW,      FMT_MEM,    3},
+    {"sw",      SW,      FMT_MEM,    3},
+    {"beq",     BRANCH,  FMT_BRANCH, 2},
+    {"j",       JUMP,    FMT_JUMP,   0},
+    {"jal",     JUMP,    FMT_JUMP,   0},
+    {"jalr",    JUMP,    FMT_JR,     1},
+    {"jr",      JUMP,    FMT_JR,     1},
+    {"syscall", SYSCALL, FMT_NONE,   0},
+    {"nop",     NOP,     FMT_NONE,   0}
+};
+
+/*
+ * A perfect hash of the mnemonics above: their length, first and last
+ * characters put every one of them in a different slot of 32, so a lookup
+ * is one hash and one strcmp.  Adding a mnemonic means finding new
+ * multipliers that still keep them all apart.
+ */
+#define OPCODE_HASH_SIZE 32
+#define OPCODE_HASH(name, len) \
+    ((3 * (unsigned) (len) + 30 * (unsigned char) (name)[0] + \
+      (unsigned char) (name)[(len) - 1]) & (OPCODE_HASH_SIZE - 1))
+#define OP_NONE NUM_OPCODES
+
+static const uint8_t opcode_hash[OPCODE_HASH_SIZE] = {
+    OP_NONE, OP_JAL,  OP_ADDIU, OP_NONE,    OP_JR,   OP_LW,   OP_NONE, OP_NONE,
+    OP_NONE, OP_NONE, OP_JALR,  OP_ADD,     OP_NONE, OP_NONE, OP_NONE, OP_SLL,
+    OP_NONE, OP_NONE, OP_NONE,  OP_ADDI,    OP_ORI,  OP_NONE, OP_BEQ,  OP_SW,
+    OP_NONE, OP_J,    OP_LUI,   OP_SYSCALL, OP_SLLV, OP_NOP,  OP_NONE, OP_ADDU
+};
+
+const char *iplc_sim_opcode_name(int opcode)
+{
+    if (opcode < 0 || opcode >= NUM_OPCODES)
+        return "?";
+    return opcode_table[opcode].name;
+}
+
+/*
+ * Is the last operand of an RTYPE form an immediate or shift amount rather
+ * than a register?
+ */
+int iplc_sim_opcode_immediate(int opcode)
+{
+    if (opcode < 0 || opcode >= NUM_OPCODES)
+        return 0;
+    return opcode_table[opcode].format == FMT_RRI || opcode_table[opcode].format == FMT_RI;
+}
+
+/*
+ * Look a mnemonic up.  Returns its enum opcode_id, or -1 if unknown.
+ */
+int iplc_sim_opcode_lookup(const char *name)
+{
+    size_t len = strlen(name);
+    int opcode;
+
+    if (len == 0)
+        return -1;
+    opcode = opcode_hash[OPCODE_HASH(name, len)];
+    if (opcode == OP_NONE || strcmp(name, opcode_table[opcode].name) != 0)
+        return -1;
+    return opcode;
+}
+
 /*
  * Don't touch this function.  It is for parsing the instruction stream.
  */
-unsigned int iplc_sim_parse_reg(char *reg_str)
+static unsigned int iplc_sim_parse_reg(char *reg_str)
 {
     int i;
     // turn comma into \n
@@ -584,175 +2093,673 @@ unsigned int iplc_sim_parse_reg(char *reg_str)
 }
 
 /*
- * Don't touch this function.  It is for parsing the instruction stream.
+ * The base register of a LW/SW address operand such as "8($29):".
+ * Returns -1 if there is none.
  */
-void iplc_sim_parse_instruction(char *buffer)
+static int iplc_sim_parse_base(const char *operand)
 {
-    int instruction_hit = 0;
-    int i=0, j=0;
-    int src_reg=0;
-    int src_reg2=0;
-    int dest_reg=0;
-    char str_src_reg[16];
-    char str_src_reg2[16];
-    char str_dest_reg[16];
-    char str_constant[16];
-
-    if (sscanf(buffer, "%x %s", &instruction_address, instruction ) != 2) {
-        printf("Malformed instruction \n");
-        exit(-1);
-    }
+    const char *p = strchr(operand, '(');
 
-    instruction_hit = iplc_sim_trap_address( instruction_address );
+    if (p == NULL)
+        return -1;
+    if (*++p == '$')
+        p++;
+    return atoi(p);
+}
 
-    // if a MISS, then push current instruction thru pipeline
-    if (!instruction_hit) {
-        // need to subtract 1, since the stage is pushed once more for actual instruction processing
-        // also need to allow for a branch miss prediction during the fetch cache miss time -- by
-        // counting cycles this allows for these cycles to overlap and not doubly count.
+/*
+ * Decode one line of the trace into a trace record.  Nothing in the
+ * simulator is touched, so a trace can be decoded once and replayed.
+ * Returns 0 on success and -1 on a malformed line.
+ */
+int iplc_sim_decode(const char *buffer, trace_record_t *rec)
+{
+    char instruction[16];
+    char op[3][16];
+    const opcode_info_t *info;
+    int opcode, n, count;
 
-        printf("INST MISS:\t Address 0x%x \n", instruction_address);
+    bzero(rec, sizeof(trace_record_t));
 
-        for (i = pipeline_cycles, j = pipeline_cycles; i < j + CACHE_MISS_DELAY - 1; i++)
-            iplc_sim_push_pipeline_stage();
+    if (sscanf(buffer, "%x %15s%n", &rec->instruction_address, instruction, &n) != 2) {
+        printf("Malformed instruction \n");
+        return -1;
     }
-    else
-        printf("INST HIT:\t Address 0x%x \n", instruction_address);
-
-    // Parse the Instruction
-
-    if (strncmp( instruction, "add", 3 ) == 0 ||
-        strncmp( instruction, "sll", 3 ) == 0 ||
-        strncmp( instruction, "ori", 3 ) == 0) {
-        if (sscanf(buffer, "%x %s %s %s %s",
-                   &instruction_address,
-                   instruction,
-                   str_dest_reg,
-                   str_src_reg,
-                   str_src_reg2 ) != 5) {
+
+    opcode = iplc_sim_opcode_lookup(instruction);
+    if (opcode < 0) {
+        printf("Do not know how to process instruction: %s at address %x \n",
+               instruction, rec->instruction_address );
+        return -1;
+    }
+    info = &opcode_table[opcode];
+
+    count = sscanf(buffer + n, "%15s %15s %15s", op[0], op[1], op[2]);
+    if (count == EOF)
+        count = 0;
+    if (count < info->operands) {
+        if (info->itype == RTYPE)
             printf("Malformed RTYPE instruction (%s) at address 0x%x \n",
-                   instruction, instruction_address);
-            exit(-1);
+                   instruction, rec->instruction_address);
+        else
+            printf("Bad instruction: %s at address %x \n", instruction, rec->instruction_address);
+        return -1;
+    }
+
+    rec->itype = info->itype;
+    rec->opcode = opcode;
+    rec->dest_reg = -1;
+    rec->reg1 = -1;
+    rec->reg2_or_constant = -1;
+
+    switch (info->format) {
+        case FMT_RRR:
+        case FMT_RRI:
+            rec->dest_reg = iplc_sim_parse_reg(op[0]);
+            rec->reg1 = iplc_sim_parse_reg(op[1]);
+            rec->reg2_or_constant = iplc_sim_parse_reg(op[2]);
+            break;
+
+        case FMT_RI:
+            rec->dest_reg = iplc_sim_parse_reg(op[0]);
+            break;
+
+        case FMT_MEM:
+            if (rec->itype == LW)
+                rec->dest_reg = iplc_sim_parse_reg(op[0]);
+            else
+                rec->reg1 = iplc_sim_parse_reg(op[0]);
+            rec->reg2_or_constant = iplc_sim_parse_base(op[1]);
+            rec->data_address = (uint32_t) strtoul(op[2], NULL, 16);
+            break;
+
+        case FMT_BRANCH:
+            rec->reg1 = iplc_sim_parse_reg(op[0]);
+            rec->reg2_or_constant = iplc_sim_parse_reg(op[1]);
+            break;
+
+        case FMT_JUMP:
+            if (opcode == OP_JAL)
+                rec->dest_reg = 31;
+            break;
+
+        case FMT_JR:
+            if (count >= 2) {
+                rec->dest_reg = iplc_sim_parse_reg(op[0]);
+                rec->reg1 = iplc_sim_parse_reg(op[1]);
+            }
+            else {
+                rec->reg1 = iplc_sim_parse_reg(op[0]);
+                if (opcode == OP_JALR)
+                    rec->dest_reg = 31;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+/*
+ * The configurable pipeline's version of iplc_sim_issue().  The branch
+ * before this instruction resolves first, now that we know where fetch
+ * went; then the instruction is fetched, run up to the memory stage, does
+ * its data access and retires.  pipeline_cycles follows along so the
+ * caches see the right time.
+ */
+static void iplc_sim_issue_pipe(iplc_sim_t *sim, unsigned int instruction_address, int itype,
+                                int immediate, int dest_reg, int reg1, int reg2_or_constant,
+                                unsigned int data_address)
+{
+    iplc_pipe_insn_t insn;
+    int redirect = PIPE_SEQUENTIAL;
+    int hit, latency = 1, s, depth;
+    unsigned long retired, ready = 0;
+
+    if (sim->pending_branch) {
+        int taken = instruction_address != sim->pending_branch + 4;
+        if (iplc_sim_resolve_branch(sim, sim->pending_branch, taken, instruction_address)) {
+            sim->correct_branch_predictions++;
+            redirect = taken ? PIPE_TAKEN : PIPE_SEQUENTIAL;
+        }
+        else {
+            redirect = PIPE_MISPREDICT;
         }
+    }
+    else if (sim->pending_jump) {
+        redirect = PIPE_TAKEN;
+    }
+
+    sim->instruction_address = instruction_address;
+    sim->pipeline_cycles = iplc_pipe_fetch(sim->pipe, redirect);
+
+    hit = iplc_sim_trap_address(sim, sim->l1i, sim->prefetch_i, instruction_address,
+                                instruction_address, PROFILE_FETCH, &latency);
+    if (sim->verbosity >= VERBOSITY_ACCESSES)
+        iplc_sim_event(sim, hit ? EVENT_INST_HIT : EVENT_INST_MISS, sim->pipeline_cycles,
+                       instruction_address, 0, 0, 0);
+
+    insn.fetch_latency = latency;
+    insn.is_mem = itype == LW || itype == SW;
+    insn.is_load = itype == LW;
+    insn.is_branch = itype == BRANCH || ((itype == JUMP || itype == JAL) && reg1 >= 0);
+    insn.dest = itype == RTYPE || itype == LW || itype == JUMP || itype == JAL ? dest_reg : -1;
+    insn.src[0] = itype == RTYPE || insn.is_branch ? reg1 : insn.is_mem ? reg2_or_constant : -1;
+    insn.src[1] = (itype == RTYPE && !immediate) || itype == BRANCH ? reg2_or_constant : -1;
+    insn.store_src = itype == SW ? reg1 : -1;
+
+    sim->pipeline_cycles = iplc_pipe_execute(sim->pipe, &insn);
+
+    latency = 1;
+    if (insn.is_mem)
+        iplc_sim_data_access(sim, instruction_address, data_address, itype == SW, &latency, &ready);
+
+    retired = iplc_pipe_retire(sim->pipe, latency, sim->mshr != NULL && insn.is_load ? ready : 0);
+    sim->instruction_count++;
+    iplc_sim_interval_check(sim);
+    if (itype == BRANCH)
+        sim->branch_count++;
+    sim->pending_branch = itype == BRANCH ? instruction_address : 0;
+    sim->pending_jump = itype == JUMP || itype == JAL;
+
+    if (sim->verbosity >= VERBOSITY_DEBUG)
+        iplc_sim_event(sim, EVENT_RETIRE, retired, instruction_address, itype, 0, 0);
+    if (sim->verbosity >= VERBOSITY_PIPELINE) {
+        depth = iplc_pipe_depth(sim->pipe);
+        iplc_sim_event(sim, EVENT_PIPE_FETCH, iplc_pipe_stage_cycle(sim->pipe, 0), instruction_address,
+                       itype, 0, 0);
+        for (s = 0; s < depth; s++)
+            iplc_sim_event(sim, EVENT_PIPE_STAGE, iplc_pipe_stage_cycle(sim->pipe, s), instruction_address,
+                           itype, sim->config.pipeline_stages[s], s == depth - 1 ? EVENT_LAST : 0);
+    }
+}
+
+/************************************************************************************************/
+/* Sampling Functions ***************************************************************************/
+/************************************************************************************************/
 
-        dest_reg = iplc_sim_parse_reg(str_dest_reg);
-        src_reg = iplc_sim_parse_reg(str_src_reg);
-        src_reg2 = iplc_sim_parse_reg(str_src_reg2);
+/*
+ * One cache access of functional warming: the tags of l1, and of the
+ * levels below it on a miss, with a store leaving its block dirty or
+ * writing through as a detailed one would.  Memory reads and writes are
+ * counted as in iplc_sim_trap_address(), so the traffic of a sampled run
+ * does not depend on whether there is an L2.  Shadow tags, the profile and
+ * events never see it.  An L1 with a prefetcher, or a core of a
+ * multi-core run, takes the whole iplc_sim_trap_address() path instead,
+ * so the prefetcher goes on learning and the directory stays exact.
+ */
+static inline void iplc_sim_warm_access(iplc_sim_t *sim, iplc_cache_t *l1, iplc_prefetch_t *pf,
+                                        unsigned int pc, unsigned int address, int kind)
+{
+    int store = kind == PROFILE_STORE;
+    int hit, latency;
 
-        iplc_sim_process_pipeline_rtype(instruction, dest_reg, src_reg, src_reg2);
+    if (pf != NULL || sim->coherence != NULL) {
+        iplc_sim_trap_address(sim, l1, pf, pc, address, kind, &latency);
+        return;
     }
 
-    else if (strncmp( instruction, "lui", 3 ) == 0) {
-        if (sscanf(buffer, "%x %s %s %s",
-                   &instruction_address,
-                   instruction,
-                   str_dest_reg,
-                   str_constant ) != 4 ) {
-            printf("Malformed RTYPE instruction (%s) at address 0x%x \n",
-                   instruction, instruction_address );
-            exit(-1);
+    if (store && !sim->config.write_allocate) {
+        hit = iplc_cache_probe(l1, address);
+    }
+    else if (sim->nlower == 0) {
+        hit = iplc_cache_access(l1, address);
+        if (!hit) {
+            sim->memory_reads++;
+            sim->memory_read_bytes += 1u << l1->blockoffsetbits;
+            if (l1->victim_dirty)
+                iplc_sim_write_back(sim, 0, l1->victim, 1u << l1->blockoffsetbits);
         }
+    }
+    else {
+        hit = iplc_sim_hierarchy_access(sim, l1, address, &latency);
+    }
 
-        dest_reg = iplc_sim_parse_reg(str_dest_reg);
-        src_reg = -1;
-        src_reg2 = -1;
-        iplc_sim_process_pipeline_rtype(instruction, dest_reg, src_reg, src_reg2);
+    if (kind == PROFILE_FETCH) {
+        sim->fetches++;
+        sim->fetch_misses += !hit;
+        return;
     }
+    sim->data_accesses++;
+    sim->data_misses += !hit;
+    if (!store)
+        return;
+    if ((hit || sim->config.write_allocate) && !sim->config.write_through)
+        iplc_cache_set_dirty(l1, address);
+    else
+        iplc_sim_write_back(sim, 0, address, 4);
+}
 
-    else if (strncmp( instruction, "lw", 2 ) == 0 ||
-             strncmp( instruction, "sw", 2 ) == 0  ) {
-        if ( sscanf( buffer, "%x %s %s %s %x",
-                    &instruction_address,
-                    instruction,
-                    reg1,
-                    offsetwithreg,
-                    &data_address ) != 5) {
-            printf("Bad instruction: %s at address %x \n", instruction, instruction_address);
-            exit(-1);
-        }
+/*
+ * Functional warming between samples: the instruction only goes through
+ * the caches and, for a branch, the predictor, once the next instruction
+ * shows where it went.  No timing, no pipeline and no output.
+ */
+static void iplc_sim_warm(iplc_sim_t *sim, unsigned int pc, int itype, unsigned int data_address)
+{
+    unsigned int branch = sim->warm_branch ? sim->warm_branch : sim->pending_branch;
+
+    if (branch)
+        iplc_sim_resolve_branch(sim, branch, pc != branch + 4, pc);
+    sim->warm_branch = itype == BRANCH ? pc : 0;
+    sim->pending_branch = 0;
+    sim->pending_jump = 0;
+
+    sim->warming = 1;
+    iplc_sim_warm_access(sim, sim->l1i, sim->prefetch_i, pc, pc, PROFILE_FETCH);
+    if (itype == LW || itype == SW)
+        iplc_sim_warm_access(sim, sim->l1d, sim->prefetch_d, pc, data_address,
+                             itype == SW ? PROFILE_STORE : PROFILE_LOAD);
+    sim->warming = 0;
+}
 
-        if (strncmp(instruction, "lw", 2 ) == 0) {
+static void iplc_sim_l1_counts(const iplc_sim_t *sim, long *access, long *miss)
+{
+    *access = sim->l1i->access + (sim->l1d != sim->l1i ? sim->l1d->access : 0);
+    *miss = sim->l1i->miss + (sim->l1d != sim->l1i ? sim->l1d->miss : 0);
+}
 
-            dest_reg = iplc_sim_parse_reg(reg1);
+/*
+ * The measured part of a sample is over: add its CPI and L1 miss rate to
+ * the running sums.  The classic pipeline is drained, outside the
+ * measurement, so the next sample starts from an empty one.
+ */
+static void iplc_sim_sample_end(iplc_sim_t *sim)
+{
+    long insns = (long) sim->instruction_count - sim->sample_instructions;
+    long access, miss;
+    double cpi, rate;
+
+    iplc_sim_l1_counts(sim, &access, &miss);
+    if (insns > 0) {
+        cpi = (double) (sim->pipeline_cycles - sim->sample_cycles) / (double) insns;
+        rate = access > sim->sample_access ?
+               (double) (miss - sim->sample_miss) / (double) (access - sim->sample_access) : 0.0;
+        sim->samples++;
+        sim->cpi_sum += cpi;
+        sim->cpi_sumsq += cpi * cpi;
+        sim->miss_sum += rate;
+        sim->miss_sumsq += rate * rate;
+    }
+    sim->measuring = 0;
 
-            // don't need to worry about base regs -- just insert -1 values
-            iplc_sim_process_pipeline_lw(dest_reg, -1, data_address);
-        }
-        if (strncmp( instruction, "sw", 2 ) == 0) {
-            src_reg = iplc_sim_parse_reg(reg1);
+    if (sim->pipe == NULL &&
+        sim->config.sample_warmup + sim->config.sample_size < sim->config.sample_period)
+        iplc_sim_drain_pipeline(sim);
+}
 
-            // don't need to worry about base regs -- just insert -1 values
-            iplc_sim_process_pipeline_sw( src_reg, -1, data_address);
-        }
+/*
+ * Sampled simulation: each period of sample_period instructions is
+ * functionally warmed, then sample_warmup run in detail to fill the
+ * pipeline, then sample_size run in detail and measured.  Returns 1 if
+ * this instruction was only warmed.
+ */
+static int iplc_sim_sample(iplc_sim_t *sim, unsigned int pc, int itype, unsigned int data_address)
+{
+    long period = sim->config.sample_period;
+    long warm = period - sim->config.sample_warmup - sim->config.sample_size;
+    long pos = sim->sample_pos;
+
+    if (pos == 0 && sim->measuring)
+        iplc_sim_sample_end(sim);
+    sim->sample_pos = pos + 1 == period ? 0 : pos + 1;
+    sim->instructions_fed++;
+
+    if (pos < warm) {
+        sim->warmed_instructions++;
+        iplc_sim_warm(sim, pc, itype, data_address);
+        return 1;
     }
-    else if (strncmp( instruction, "beq", 3 ) == 0) {
-        // don't need to worry about getting regs -- just insert -1 values
-        iplc_sim_process_pipeline_branch(-1, -1);
+    if (pos == period - sim->config.sample_size) {
+        sim->measuring = 1;
+        sim->sample_cycles = sim->pipeline_cycles;
+        sim->sample_instructions = (long) sim->instruction_count;
+        iplc_sim_l1_counts(sim, &sim->sample_access, &sim->sample_miss);
     }
-    else if (strncmp( instruction, "jal", 3 ) == 0 ||
-             strncmp( instruction, "jr", 2 ) == 0 ||
-             strncmp( instruction, "j", 1 ) == 0 ) {
-        iplc_sim_process_pipeline_jump( instruction );
+    return 0;
+}
+
+/*
+ * Mean of n samples, and the half-width of its confidence interval at z
+ * standard errors.
+ */
+static double iplc_sim_confidence(long n, double sum, double sumsq, double z, double *mean)
+{
+    double var;
+
+    *mean = n > 0 ? sum / (double) n : 0.0;
+    if (n < 2)
+        return 0.0;
+    var = (sumsq - (double) n * *mean * *mean) / (double) (n - 1);
+    return var > 0.0 ? z * sqrt(var / (double) n) : 0.0;
+}
+
+/************************************************************************************************/
+/* Issue Functions ******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Fetch a decoded instruction through the cache and push it into the pipeline.
+ * Both the record and the column replay paths end up here.
+ */
+static inline void iplc_sim_issue(iplc_sim_t *sim, unsigned int instruction_address, int itype,
+                                  int opcode, int immediate, int dest_reg, int reg1,
+                                  int reg2_or_constant, unsigned int data_address)
+{
+    int instruction_hit = 0;
+    int latency = 1;
+
+    if (sim->config.sample_period > 0 &&
+        iplc_sim_sample(sim, instruction_address, itype, data_address))
+        return;
+
+    if (sim->warm_branch) {
+        // the last warmed branch still learns where it went, but is not counted
+        iplc_sim_resolve_branch(sim, sim->warm_branch, instruction_address != sim->warm_branch + 4,
+                                instruction_address);
+        sim->warm_branch = 0;
     }
-    else if (strncmp( instruction, "jal", 3 ) == 0 ||
-             strncmp( instruction, "jr", 2 ) == 0 ||
-             strncmp( instruction, "j", 1 ) == 0 ) {
-        /*
-         * Note: no need to worry about forwarding on the jump register
-         * we'll let that one go.
-         */
-        iplc_sim_process_pipeline_jump(instruction);
+
+    if (sim->pipe != NULL) {
+        IPLC_PERF_ENTER(sim->perf, PERF_PIPELINE);
+        iplc_sim_issue_pipe(sim, instruction_address, itype, immediate, dest_reg, reg1,
+                            reg2_or_constant, data_address);
+        IPLC_PERF_LEAVE(sim->perf);
+        return;
     }
-    else if ( strncmp( instruction, "syscall", 7 ) == 0) {
-        iplc_sim_process_pipeline_syscall( );
+
+    sim->instruction_address = instruction_address;
+
+    instruction_hit = iplc_sim_trap_address(sim, sim->l1i, sim->prefetch_i, sim->instruction_address,
+                                            sim->instruction_address, PROFILE_FETCH, &latency);
+
+    if (sim->verbosity >= VERBOSITY_ACCESSES)
+        iplc_sim_event(sim, instruction_hit ? EVENT_INST_HIT : EVENT_INST_MISS, sim->pipeline_cycles,
+                       sim->instruction_address, 0, 0, 0);
+
+    // if a MISS, then push current instruction thru pipeline
+    // need to subtract 1, since the stage is pushed once more for actual instruction processing
+    // also need to allow for a branch miss prediction during the fetch cache miss time -- by
+    // counting cycles this allows for these cycles to overlap and not doubly count.
+    iplc_sim_stall(sim, latency - 1);
+
+    switch (itype) {
+        case RTYPE:
+            iplc_sim_process_pipeline_rtype(sim, opcode, immediate, dest_reg, reg1,
+                                            reg2_or_constant);
+            break;
+        case LW:
+            iplc_sim_process_pipeline_lw(sim, dest_reg, reg2_or_constant, data_address);
+            break;
+        case SW:
+            iplc_sim_process_pipeline_sw(sim, reg1, reg2_or_constant, data_address);
+            break;
+        case BRANCH:
+            iplc_sim_process_pipeline_branch(sim, reg1, reg2_or_constant);
+            break;
+        case JUMP:
+        case JAL:
+            iplc_sim_process_pipeline_jump(sim, opcode, reg1, dest_reg);
+            break;
+        case SYSCALL:
+            iplc_sim_process_pipeline_syscall(sim);
+            break;
+        case NOP:
+            iplc_sim_process_pipeline_nop(sim);
+            break;
     }
-    else if ( strncmp( instruction, "nop", 3 ) == 0) {
-        iplc_sim_process_pipeline_nop( );
+
+    if (sim->verbosity >= VERBOSITY_PIPELINE)
+        iplc_sim_dump_pipeline(sim);
+}
+
+void iplc_sim_feed_record(iplc_sim_t *sim, const trace_record_t *rec)
+{
+    IPLC_PERF_ENTER(sim->perf, PERF_ISSUE);
+    iplc_sim_issue(sim, rec->instruction_address, rec->itype, rec->opcode,
+                   iplc_sim_opcode_immediate(rec->opcode), rec->dest_reg, rec->reg1,
+                   rec->reg2_or_constant, rec->data_address);
+    IPLC_PERF_LEAVE(sim->perf);
+}
+
+/*
+ * Replay records [begin, end) of a column-decoded trace.  Each column is
+ * walked front to back, so the loop streams through memory.
+ */
+void iplc_sim_feed_columns(iplc_sim_t *sim, const trace_columns_t *trace, long begin, long end)
+{
+    const uint32_t *pc = trace->instruction_address;
+    const uint32_t *addr = trace->data_address;
+    const int32_t *rt = trace->reg2_or_constant;
+    const uint8_t *itype = trace->itype;
+    const uint8_t *opcode = trace->opcode;
+    const uint8_t *flags = trace->flags;
+    const int8_t *rd = trace->dest_reg;
+    const int8_t *rs = trace->reg1;
+    long i;
+
+    for (i = begin; i < end; i++) {
+        IPLC_PERF_ENTER(sim->perf, PERF_ISSUE);
+        iplc_sim_issue(sim, pc[i], itype[i], opcode[i], flags[i] & TRACE_IMMEDIATE,
+                       rd[i], rs[i], rt[i], addr[i]);
+        IPLC_PERF_LEAVE(sim->perf);
     }
-    else {
-        printf("Do not know how to process instruction: %s at address %x \n",
-               instruction, instruction_address );
-        exit(-1);
+}
+
+/*
+ * Functionally warm the caches and branch predictor with records [begin,
+ * end): nothing is timed, printed or put in the pipeline.  The counters
+ * still see these accesses; take a iplc_sim_get_stats() snapshot first to
+ * leave them out.
+ */
+void iplc_sim_warm_columns(iplc_sim_t *sim, const trace_columns_t *trace, long begin, long end)
+{
+    long i;
+
+    for (i = begin; i < end; i++) {
+        IPLC_PERF_ENTER(sim->perf, PERF_ISSUE);
+        iplc_sim_warm(sim, trace->instruction_address[i], trace->itype[i], trace->data_address[i]);
+        IPLC_PERF_LEAVE(sim->perf);
     }
 }
 
+/*
+ * Parse one line of the instruction stream and run it through the simulator.
+ */
+int iplc_sim_feed(iplc_sim_t *sim, const char *buffer)
+{
+    trace_record_t rec;
+    int rc;
+
+    IPLC_PERF_ENTER(sim->perf, PERF_PARSE);
+    rc = iplc_sim_decode(buffer, &rec);
+    IPLC_PERF_LEAVE(sim->perf);
+    if (rc != 0)
+        return -1;
+
+    iplc_sim_feed_record(sim, &rec);
+    return 0;
+}
+
 /************************************************************************************************/
-/* MAIN Function ********************************************************************************/
+/* Checkpoint Functions *************************************************************************/
 /************************************************************************************************/
 
-int main()
+/*
+ * Checkpoint file layout (host byte order, only read back by the same
+ * build):
+ *
+ *   iplc_checkpoint_header_t
+ *   iplc_sim_t                  the struct itself, pointers and all
+ *   every cache, prefetcher, predictor, pipeline, write buffer and MSHR
+ *   file the simulator has, in the order iplc_sim_checkpoint() walks them
+ */
+#define IPLC_CHECKPOINT_MAGIC "IPLCCKP"
+#define IPLC_CHECKPOINT_VERSION 3
+
+typedef struct iplc_checkpoint_header
 {
-    char trace_file_name[1024];
-    FILE *trace_file = NULL;
-    char buffer[80];
-    int index = 10;
-    int blocksize = 1;
-    int assoc = 1;
+    char magic[8];              // IPLC_CHECKPOINT_MAGIC, NUL terminated
+    uint32_t version;           // IPLC_CHECKPOINT_VERSION
+    uint32_t sim_size;          // sizeof(iplc_sim_t)
+    long position;              // trace records the simulator had been fed
 
-    printf("Please enter the tracefile: ");
-    scanf("%s", trace_file_name);
+} iplc_checkpoint_header_t;
 
-    trace_file = fopen(trace_file_name, "r");
+/*
+ * Save or load every module the simulator owns.  Both sides were created
+ * from the same configuration, so they own the same ones.
+ */
+static int iplc_sim_checkpoint(iplc_sim_t *sim, FILE *f, int save)
+{
+    int k, ok = 1;
+
+#define CHECKPOINT(module, obj) \
+    if (ok && (obj) != NULL) \
+        ok = (save ? iplc_##module##_save((obj), f) : iplc_##module##_load((obj), f)) == 0
+
+    CHECKPOINT(cache, sim->l1i);
+    if (sim->l1d != sim->l1i)
+        CHECKPOINT(cache, sim->l1d);
+    for (k = 0; k < sim->nlower; k++)
+        CHECKPOINT(cache, sim->lower[k]);
+    for (k = 0; k < NUM_REPL_POLICIES; k++)
+        CHECKPOINT(cache, sim->shadow[k]);
+    CHECKPOINT(prefetch, sim->prefetch_i);
+    CHECKPOINT(prefetch, sim->prefetch_d);
+    CHECKPOINT(bpred, sim->bpred);
+    for (k = 0; k < NUM_BPRED_KINDS; k++)
+        CHECKPOINT(bpred, sim->bpred_shadow[k]);
+    CHECKPOINT(pipe, sim->pipe);
+    CHECKPOINT(wbuf, sim->wbuf);
+    CHECKPOINT(mshr, sim->mshr);
+
+#undef CHECKPOINT
+    return ok ? 0 : -1;
+}
 
-    if ( trace_file == NULL ) {
-        printf("fopen failed for %s file\n", trace_file_name);
-        exit(-1);
-    }
+/*
+ * Everything but the output settings has to match for a checkpoint to
+ * load.
+ */
+static int iplc_sim_same_config(const iplc_sim_config_t *a, const iplc_sim_config_t *b)
+{
+    iplc_sim_config_t x, y;
+
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    x.quiet = y.quiet = 0;
+    x.verbosity = y.verbosity = 0;
+    x.event_log = y.event_log = NULL;
+    x.profile = y.profile = 0;
+    x.profile_region_bits = y.profile_region_bits = 0;
+    x.interval = y.interval = 0;
+    x.interval_format = y.interval_format = 0;
+    x.interval_file = y.interval_file = NULL;
+    return memcmp(&x, &y, sizeof(x)) == 0;
+}
 
-    printf("Enter Cache Size (index), Blocksize and Level of Assoc \n");
-    scanf( "%d %d %d", &index, &blocksize, &assoc );
+/*
+ * Write the whole state of sim, caches, predictor, pipeline and counters,
+ * to path.  position is stored with it for whoever restores it: usually
+ * how many trace records sim has been fed.  Returns 0 on success.
+ */
+int iplc_sim_save(iplc_sim_t *sim, const char *path, long position)
+{
+    iplc_checkpoint_header_t header;
+    FILE *f;
+    int ok;
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        printf("fopen failed for %s file\n", path);
+        return -1;
+    }
 
-    printf("Enter Branch Prediction: 0 (NOT taken), 1 (TAKEN): ");
-    scanf("%d", &branch_predict_taken );
+    bzero(&header, sizeof(header));
+    strcpy(header.magic, IPLC_CHECKPOINT_MAGIC);
+    header.version = IPLC_CHECKPOINT_VERSION;
+    header.sim_size = sizeof(iplc_sim_t);
+    header.position = position;
+
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(sim, sizeof(iplc_sim_t), 1, f) == 1 &&
+         iplc_sim_checkpoint(sim, f, 1) == 0;
+    if (fclose(f) != 0 || !ok) {
+        printf("Could not write checkpoint %s \n", path);
+        return -1;
+    }
+    return 0;
+}
 
-    iplc_sim_init(index, blocksize, assoc);
+/*
+ * Load a checkpoint written by iplc_sim_save() into sim, which has to have
+ * been created with the same configuration (output settings aside); those
+ * and sim's own caches, predictor and so on are kept, with their contents
+ * replaced.  The saved position goes in *position.  Returns 0 on success;
+ * on failure sim may be half restored and should be destroyed.
+ */
+int iplc_sim_restore(iplc_sim_t *sim, const char *path, long *position)
+{
+    iplc_checkpoint_header_t header;
+    iplc_sim_t *saved;
+    FILE *f;
+    int k, ok;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("fopen failed for %s file\n", path);
+        return -1;
+    }
 
-    while (fgets(buffer, 80, trace_file) != NULL) {
-        iplc_sim_parse_instruction(buffer);
-        if (dump_pipeline)
-            iplc_sim_dump_pipeline();
+    saved = (iplc_sim_t *) malloc(sizeof(iplc_sim_t));
+    ok = saved != NULL && fread(&header, sizeof(header), 1, f) == 1 &&
+         strcmp(header.magic, IPLC_CHECKPOINT_MAGIC) == 0 &&
+         header.version == IPLC_CHECKPOINT_VERSION && header.sim_size == sizeof(iplc_sim_t) &&
+         fread(saved, sizeof(iplc_sim_t), 1, f) == 1 && iplc_sim_same_config(&saved->config, &sim->config);
+
+    if (ok) {
+        saved->config = sim->config;
+        saved->quiet = sim->quiet;
+        saved->verbosity = sim->verbosity;
+        saved->events = sim->events;
+        saved->l1i = sim->l1i;
+        saved->l1d = sim->l1d;
+        saved->lower[0] = sim->lower[0];
+        saved->lower[1] = sim->lower[1];
+        saved->prefetch_i = sim->prefetch_i;
+        saved->prefetch_d = sim->prefetch_d;
+        saved->bpred = sim->bpred;
+        saved->pipe = sim->pipe;
+        saved->wbuf = sim->wbuf;
+        saved->mshr = sim->mshr;
+        saved->profile = sim->profile;      // only watches, so is not checkpointed
+        saved->interval = sim->interval;
+        saved->coherence = sim->coherence;
+        saved->core = sim->core;
+#if defined(IPLC_PERF)
+        saved->perf = sim->perf;
+#endif
+        for (k = 0; k < NUM_REPL_POLICIES; k++)
+            saved->shadow[k] = sim->shadow[k];
+        for (k = 0; k < NUM_BPRED_KINDS; k++)
+            saved->bpred_shadow[k] = sim->bpred_shadow[k];
+        *sim = *saved;
+        ok = iplc_sim_checkpoint(sim, f, 0) == 0;
     }
 
-    iplc_sim_finalize();
+    free(saved);
+    fclose(f);
+    if (!ok) {
+        printf("Could not restore checkpoint %s \n", path);
+        return -1;
+    }
+    if (sim->interval != NULL) {
+        // the next row starts here, not at the start of the trace
+        iplc_interval_counters_t c;
+        iplc_sim_interval_counters(sim, &c);
+        sim->interval_next = iplc_interval_start(sim->interval, &c);
+    }
+    if (position != NULL)
+        *position = header.position;
     return 0;
 }
+
@@ -0,0 +1,250 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- library interface
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_SIM_H
+#define IPLC_SIM_H
+
+#include <stdint.h>
+
+#define MAX_CACHE_SIZE 10240
+#define CACHE_MISS_DELAY 10 // 10 cycle cache miss penalty
+#define MAX_STAGES 5
+#define MAX_PIPE_STAGES 16  // for the configurable pipeline
+
+enum instruction_type {NOP, RTYPE, LW, SW, BRANCH, JUMP, JAL, SYSCALL};
+
+/*
+ * Every mnemonic the decoder accepts gets a small id so a decoded trace
+ * does not have to carry strings around.  See iplc_sim_opcode_name().
+ */
+enum opcode_id {OP_ADD, OP_ADDI, OP_ADDIU, OP_ADDU, OP_SLL, OP_SLLV, OP_ORI, OP_LUI,
+                OP_LW, OP_SW, OP_BEQ, OP_J, OP_JAL, OP_JALR, OP_JR, OP_SYSCALL, OP_NOP,
+                NUM_OPCODES};
+
+/*
+ * The ways a register an instruction reads can depend on one still in the
+ * pipeline: its result forwarded from the end of execute (EX->EX) or from
+ * the stage after memory (MEM->EX), a load the next instruction needs
+ * before it has come back (load-use), and a branch that needs an operand
+ * before it can resolve (branch operand).
+ */
+enum hazard_kind {HAZARD_EX_EX, HAZARD_MEM_EX, HAZARD_LOAD_USE, HAZARD_BRANCH_OPERAND,
+                  NUM_HAZARD_KINDS};
+
+/*
+ * One decoded line of the trace.  A trace can be decoded once into an array
+ * of these and then replayed into any number of simulators.  The layout is
+ * fixed at 16 bytes because it is also the record format of binary trace
+ * files (see iplc-trace.h), which are mapped and fed without any copying.
+ */
+typedef struct trace_record
+{
+    uint32_t instruction_address;
+    uint32_t data_address;      // LW/SW only
+    int32_t reg2_or_constant;   // RTYPE/BRANCH second source or immediate, LW/SW base, -1 if none
+    uint8_t itype;              // enum instruction_type
+    uint8_t opcode;             // enum opcode_id
+    int8_t dest_reg;            // -1 if none (JAL: 31)
+    int8_t reg1;                // first source (SW: the stored register, JR: the target), -1 if none
+
+} trace_record_t;
+
+/*
+ * A decoded trace stored column by column for repeated replay: each field
+ * of every record lives in its own contiguous array, so replay loops stream
+ * through memory instead of striding over whole records.  Built with
+ * iplc_trace_columns_build() (iplc-trace.h).
+ */
+#define TRACE_IMMEDIATE 0x1     // flags: RTYPE last operand is a constant
+
+typedef struct trace_columns
+{
+    long count;
+    uint32_t *instruction_address;
+    uint32_t *data_address;
+    int32_t *reg2_or_constant;
+    uint8_t *itype;
+    uint8_t *opcode;
+    uint8_t *flags;
+    int8_t *dest_reg;
+    int8_t *reg1;
+    void *block;                // one allocation backing every column
+
+} trace_columns_t;
+
+/*
+ * How a cache below L1 relates to the levels above it:
+ *
+ *   NINE       non-inclusive non-exclusive: filled on every miss that
+ *              reaches it, never forces anything out of the levels above
+ *   INCLUSIVE  filled on every miss; evicting a block also invalidates it
+ *              in every level above (a back-invalidation)
+ *   EXCLUSIVE  only holds what the level above evicted; a hit moves the
+ *              block up and out of this level
+ */
+enum inclusion_policy {INCLUSION_NINE, INCLUSION_INCLUSIVE, INCLUSION_EXCLUSIVE,
+                       NUM_INCLUSION_POLICIES};
+
+/*
+ * Geometry and timing of one cache below L1.  assoc 0 means the level is
+ * not there.  latency is the whole load-to-use time of an access that hits
+ * in this level, not the extra time over the level above.
+ */
+typedef struct iplc_level_config
+{
+    int index;
+    int blocksize;
+    int assoc;
+    int latency;
+    int inclusion;              // enum inclusion_policy
+
+} iplc_level_config_t;
+
+/*
+ * Everything needed to build a simulator.  Fill in with
+ * iplc_sim_config_init() and then override what you need.
+ */
+typedef struct iplc_sim_config
+{
+    int index;                  // index bits
+    int blocksize;              // words per block
+    int assoc;                  // level of associativity
+    int branch_predict_taken;   // 0 (NOT taken), 1 (TAKEN), for the static predictor
+    int replacement;            // enum repl_policy (iplc-repl.h), REPL_LRU by default
+    int compare_policies;       // also run every other policy on shadow tags and report each
+    int split_l1;               // separate L1I and L1D, each with the geometry above
+    int l1_latency;             // cycles for an L1 hit, 1 by default
+    iplc_level_config_t l2;     // shared by instructions and data
+    iplc_level_config_t l3;     // only used with an L2
+    int memory_latency;         // cycles for an access that misses every level
+    int write_through;          // L1 stores write through rather than back
+    int write_allocate;         // a store miss brings the block into L1, 1 by default
+    int write_buffer;           // coalescing write buffer entries, 0 for none (iplc-wbuf.h)
+    int mshrs;                  // outstanding L1D misses (iplc-mshr.h), 0 for a blocking L1D
+    int prefetch_i;             // enum prefetch_kind (iplc-prefetch.h) for L1I, none by default
+    int prefetch_d;             // ... and for L1D
+    int prefetch_degree;        // blocks a prefetcher runs ahead, 2 by default
+    int branch_predictor;       // enum bpred_kind (iplc-bpred.h), static by default
+    int bpred_table_bits;       // log2 of the predictor table entries
+    int bpred_history_bits;     // global/local history length
+    int btb_bits;               // log2 of the BTB entries, 0 for no BTB
+    int compare_predictors;     // also run every other predictor on the same branches and report each
+    char pipeline_stages[MAX_PIPE_STAGES + 1];  // e.g. "FDXMW" (iplc-pipe.h), "" for the classic pipeline
+    int issue_width;            // configurable pipeline only, as are the next two
+    int branch_resolve_stage;   // stage index, -1 for the last decode stage
+    int mem_ports;              // loads/stores that can enter memory per cycle
+    int hazards;                // classic pipeline: stall on every RAW hazard, not just LW into RTYPE
+    long sample_period;         // sampled simulation: instructions per sample, 0 to run everything in detail
+    long sample_warmup;         // ... of which run in detail before measuring
+    long sample_size;           // ... and then measured; the rest only warm the caches and predictor
+    int profile;                // classify L1 misses and report this many hotspots of each kind, 0 for none
+    int profile_region_bits;    // log2 of the data region size hotspots are summed over, 12 by default
+    long interval;              // write a row of statistics every this many retired instructions, 0 for none
+    int interval_format;        // enum interval_format (iplc-interval.h), CSV by default
+    const char *interval_file;  // where the rows go, NULL for iplc-intervals.csv or .bin
+    int quiet;                  // no configuration, per-access or final report output
+    int verbosity;              // enum iplc_verbosity (iplc-event.h), stats only by default
+    const char *event_log;      // binary log the events go to, NULL to print them
+
+} iplc_sim_config_t;
+
+#define IPLC_MAX_LEVELS 4      // L1I, L1D, L2, L3
+
+typedef struct iplc_level_stats
+{
+    const char *name;
+    long access;
+    long hit;
+    long miss;
+    long back_invalidations;    // blocks this level lost to inclusion below it
+    long evictions;             // valid blocks replaced
+    long writebacks;            // dirty blocks written to the level below
+    long prefetch_issued;
+    long prefetch_useful;       // prefetched blocks a demand access used
+    long prefetch_late;         // ... before they had arrived
+    long compulsory;            // L1 misses by class, with config.profile
+    long capacity;
+    long conflict;
+
+} iplc_level_stats_t;
+
+typedef struct iplc_sim_stats
+{
+    long cache_access;          // L1, instructions and data together
+    long cache_miss;
+    long cache_hit;
+    int nlevels;
+    iplc_level_stats_t level[IPLC_MAX_LEVELS];
+    long memory_reads;          // blocks read from memory, prefetches included
+    long memory_writes;         // write-through words and written-back blocks
+    long memory_read_bytes;
+    long memory_write_bytes;
+    long write_buffer_stalls;   // cycles spent waiting for a full write buffer
+    long mshr_misses;           // primary L1D misses, with MSHRs
+    long mshr_merged;           // secondary misses merged into an outstanding one
+    long mshr_full_cycles;      // cycles misses waited for a free MSHR
+    long mshr_wait_cycles;      // classic pipeline: cycles waiting for an outstanding load
+    double mlp;                 // average misses outstanding while any is
+    unsigned long pipeline_cycles;
+    unsigned long instruction_count;
+    unsigned long branch_count;
+    unsigned long correct_branch_predictions;
+    long hazards[NUM_HAZARD_KINDS];         // forwarded operands, or instructions held up
+    long hazard_stalls[NUM_HAZARD_KINDS];   // cycles lost to each
+    long samples;               // sampled simulation: how many were measured
+    double sample_cpi;          // mean CPI over them
+    double sample_cpi_error;    // half-width of its 95% confidence interval
+    double sample_miss_rate;    // mean L1 miss rate
+    double sample_miss_rate_error;
+
+} iplc_sim_stats_t;
+
+/*
+ * A simulator context owns its cache, pipeline and counters, so any number
+ * of them can run in one process or on different threads.
+ */
+typedef struct iplc_sim iplc_sim_t;
+
+// Decoding
+const char *iplc_sim_opcode_name(int opcode);
+int iplc_sim_opcode_immediate(int opcode);
+int iplc_sim_opcode_lookup(const char *name);
+
+// Configuration
+void iplc_sim_config_init(iplc_sim_config_t *config);
+const char *iplc_sim_inclusion_name(int inclusion);
+int iplc_sim_inclusion_parse(const char *name);
+unsigned long iplc_sim_cache_size(int index, int blocksize, int assoc);
+
+// Lifetime
+iplc_sim_t *iplc_sim_create(const iplc_sim_config_t *config);
+void iplc_sim_destroy(iplc_sim_t *sim);
+
+// Feed the trace: either raw text lines or pre-decoded records
+int iplc_sim_decode(const char *buffer, trace_record_t *rec);
+int iplc_sim_feed(iplc_sim_t *sim, const char *buffer);
+void iplc_sim_feed_record(iplc_sim_t *sim, const trace_record_t *rec);
+void iplc_sim_feed_columns(iplc_sim_t *sim, const trace_columns_t *trace, long begin, long end);
+void iplc_sim_warm_columns(iplc_sim_t *sim, const trace_columns_t *trace, long begin, long end);
+
+// Multi-core runs (iplc-coherence.h)
+struct iplc_coherence;
+int iplc_sim_attach_coherence(iplc_sim_t *sim, struct iplc_coherence *coh, int core);
+unsigned long iplc_sim_cycles(const iplc_sim_t *sim);
+
+// Self profiling, in a build with IPLC_PERF (iplc-perf.h)
+struct iplc_perf;
+struct iplc_perf *iplc_sim_perf(iplc_sim_t *sim);
+
+// Checkpoints: the whole simulator state, into one created with the same configuration
+int iplc_sim_save(iplc_sim_t *sim, const char *path, long position);
+int iplc_sim_restore(iplc_sim_t *sim, const char *path, long *position);
+
+// Drain the pipeline, collect the counters and output the report
+void iplc_sim_finalize(iplc_sim_t *sim, iplc_sim_stats_t *stats);
+void iplc_sim_get_stats(const iplc_sim_t *sim, iplc_sim_stats_t *stats);
+void iplc_sim_stats_merge(iplc_sim_stats_t *sum, const iplc_sim_stats_t *s, int sign);
+
+#endif
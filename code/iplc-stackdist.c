@@ -0,0 +1,429 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- LRU stack distance analysis
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iplc-stackdist.h"
+
+#define EMPTY_BLOCK UINT64_MAX
+
+struct iplc_stackdist
+{
+    int blocksize;
+    int blockoffsetbits;
+    int max_index;
+    int max_assoc;
+    long accesses;
+
+    /*
+     * Per-set LRU stacks for every index width, MRU first.  Stacks are cut
+     * off at max_assoc deep; anything that falls off is a miss for every
+     * associativity we report.
+     */
+    uint32_t *stacks[STACKDIST_MAX_INDEX + 1];
+    uint8_t *depth[STACKDIST_MAX_INDEX + 1];
+    // hits[k][d]: accesses found d deep in their set's stack with k index bits
+    long *hits[STACKDIST_MAX_INDEX + 1];
+
+    /*
+     * Fully associative reuse distances (Bennett-Kruskal): remember when each
+     * block was last touched and keep a Fenwick tree over time with a mark
+     * at every block's latest access.  The marks between the previous access
+     * and now count the distinct blocks touched in between.  Time is the
+     * position on the tree's axis, not the access count: when the axis is
+     * full the live blocks are renumbered 0..block_count-1 in the order of
+     * their last access, so the tree stays within a small multiple of the
+     * number of distinct blocks however long the trace.
+     */
+    uint64_t *block_keys;       // open addressing, EMPTY_BLOCK when unused
+    long *block_last;
+    long block_cap;
+    long block_count;
+    long *fenwick;              // 1-based
+    long fenwick_cap;
+    long now;                   // where the next access goes on the axis
+
+    long cold;
+    long reuse[STACKDIST_BUCKETS];
+};
+
+iplc_stackdist_t *iplc_stackdist_create(int blocksize, int max_index, int max_assoc)
+{
+    iplc_stackdist_t *sd;
+    int k;
+
+    if (max_index < 0 || max_index > STACKDIST_MAX_INDEX ||
+        max_assoc < 1 || max_assoc > STACKDIST_MAX_ASSOC)
+        return NULL;
+
+    sd = (iplc_stackdist_t *) calloc(1, sizeof(iplc_stackdist_t));
+    if (sd == NULL)
+        return NULL;
+
+    sd->blocksize = blocksize;
+    for (sd->blockoffsetbits = 0; (1 << sd->blockoffsetbits) < blocksize * 4; sd->blockoffsetbits++)
+        ;
+    sd->max_index = max_index;
+    sd->max_assoc = max_assoc;
+
+    for (k = 0; k <= max_index; k++) {
+        sd->stacks[k] = (uint32_t *) calloc((size_t) max_assoc << k, sizeof(uint32_t));
+        sd->depth[k] = (uint8_t *) calloc((size_t) 1 << k, sizeof(uint8_t));
+        sd->hits[k] = (long *) calloc(max_assoc, sizeof(long));
+        if (sd->stacks[k] == NULL || sd->depth[k] == NULL || sd->hits[k] == NULL) {
+            iplc_stackdist_destroy(sd);
+            return NULL;
+        }
+    }
+
+    sd->block_cap = 1024;
+    sd->block_keys = (uint64_t *) malloc(sizeof(uint64_t) * sd->block_cap);
+    sd->block_last = (long *) malloc(sizeof(long) * sd->block_cap);
+
+    sd->fenwick_cap = 4096;
+    sd->fenwick = (long *) calloc(sd->fenwick_cap + 1, sizeof(long));
+
+    if (sd->block_keys == NULL || sd->block_last == NULL || sd->fenwick == NULL) {
+        iplc_stackdist_destroy(sd);
+        return NULL;
+    }
+    memset(sd->block_keys, 0xff, sizeof(uint64_t) * sd->block_cap);
+
+    return sd;
+}
+
+void iplc_stackdist_destroy(iplc_stackdist_t *sd)
+{
+    int k;
+
+    if (sd == NULL)
+        return;
+
+    for (k = 0; k <= sd->max_index; k++) {
+        free(sd->stacks[k]);
+        free(sd->depth[k]);
+        free(sd->hits[k]);
+    }
+    free(sd->block_keys);
+    free(sd->block_last);
+    free(sd->fenwick);
+    free(sd);
+}
+
+/************************************************************************************************/
+/* Reuse Distance Functions *********************************************************************/
+/************************************************************************************************/
+
+static void fenwick_add(iplc_stackdist_t *sd, long t, long v)
+{
+    for (t++; t <= sd->fenwick_cap; t += t & -t)
+        sd->fenwick[t] += v;
+}
+
+static long fenwick_sum(const iplc_stackdist_t *sd, long t) // marks in [0, t]
+{
+    long s = 0;
+
+    for (t++; t > 0; t -= t & -t)
+        s += sd->fenwick[t];
+    return s;
+}
+
+static int compare_last(const void *a, const void *b)
+{
+    long x = ((const long *) a)[0], y = ((const long *) b)[0];
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * The time axis is full.  Only the latest access of each block is marked,
+ * so renumbering those accesses 0..block_count-1, in order, leaves every
+ * future distance as it was.  The axis doubles first if the blocks would
+ * fill more than half of it, so a compaction always frees at least half.
+ * Returns -1, with nothing changed, if memory runs out.
+ */
+static int fenwick_compact(iplc_stackdist_t *sd)
+{
+    long cap = sd->fenwick_cap;
+    long *order, *tree;
+    long i, n = 0;
+
+    while (2 * sd->block_count > cap)
+        cap *= 2;
+
+    order = (long *) malloc(sizeof(long) * 2 * (sd->block_count > 0 ? sd->block_count : 1));
+    tree = (long *) calloc(cap + 1, sizeof(long));
+    if (order == NULL || tree == NULL) {
+        free(order);
+        free(tree);
+        return -1;
+    }
+
+    // (last access, slot) pairs, oldest first
+    for (i = 0; i < sd->block_cap; i++) {
+        if (sd->block_keys[i] != EMPTY_BLOCK) {
+            order[2 * n] = sd->block_last[i];
+            order[2 * n + 1] = i;
+            n++;
+        }
+    }
+    qsort(order, n, 2 * sizeof(long), compare_last);
+
+    free(sd->fenwick);
+    sd->fenwick = tree;
+    sd->fenwick_cap = cap;
+    for (i = 0; i < n; i++) {
+        sd->block_last[order[2 * i + 1]] = i;
+        fenwick_add(sd, i, 1);
+    }
+    sd->now = n;
+
+    free(order);
+    return 0;
+}
+
+static inline long block_slot(const iplc_stackdist_t *sd, uint64_t block)
+{
+    long mask = sd->block_cap - 1;
+    long i = (long) ((block * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+    while (sd->block_keys[i] != EMPTY_BLOCK && sd->block_keys[i] != block)
+        i = (i + 1) & mask;
+    return i;
+}
+
+/*
+ * Double the block table.  Returns -1, with the old table kept, if memory
+ * runs out.
+ */
+static int block_table_grow(iplc_stackdist_t *sd)
+{
+    uint64_t *keys = sd->block_keys;
+    long *last = sd->block_last;
+    long cap = sd->block_cap;
+    long i, slot;
+
+    sd->block_keys = (uint64_t *) malloc(sizeof(uint64_t) * cap * 2);
+    sd->block_last = (long *) malloc(sizeof(long) * cap * 2);
+    if (sd->block_keys == NULL || sd->block_last == NULL) {
+        free(sd->block_keys);
+        free(sd->block_last);
+        sd->block_keys = keys;
+        sd->block_last = last;
+        return -1;
+    }
+    sd->block_cap = cap * 2;
+    memset(sd->block_keys, 0xff, sizeof(uint64_t) * sd->block_cap);
+
+    for (i = 0; i < cap; i++) {
+        if (keys[i] == EMPTY_BLOCK)
+            continue;
+        slot = block_slot(sd, keys[i]);
+        sd->block_keys[slot] = keys[i];
+        sd->block_last[slot] = last[i];
+    }
+    free(keys);
+    free(last);
+    return 0;
+}
+
+static int iplc_stackdist_reuse(iplc_stackdist_t *sd, uint32_t block)
+{
+    long slot, distance, now;
+    int bucket;
+
+    if (sd->now >= sd->fenwick_cap && fenwick_compact(sd) != 0)
+        return -1;
+    now = sd->now;
+
+    slot = block_slot(sd, block);
+    if (sd->block_keys[slot] == EMPTY_BLOCK) {
+        if (2 * (sd->block_count + 1) > sd->block_cap) {
+            if (block_table_grow(sd) != 0)
+                return -1;
+            slot = block_slot(sd, block);
+        }
+        sd->cold++;
+        sd->block_keys[slot] = block;
+        sd->block_count++;
+    }
+    else {
+        distance = fenwick_sum(sd, now - 1) - fenwick_sum(sd, sd->block_last[slot]);
+        fenwick_add(sd, sd->block_last[slot], -1);
+
+        for (bucket = 0; bucket < STACKDIST_BUCKETS - 1 && distance >= (1L << bucket); bucket++)
+            ;
+        sd->reuse[bucket]++;
+    }
+
+    sd->block_last[slot] = now;
+    fenwick_add(sd, now, 1);
+    sd->now = now + 1;
+    return 0;
+}
+
+/************************************************************************************************/
+/* Stack Functions ******************************************************************************/
+/************************************************************************************************/
+
+/*
+ * Run one address through every stack.  Returns -1, without counting the
+ * access, if the reuse distance tables could not grow.
+ */
+int iplc_stackdist_access(iplc_stackdist_t *sd, uint32_t address)
+{
+    uint32_t block = address >> sd->blockoffsetbits;
+    int k, d, n;
+
+    if (iplc_stackdist_reuse(sd, block) != 0)
+        return -1;
+
+    for (k = 0; k <= sd->max_index; k++) {
+        uint32_t set = block & ((1u << k) - 1);
+        uint32_t *stack = sd->stacks[k] + (size_t) set * sd->max_assoc;
+
+        n = sd->depth[k][set];
+        for (d = 0; d < n && stack[d] != block; d++)
+            ;
+
+        if (d < n)
+            sd->hits[k][d]++;
+        else if (n < sd->max_assoc)
+            sd->depth[k][set] = ++n;
+        else
+            d = n - 1;          // falls off the bottom of the stack
+
+        // move to front
+        memmove(stack + 1, stack, sizeof(uint32_t) * d);
+        stack[0] = block;
+    }
+
+    sd->accesses++;
+    return 0;
+}
+
+/*
+ * Feed records [begin, end): the fetch, then the data access of LW/SW.
+ * Returns -1 if memory ran out part way.
+ */
+int iplc_stackdist_feed_columns(iplc_stackdist_t *sd, const trace_columns_t *trace,
+                                long begin, long end)
+{
+    long i;
+
+    for (i = begin; i < end; i++) {
+        if (iplc_stackdist_access(sd, trace->instruction_address[i]) != 0)
+            return -1;
+        if ((trace->itype[i] == LW || trace->itype[i] == SW) &&
+            iplc_stackdist_access(sd, trace->data_address[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/************************************************************************************************/
+/* Result Functions *****************************************************************************/
+/************************************************************************************************/
+
+long iplc_stackdist_accesses(const iplc_stackdist_t *sd)
+{
+    return sd->accesses;
+}
+
+/*
+ * LRU misses of a (1 << index)-set, assoc-way cache: everything that was
+ * not found within assoc entries of the top of its set's stack.
+ */
+long iplc_stackdist_misses(const iplc_stackdist_t *sd, int index, int assoc)
+{
+    long hits = 0;
+    int d;
+
+    if (index < 0 || index > sd->max_index || assoc < 1 || assoc > sd->max_assoc)
+        return -1;
+
+    for (d = 0; d < assoc; d++)
+        hits += sd->hits[index][d];
+    return sd->accesses - hits;
+}
+
+long iplc_stackdist_cold_misses(const iplc_stackdist_t *sd)
+{
+    return sd->cold;
+}
+
+long iplc_stackdist_reuse_bucket(const iplc_stackdist_t *sd, int bucket)
+{
+    if (bucket < 0 || bucket >= STACKDIST_BUCKETS)
+        return 0;
+    return sd->reuse[bucket];
+}
+
+/*
+ * Miss ratio of a fully associative LRU cache holding capacity_blocks
+ * blocks.  Bucket boundaries are powers of two, so capacities that are
+ * powers of two are exact.
+ */
+double iplc_stackdist_miss_ratio(const iplc_stackdist_t *sd, long capacity_blocks)
+{
+    long misses = sd->cold;
+    int bucket;
+
+    if (sd->accesses == 0)
+        return 0.0;
+
+    // bucket b holds distances [2^(b-1), 2^b); a distance d misses when d >= capacity
+    for (bucket = 0; bucket < STACKDIST_BUCKETS; bucket++) {
+        long low = bucket == 0 ? 0 : 1L << (bucket - 1);
+        if (low >= capacity_blocks)
+            misses += sd->reuse[bucket];
+    }
+    return (double) misses / (double) sd->accesses;
+}
+
+void iplc_stackdist_report(const iplc_stackdist_t *sd)
+{
+    static const int assocs[] = {1, 2, 4, 8, 16, 32, 64};
+    int bucket, k, a;
+    long capacity;
+
+    printf("Stack Distance Analysis: BlockSize %d (%d offset bits), %ld accesses, %ld cold misses \n",
+           sd->blocksize, sd->blockoffsetbits, sd->accesses, sd->cold);
+
+    printf("   LRU miss rate by index bits (rows) and associativity (columns), * fits MAX_CACHE_SIZE \n");
+    printf("   Index");
+    for (a = 0; a < 7 && assocs[a] <= sd->max_assoc; a++)
+        printf("  %9d", assocs[a]);
+    printf("\n");
+    for (k = 0; k <= sd->max_index; k++) {
+        printf("   %5d", k);
+        for (a = 0; a < 7 && assocs[a] <= sd->max_assoc; a++) {
+            printf("  %8.6f%c",
+                   (double) iplc_stackdist_misses(sd, k, assocs[a]) / (double) sd->accesses,
+                   iplc_sim_cache_size(k, sd->blocksize, assocs[a]) <= MAX_CACHE_SIZE ? '*' : ' ');
+        }
+        printf("\n");
+    }
+
+    printf("   Reuse distance histogram (fully associative, in blocks) \n");
+    for (bucket = 0; bucket < STACKDIST_BUCKETS; bucket++) {
+        if (sd->reuse[bucket] == 0)
+            continue;
+        if (bucket == 0)
+            printf("\t %10d           %10ld \n", 0, sd->reuse[bucket]);
+        else
+            printf("\t %10ld - %-10ld %10ld \n", 1L << (bucket - 1), (1L << bucket) - 1,
+                   sd->reuse[bucket]);
+    }
+    printf("\t       cold            %10ld \n", sd->cold);
+
+    printf("   Miss ratio curve (fully associative LRU) \n");
+    for (capacity = 1; capacity <= (1L << (sd->max_index + 6)); capacity *= 2)
+        printf("\t %8ld blocks  %8.6f \n", capacity, iplc_stackdist_miss_ratio(sd, capacity));
+    printf("\n");
+}
@@ -0,0 +1,43 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- LRU stack distance analysis
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_STACKDIST_H
+#define IPLC_STACKDIST_H
+
+#include "iplc-sim.h"
+
+#define STACKDIST_MAX_INDEX 16
+#define STACKDIST_MAX_ASSOC 64
+#define STACKDIST_BUCKETS 33    // reuse distance 0, then [2^(i-1), 2^i)
+
+/*
+ * Mattson-style stack distance engine for one block size.  A single pass
+ * over the address stream keeps an LRU stack per set for every index width
+ * 0..max_index at once, which gives the LRU hit/miss count of every
+ * (index, assoc <= max_assoc) cache with that block size.  It also keeps the
+ * fully associative reuse distance of every access, which gives the reuse
+ * histogram and the miss ratio curve.
+ *
+ * The stream is the trace in program order: each instruction fetch followed
+ * by its LW/SW data access.
+ */
+typedef struct iplc_stackdist iplc_stackdist_t;
+
+iplc_stackdist_t *iplc_stackdist_create(int blocksize, int max_index, int max_assoc);
+void iplc_stackdist_destroy(iplc_stackdist_t *sd);
+
+int iplc_stackdist_access(iplc_stackdist_t *sd, uint32_t address);
+int iplc_stackdist_feed_columns(iplc_stackdist_t *sd, const trace_columns_t *trace,
+                                long begin, long end);
+
+// Results
+long iplc_stackdist_accesses(const iplc_stackdist_t *sd);
+long iplc_stackdist_misses(const iplc_stackdist_t *sd, int index, int assoc);
+long iplc_stackdist_cold_misses(const iplc_stackdist_t *sd);
+long iplc_stackdist_reuse_bucket(const iplc_stackdist_t *sd, int bucket);
+double iplc_stackdist_miss_ratio(const iplc_stackdist_t *sd, long capacity_blocks);
+void iplc_stackdist_report(const iplc_stackdist_t *sd);
+
+#endif
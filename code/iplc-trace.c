@@ -0,0 +1,247 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- trace files
+ ***********************************************************************/
+/***********************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "iplc-trace.h"
+#include "iplc-ingest.h"
+
+/*
+ * Check for the binary trace header.  Anything else is treated as text.
+ * Only a regular file can be binary: it has to be mapped, and peeking at
+ * a pipe or FIFO would eat the start of a text trace.
+ */
+int iplc_trace_is_binary(const char *path)
+{
+    iplc_trace_header_t header;
+    struct stat st;
+    FILE *f;
+    int binary = 0;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return 0;
+    f = fopen(path, "rb");
+    if (f == NULL)
+        return 0;
+
+    if (fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, IPLC_TRACE_MAGIC, sizeof(IPLC_TRACE_MAGIC)) == 0)
+        binary = 1;
+
+    fclose(f);
+    return binary;
+}
+
+/*
+ * Map a binary trace.  The records are used straight out of the mapping.
+ */
+static int iplc_trace_open_binary(const char *path, iplc_trace_t *trace)
+{
+    const iplc_trace_header_t *header;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("open failed for %s file\n", path);
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(iplc_trace_header_t)) {
+        printf("Truncated binary trace %s \n", path);
+        close(fd);
+        return -1;
+    }
+
+    trace->map_length = st.st_size;
+    trace->map = mmap(NULL, trace->map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (trace->map == MAP_FAILED) {
+        printf("mmap failed for %s file\n", path);
+        trace->map = NULL;
+        return -1;
+    }
+
+    header = (const iplc_trace_header_t *) trace->map;
+    if (memcmp(header->magic, IPLC_TRACE_MAGIC, sizeof(IPLC_TRACE_MAGIC)) != 0 ||
+        header->version != IPLC_TRACE_VERSION ||
+        header->record_size != sizeof(trace_record_t)) {
+        printf("Unsupported binary trace %s (version %u, record size %u) \n",
+               path, header->version, header->record_size);
+        munmap(trace->map, trace->map_length);
+        trace->map = NULL;
+        return -1;
+    }
+
+    madvise(trace->map, trace->map_length, MADV_SEQUENTIAL);
+
+    trace->records = (const trace_record_t *) (header + 1);
+    trace->count = (trace->map_length - sizeof(iplc_trace_header_t)) / sizeof(trace_record_t);
+    return 0;
+}
+
+/*
+ * Decode a whole text trace into memory, reading and decoding it on their
+ * own threads while the records are copied out.
+ */
+static int iplc_trace_open_text(const char *path, iplc_trace_t *trace)
+{
+    iplc_ingest_t *ingest;
+    const trace_record_t *batch;
+    trace_record_t *grown;
+    long cap = 0, n;
+
+    ingest = iplc_ingest_open(path);
+    if (ingest == NULL)
+        return -1;
+
+    while ((batch = iplc_ingest_next(ingest, &n)) != NULL) {
+        if (trace->count + n > cap) {
+            cap = cap ? cap * 2 : 65536;
+            grown = (trace_record_t *) realloc(trace->decoded, sizeof(trace_record_t) * cap);
+            if (grown == NULL) {
+                iplc_ingest_close(ingest);
+                return -1;
+            }
+            trace->decoded = grown;
+        }
+        memcpy(&trace->decoded[trace->count], batch, sizeof(trace_record_t) * n);
+        trace->count += n;
+        iplc_ingest_release(ingest);
+    }
+
+    trace->records = trace->decoded;
+    return iplc_ingest_close(ingest);
+}
+
+/*
+ * Load a text or binary trace, whichever the file turns out to be.
+ */
+int iplc_trace_open(const char *path, iplc_trace_t *trace)
+{
+    int ret;
+
+    bzero(trace, sizeof(iplc_trace_t));
+
+    if (iplc_trace_is_binary(path))
+        ret = iplc_trace_open_binary(path, trace);
+    else
+        ret = iplc_trace_open_text(path, trace);
+
+    if (ret != 0)
+        iplc_trace_close(trace);
+    return ret;
+}
+
+void iplc_trace_close(iplc_trace_t *trace)
+{
+    if (trace->map != NULL)
+        munmap(trace->map, trace->map_length);
+    free(trace->decoded);
+    bzero(trace, sizeof(iplc_trace_t));
+}
+
+/*
+ * Split records into columns.  Every column starts on a cache line boundary
+ * inside one allocation.
+ */
+int iplc_trace_columns_build(trace_columns_t *columns, const trace_record_t *records, long count)
+{
+    size_t n = (size_t) count;
+    size_t off32 = (n * 4 + 63) & ~(size_t) 63;
+    size_t off8 = (n + 63) & ~(size_t) 63;
+    char *p;
+    long i;
+
+    bzero(columns, sizeof(trace_columns_t));
+    if (posix_memalign(&columns->block, 64, 3 * off32 + 5 * off8 + 64) != 0) {
+        columns->block = NULL;
+        return -1;
+    }
+
+    p = (char *) columns->block;
+    columns->instruction_address = (uint32_t *) p;  p += off32;
+    columns->data_address = (uint32_t *) p;         p += off32;
+    columns->reg2_or_constant = (int32_t *) p;      p += off32;
+    columns->itype = (uint8_t *) p;                 p += off8;
+    columns->opcode = (uint8_t *) p;                p += off8;
+    columns->flags = (uint8_t *) p;                 p += off8;
+    columns->dest_reg = (int8_t *) p;               p += off8;
+    columns->reg1 = (int8_t *) p;
+    columns->count = count;
+
+    for (i = 0; i < count; i++) {
+        columns->instruction_address[i] = records[i].instruction_address;
+        columns->data_address[i] = records[i].data_address;
+        columns->reg2_or_constant[i] = records[i].reg2_or_constant;
+        columns->itype[i] = records[i].itype;
+        columns->opcode[i] = records[i].opcode;
+        columns->flags[i] = iplc_sim_opcode_immediate(records[i].opcode) ? TRACE_IMMEDIATE : 0;
+        columns->dest_reg[i] = records[i].dest_reg;
+        columns->reg1[i] = records[i].reg1;
+    }
+
+    return 0;
+}
+
+void iplc_trace_columns_free(trace_columns_t *columns)
+{
+    free(columns->block);
+    bzero(columns, sizeof(trace_columns_t));
+}
+
+/*
+ * Convert a text trace into a binary one, a batch at a time as the ingest
+ * threads decode it.
+ */
+int iplc_trace_convert(const char *text_path, const char *binary_path)
+{
+    iplc_ingest_t *ingest;
+    const trace_record_t *batch;
+    iplc_trace_header_t header;
+    FILE *out;
+    long n;
+    int ret = 0;
+
+    ingest = iplc_ingest_open(text_path);
+    if (ingest == NULL)
+        return -1;
+
+    out = fopen(binary_path, "wb");
+    if (out == NULL) {
+        printf("fopen failed for %s file\n", binary_path);
+        iplc_ingest_close(ingest);
+        return -1;
+    }
+
+    bzero(&header, sizeof(header));
+    strcpy(header.magic, IPLC_TRACE_MAGIC);
+    header.version = IPLC_TRACE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    fwrite(&header, sizeof(header), 1, out);
+
+    while ((batch = iplc_ingest_next(ingest, &n)) != NULL) {
+        fwrite(batch, sizeof(trace_record_t), (size_t) n, out);
+        iplc_ingest_release(ingest);
+    }
+    if (iplc_ingest_close(ingest) != 0)
+        ret = -1;
+
+    if (ferror(out)) {
+        printf("write failed for %s file\n", binary_path);
+        ret = -1;
+    }
+
+    if (fclose(out) != 0)
+        ret = -1;
+    return ret;
+}
@@ -0,0 +1,59 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- trace files
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_TRACE_H
+#define IPLC_TRACE_H
+
+#include <stddef.h>
+
+#include "iplc-sim.h"
+
+/*
+ * Binary trace file layout (host byte order):
+ *
+ *   iplc_trace_header_t     16 bytes
+ *   trace_record_t[count]   16 bytes each, count = (file size - 16) / 16
+ *
+ * The records are exactly the in-memory trace_record_t, so a mapped file
+ * is fed into the simulator in place.
+ */
+#define IPLC_TRACE_MAGIC "IPLCTRC"
+#define IPLC_TRACE_VERSION 1
+
+typedef struct iplc_trace_header
+{
+    char magic[8];              // IPLC_TRACE_MAGIC, NUL terminated
+    uint32_t version;           // IPLC_TRACE_VERSION
+    uint32_t record_size;       // sizeof(trace_record_t)
+
+} iplc_trace_header_t;
+
+/*
+ * A whole trace held in memory.  Binary traces are mmap'd read-only; text
+ * traces are decoded into a malloc'd array.
+ */
+typedef struct iplc_trace
+{
+    const trace_record_t *records;
+    long count;
+
+    void *map;                  // mmap'd binary file, or NULL
+    size_t map_length;
+    trace_record_t *decoded;    // decoded text file, or NULL
+
+} iplc_trace_t;
+
+int iplc_trace_is_binary(const char *path);
+int iplc_trace_open(const char *path, iplc_trace_t *trace);
+void iplc_trace_close(iplc_trace_t *trace);
+
+// Decode-once column layout for replaying a trace many times
+int iplc_trace_columns_build(trace_columns_t *columns, const trace_record_t *records, long count);
+void iplc_trace_columns_free(trace_columns_t *columns);
+
+// Text to binary converter; streams, so the text trace is never held in memory
+int iplc_trace_convert(const char *text_path, const char *binary_path);
+
+#endif
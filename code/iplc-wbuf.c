@@ -0,0 +1,120 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- coalescing write buffer
+ ***********************************************************************/
+/***********************************************************************/
+#include <stdlib.h>
+
+#include "iplc-wbuf.h"
+
+typedef struct wbuf_entry
+{
+    uint32_t block;
+    unsigned long start;        // cycle the write starts draining
+    unsigned long done;         // ... and is finished
+
+} wbuf_entry_t;
+
+struct iplc_wbuf
+{
+    int size;
+    int head;                   // oldest entry
+    int count;
+    unsigned long drained;      // cycle the newest write is finished
+    wbuf_entry_t entry[WBUF_MAX_ENTRIES];
+
+    iplc_wbuf_stats_t stats;
+};
+
+/*
+ * Returns NULL for a size outside 1..WBUF_MAX_ENTRIES.
+ */
+iplc_wbuf_t *iplc_wbuf_create(int entries)
+{
+    iplc_wbuf_t *wb;
+
+    if (entries < 1 || entries > WBUF_MAX_ENTRIES)
+        return NULL;
+
+    wb = (iplc_wbuf_t *) calloc(1, sizeof(iplc_wbuf_t));
+    if (wb == NULL)
+        return NULL;
+
+    wb->size = entries;
+    return wb;
+}
+
+void iplc_wbuf_destroy(iplc_wbuf_t *wb)
+{
+    free(wb);
+}
+
+/*
+ * Queue a write to block at cycle now that takes latency cycles once it
+ * starts.  Returns the cycles the writer has to wait for room.
+ */
+int iplc_wbuf_write(iplc_wbuf_t *wb, uint32_t block, unsigned long now, int latency)
+{
+    wbuf_entry_t *e;
+    unsigned long wait = 0;
+    int i;
+
+    wb->stats.writes++;
+
+    while (wb->count > 0 && wb->entry[wb->head].done <= now) {
+        wb->head = (wb->head + 1) % wb->size;
+        wb->count--;
+    }
+
+    for (i = 0; i < wb->count; i++) {
+        e = &wb->entry[(wb->head + i) % wb->size];
+        if (e->block == block && e->start > now) {
+            wb->stats.coalesced++;
+            return 0;
+        }
+    }
+
+    if (wb->count == wb->size) {
+        wait = wb->entry[wb->head].done - now;
+        now = wb->entry[wb->head].done;
+        wb->head = (wb->head + 1) % wb->size;
+        wb->count--;
+        wb->stats.full++;
+        wb->stats.stall_cycles += (long) wait;
+    }
+
+    e = &wb->entry[(wb->head + wb->count) % wb->size];
+    e->block = block;
+    e->start = wb->drained > now ? wb->drained : now;
+    e->done = wb->drained = e->start + latency;
+    wb->count++;
+    return (int) wait;
+}
+
+void iplc_wbuf_get_stats(const iplc_wbuf_t *wb, iplc_wbuf_stats_t *stats)
+{
+    *stats = wb->stats;
+}
+
+/*
+ * Queued writes and counters, as they are.
+ */
+int iplc_wbuf_save(const iplc_wbuf_t *wb, FILE *f)
+{
+    return fwrite(wb, sizeof(iplc_wbuf_t), 1, f) == 1 ? 0 : -1;
+}
+
+/*
+ * Returns -1 if the saved buffer had a different number of entries.
+ */
+int iplc_wbuf_load(iplc_wbuf_t *wb, FILE *f)
+{
+    iplc_wbuf_t saved;
+
+    if (fread(&saved, sizeof(iplc_wbuf_t), 1, f) != 1)
+        return -1;
+    if (saved.size != wb->size)
+        return -1;
+    *wb = saved;
+    return 0;
+}
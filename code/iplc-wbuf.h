@@ -0,0 +1,43 @@
+/***********************************************************************/
+/***********************************************************************
+ Pipeline Cache Simulator -- coalescing write buffer
+ ***********************************************************************/
+/***********************************************************************/
+#ifndef IPLC_WBUF_H
+#define IPLC_WBUF_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define WBUF_MAX_ENTRIES 64
+
+/*
+ * A FIFO of writes on their way from L1 to the levels below it: stores
+ * that write through or miss, and write-backs of dirty blocks.  Writes
+ * drain one at a time, each taking the latency it was queued with.  A
+ * write to a block that already has a write waiting (not yet started) is
+ * merged into it.  Writing costs nothing until every entry is taken; then
+ * the writer waits for the oldest one to finish.
+ */
+typedef struct iplc_wbuf iplc_wbuf_t;
+
+typedef struct iplc_wbuf_stats
+{
+    long writes;
+    long coalesced;             // merged into a waiting write
+    long full;                  // writes that found the buffer full
+    long stall_cycles;          // ... and how long they waited
+
+} iplc_wbuf_stats_t;
+
+iplc_wbuf_t *iplc_wbuf_create(int entries);
+void iplc_wbuf_destroy(iplc_wbuf_t *wb);
+
+// Checkpoints, into a write buffer configured the same way
+int iplc_wbuf_save(const iplc_wbuf_t *wb, FILE *f);
+int iplc_wbuf_load(iplc_wbuf_t *wb, FILE *f);
+
+int iplc_wbuf_write(iplc_wbuf_t *wb, uint32_t block, unsigned long now, int latency);
+void iplc_wbuf_get_stats(const iplc_wbuf_t *wb, iplc_wbuf_stats_t *stats);
+
+#endif